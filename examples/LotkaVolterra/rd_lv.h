@@ -76,128 +76,23 @@ public:
         data.add_contained_vals (path.str().c_str(), this->v);
     }
 
-    void compute_dudt (std::vector<Flt>& u_, std::vector<Flt>& dudt)
-    {
-        std::vector<Flt> lapu(this->nhex, 0.0);
-        this->compute_laplace (u_, lapu);
-#pragma omp parallel for
-        for (unsigned int h=0; h<this->nhex; ++h) {
-            dudt[h] = this->D1 * lapu[h] + (u_[h] * (a1 - b1 * u_[h] - c1 * v[h]));
-        }
-    }
-
-    void compute_dvdt (std::vector<Flt>& v_, std::vector<Flt>& dvdt)
-    {
-        std::vector<Flt> lapv(this->nhex, 0.0);
-        this->compute_laplace (v_, lapv);
-#pragma omp parallel for
-        for (unsigned int h=0; h<this->nhex; ++h) {
-            dvdt[h] = this->D2 * lapv[h] + (v_[h] * (a2 - b2 * v_[h] - c2 * u[h]));
-        }
-    }
-
+    /*!
+     * Simulate one timestep of the model. u and v are advanced together with 4th order
+     * Runge-Kutta, with the reaction terms declared here fused with the diffusion
+     * terms by RD_Base.
+     */
     void step()
     {
         this->stepCount++;
-
-        // 1. 4th order Runge-Kutta computation for u
-        {
-            // utst: "u at a test point". utst is a temporary estimate for u.
-            std::vector<Flt> utst(this->nhex, 0.0);
-            std::vector<Flt> dudt(this->nhex, 0.0);
-            std::vector<Flt> K1(this->nhex, 0.0);
-            std::vector<Flt> K2(this->nhex, 0.0);
-            std::vector<Flt> K3(this->nhex, 0.0);
-            std::vector<Flt> K4(this->nhex, 0.0);
-
-            // RK Stage 1
-            this->compute_dudt (this->u, dudt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K1[h] = dudt[h] * this->dt;
-                utst[h] = this->u[h] + K1[h] * 0.5 ;
-            }
-
-            // RK Stage 2
-            this->compute_dudt (utst, dudt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K2[h] = dudt[h] * this->dt;
-                utst[h] = this->u[h] + K2[h] * 0.5;
-            }
-
-            // RK Stage 3
-            this->compute_dudt (utst, dudt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K3[h] = dudt[h] * this->dt;
-                utst[h] = this->u[h] + K3[h];
-            }
-
-            // RK Stage 4
-            this->compute_dudt (utst, dudt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K4[h] = dudt[h] * this->dt;
-            }
-
-            /*
-             * Final sum together. This could be incorporated in the for loop for
-             * Stage 4, but I've separated it out for pedagogy.
-             */
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                u[h] += ((K1[h] + 2.0 * (K2[h] + K3[h]) + K4[h])/(Flt)6.0);
-            }
-        }
-
-        // 2. 4th order Runge-Kutta computation of v
-        {
-            // vtst: "v at a test point". vtst is a temporary estimate for v.
-            std::vector<Flt> vtst(this->nhex, 0.0);
-            std::vector<Flt> dvdt(this->nhex, 0.0);
-            std::vector<Flt> K1(this->nhex, 0.0);
-            std::vector<Flt> K2(this->nhex, 0.0);
-            std::vector<Flt> K3(this->nhex, 0.0);
-            std::vector<Flt> K4(this->nhex, 0.0);
-
-            // RK Stage 1
-            this->compute_dvdt (this->v, dvdt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K1[h] = dvdt[h] * this->dt;
-                vtst[h] = this->v[h] + K1[h] * 0.5 ;
-            }
-
-            // RK Stage 2
-            this->compute_dvdt (vtst, dvdt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K2[h] = dvdt[h] * this->dt;
-                vtst[h] = this->v[h] + K2[h] * 0.5;
-            }
-
-            // RK Stage 3
-            this->compute_dvdt (vtst, dvdt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K3[h] = dvdt[h] * this->dt;
-                vtst[h] = this->v[h] + K3[h];
-            }
-
-            // RK Stage 4
-            this->compute_dvdt (vtst, dvdt);
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                K4[h] = dvdt[h] * this->dt;
-            }
-
-            // Final sum together.
-#pragma omp parallel for
-            for (unsigned int h=0; h<this->nhex; ++h) {
-                v[h] += ((K1[h] + 2.0 * (K2[h] + K3[h]) + K4[h])/(Flt)6.0);
-            }
-        }
+        const std::array<Flt, 6> p = { this->a1, this->b1, this->c1, this->a2, this->b2, this->c2 };
+        this->template fused_step<2> ({ &this->u, &this->v },
+                                      this->template reaction_diffusion<2> (
+                                          std::array<Flt, 2>{ this->D1, this->D2 },
+                                          [p](const std::array<Flt, 2>& x, std::array<Flt, 2>& r)
+                                          {
+                                              r[0] = x[0] * (p[0] - p[1] * x[0] - p[2] * x[1]);
+                                              r[1] = x[1] * (p[3] - p[4] * x[1] - p[5] * x[0]);
+                                          }));
     }
 
 }; // RD_lv
@@ -0,0 +1,55 @@
+/*!
+ * \file AlignedAllocator.h
+ *
+ * An allocator for std::vector (and friends) which aligns the allocated memory to a
+ * given boundary, so that the start of the data can be loaded with aligned SIMD
+ * instructions.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace morph {
+
+    /*!
+     * Allocate memory for objects of type T, aligned to Alignment bytes.
+     *
+     * \tparam T The type to allocate
+     * \tparam Alignment The alignment in bytes. Must be a power of two and no less than alignof(T).
+     */
+    template <typename T, std::size_t Alignment>
+    struct AlignedAllocator
+    {
+        static_assert (Alignment >= alignof(T), "Alignment must be at least alignof(T)");
+        static_assert ((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+
+        using value_type = T;
+
+        template <typename U>
+        struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() noexcept {}
+        template <typename U>
+        AlignedAllocator (const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        T* allocate (std::size_t n)
+        {
+            return static_cast<T*>(::operator new (n * sizeof(T), std::align_val_t{Alignment}));
+        }
+
+        void deallocate (T* p, std::size_t) noexcept
+        {
+            ::operator delete (p, std::align_val_t{Alignment});
+        }
+    };
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator== (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return true; }
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator!= (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return false; }
+
+} // namespace morph
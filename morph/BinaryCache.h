@@ -0,0 +1,66 @@
+/*!
+ * \file BinaryCache.h
+ *
+ * Helpers shared by the binary cache files which save structures that are slow to
+ * build (HexGrid::saveBinary, ResampleOperator::save): a hash to key a file to the
+ * parameters that produced it, and the preamble that begins each file.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace morph {
+
+    //! A 64 bit FNV-1a hash, used to key a binary cache file to its parameters
+    struct CacheKey
+    {
+        //! The hash so far, initially the FNV-1a offset basis
+        std::uint64_t h = 14695981039346656037ULL;
+
+        //! Add the \a n bytes at \a p to the hash
+        void add (const void* p, const size_t n)
+        {
+            const unsigned char* c = static_cast<const unsigned char*>(p);
+            for (size_t i = 0; i < n; ++i) {
+                this->h ^= c[i];
+                this->h *= 1099511628211ULL;
+            }
+        }
+    };
+
+    /*!
+     * The start of a binary cache file header: the magic string, format version, byte
+     * order mark and key. Make this the first member of the file's header struct.
+     */
+    struct BinaryCachePreamble
+    {
+        //! Construct with the 8 character magic string \a magic_ and format \a version_
+        BinaryCachePreamble (const char (&magic_)[9], const std::uint32_t version_)
+            : version(version_)
+        {
+            std::memcpy (this->magic, magic_, sizeof this->magic);
+        }
+
+        /*!
+         * True if this preamble, read from a file, has the magic string, version and
+         * byte order of \a ref and, unless \a key_ is 0, the key \a key_.
+         */
+        bool matches (const BinaryCachePreamble& ref, const std::uint64_t key_) const
+        {
+            return std::memcmp (this->magic, ref.magic, sizeof this->magic) == 0
+                && this->version == ref.version && this->byteorder == ref.byteorder
+                && (key_ == 0 || this->key == key_);
+        }
+
+        char magic[8];
+        std::uint32_t version = 0;
+        // A file written on a machine of the other endianness reads this as 0x04030201
+        std::uint32_t byteorder = 0x01020304;
+        std::uint64_t key = 0;
+    };
+
+} // namespace morph
@@ -7,6 +7,7 @@
 
 #include <morph/Rect.h>
 #include <morph/GridFeatures.h>
+#include <morph/DistanceTransform.h>
 
 // CartGrid contains carried over code (from HexGrid) which allows for the imposition of
 // arbitrary boundaries, specified as Bezier curves. This brings in a link dependency on
@@ -30,6 +31,7 @@
 #endif
 
 #include <set>
+#include <unordered_set>
 #include <list>
 #include <string>
 #include <array>
@@ -41,6 +43,8 @@
 #include <vector>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
+#include <cstdint>
 
 namespace morph {
 
@@ -349,6 +353,7 @@ namespace morph {
          */
         void save (const std::string& path)
         {
+            this->requireRects ("save");
             morph::HdfData cgdata (path);
             cgdata.add_val ("/d", d);
             cgdata.add_val ("/v", v);
@@ -645,9 +650,13 @@ namespace morph {
         //! Construct with rectangular element width d_, height v_ starting at location x1,y1 and
         //! creating to x2,y2. The number of elements that need to be created will be determined
         //! from these. This is a non-symmetric constructor.
+        //!
+        //! If with_rects is false (which requires a Rectangle shape), the list of Rects is not
+        //! created. Instead the d_ vectors are filled directly (see CartGrid::withRects).
         CartGrid (float d_, float v_, float x1, float y1, float x2, float y2, float z_ = 0.0f,
                   GridDomainShape shape = GridDomainShape::Rectangle,
-                  GridDomainWrap wrap = GridDomainWrap::None)
+                  GridDomainWrap wrap = GridDomainWrap::None,
+                  bool with_rects = true)
         {
             if constexpr (debug_cartgrid) {
                 std::cout << "CartGrid constructor (x1,y1 to x2,y2 version) called. 0x" << (unsigned long long int)this << "\n";
@@ -660,8 +669,16 @@ namespace morph {
             this->domainShape = shape;
             this->domainWrap = wrap;
 
-            // init2 is the non-symmetic initialisation for making arbitrary rectangular grids.
-            this->init2 (x1, y1, x2, y2);
+            if (with_rects) {
+                // init2 is the non-symmetic initialisation for making arbitrary rectangular grids.
+                this->init2 (x1, y1, x2, y2);
+            } else {
+                if (shape != GridDomainShape::Rectangle) {
+                    throw std::runtime_error ("CartGrid: A CartGrid without Rects must have a Rectangle shape.");
+                }
+                this->withRects = false;
+                this->init2_vectors (x1, y1, x2, y2);
+            }
         }
 
         //! Initialisation common code
@@ -713,22 +730,22 @@ namespace morph {
          */
         void setBoundary (const std::list<Rect>& pRects)
         {
+            this->requireRects ("setBoundary");
             this->boundaryCentroid = this->computeCentroid (pRects);
 
+            // Key the boundary rects on their (xi,yi) coordinates. NB: The assumption right
+            // now is that the pRects are from the same dimension grid as this->rects.
+            std::unordered_set<std::uint64_t> pkeys;
+            pkeys.reserve (pRects.size());
+            for (const auto& pr : pRects) { pkeys.insert (CartGrid::indexKey (pr.xi, pr.yi)); }
+
             std::list<morph::Rect>::iterator bpoint = this->rects.begin();
             std::list<morph::Rect>::iterator bpi = this->rects.begin();
             while (bpi != this->rects.end()) {
-                std::list<morph::Rect>::const_iterator ppi = pRects.begin();
-                while (ppi != pRects.end()) {
-                    // NB: The assumption right now is that the pRects are from the same dimension grid
-                    // as this->rects.
-                    if (bpi->xi == ppi->xi && bpi->yi == ppi->yi) {
-                        // Set h as boundary rect.
-                        bpi->setFlag (RECT_IS_BOUNDARY | RECT_INSIDE_BOUNDARY);
-                        bpoint = bpi;
-                        break;
-                    }
-                    ++ppi;
+                if (pkeys.count (CartGrid::indexKey (bpi->xi, bpi->yi)) > 0) {
+                    // Set h as boundary rect.
+                    bpi->setFlag (RECT_IS_BOUNDARY | RECT_INSIDE_BOUNDARY);
+                    bpoint = bpi;
                 }
                 ++bpi;
             }
@@ -762,6 +779,7 @@ namespace morph {
          */
         void setBoundary (const BezCurvePath<float>& p, bool loffset = true)
         {
+            this->requireRects ("setBoundary");
             this->boundary = p;
             if (!this->boundary.isNull()) {
                 // Compute the points on the boundary using half of the rect to rect
@@ -782,6 +800,7 @@ namespace morph {
          */
         void setBoundaryOnly (const BezCurvePath<float>& p, bool loffset = true)
         {
+            this->requireRects ("setBoundaryOnly");
             this->boundary = p;
             if (!this->boundary.isNull()) {
                 this->boundary.computePoints (this->d/2.0f, true); // FIXME PROBABLY NEEDS TO BE DIFFERENT
@@ -800,6 +819,7 @@ namespace morph {
          */
         void setBoundary (std::vector<BezCoord<float>>& bpoints, bool loffset = true)
         {
+            this->requireRects ("setBoundary");
             this->boundaryCentroid = morph::BezCurvePath<float>::getCentroid (bpoints);
 
             auto bpi = bpoints.begin();
@@ -856,8 +876,30 @@ namespace morph {
                               morph::CartGrid& cg_polar, morph::vvec<float>& polar_data,
                               morph::vec<float, 2> view_pos, float view_angle, morph::ScaleFn radscale = morph::ScaleFn::Linear)
         {
+            this->requireRects ("resampleToPolar");
             polar_data.zero();
+            this->polarWeights (cg_polar, view_pos, view_angle, radscale,
+                                [&image_data, &polar_data](const unsigned int xi, const unsigned int vi, const float wt) {
+                                    polar_data[xi] += wt * image_data[vi];
+                                });
+            //polar_data /= polar_data.max(); // renormalise?
+        }
 
+        /*!
+         * The weights with which resampleToPolar combines the image data. For each
+         * output pixel xi of cg_polar (in order) and each image Rect vi which contributes
+         * to it, call f (xi, vi, wt). The contributors are the Rect nearest to the r/phi
+         * location of xi and its neighbours, each weighted by a 2D Gaussian and divided
+         * by the number of contributors. Output pixels outside the image have none.
+         *
+         * The nearest Rect is found by a search from the last one found, so the output
+         * pixels are visited serially.
+         */
+        template <typename F>
+        void polarWeights (morph::CartGrid& cg_polar, morph::vec<float, 2> view_pos, float view_angle,
+                           morph::ScaleFn radscale, F&& f)
+        {
+            this->requireRects ("polarWeights");
             // distance per pixel in the image. This defines the Gaussian width (sigma) for the resample:
             morph::vec<float, 2> dist_per_pix = { this->d, this->v };
             morph::vec<float, 2> params = 1.0f / (2.0f * dist_per_pix * dist_per_pix);
@@ -873,16 +915,13 @@ namespace morph {
             float rad_per_dist = morph::mathconst<float>::two_pi/(polar_span[0]+cg_polar.getd());
 
             std::list<morph::Rect>::iterator lastrect = this->rects.begin();
-#pragma omp parallel for
             for (unsigned int xi = 0; xi < cg_polar.num(); ++xi) { // for each output pixel which is an r/phi pair
 
                 float r = cg_polar.d_y[xi]; // Linear
                 if (radscale == morph::ScaleFn::Logarithmic) {
                     r = std::log (this->v+cg_polar.d_y[xi]) - std::log(this->v);
                     r *= 0.4f; // You can play with this factor
-                    //std::cout << "For r linear = " << cg_polar.d_y[xi] << ", log transform is " << r << std::endl;
                 }
-                //float phi = cg_polar.d_x[xi] * rad_per_dist;
 
                 // r and phi in the image frame:
                 float phi_imframe = (cg_polar.d_x[xi] * rad_per_dist) + view_angle;
@@ -891,38 +930,27 @@ namespace morph {
                 morph::vec<float, 2> abs_xy_imframe = morph::vec<float, 2>({r * std::cos(phi_imframe),
                                                                             r * std::sin(phi_imframe)}) + view_pos;
 
-                // If abs_xy_imframe is outside the bounds of the image region, then leave value 0 and move on.
+                // If abs_xy_imframe is outside the bounds of the image region, then there are no contributors
                 if (this->isInsideRectangularBoundary (abs_xy_imframe) == false) { continue; }
 
                 // Find pixel nearest abs_xy_imframe
-                //std::list<morph::Rect>::iterator nearest = this->findRectNearest (abs_xy_imframe);
-                // or (if it's faster?):
                 std::list<morph::Rect>::iterator nearest = this->findRectNearPoint (abs_xy_imframe, lastrect);
                 lastrect = nearest;
 
-                // Now sum up contribution from nearest and its neighbours to polar_data[xi].
-
-                // Closest pix
-                std::list<morph::Rect>::iterator curr = nearest;
-                float dd = (abs_xy_imframe - morph::vec<float, 2>({curr->x, curr->y})).length();
-                float expr = std::exp ( -(assumecirc * dd * dd) ) * image_data[curr->vi];
-
-                float contributors = 1.0f;
-                // 8 Neighbours
+                // The closest pix and its 8 neighbours contribute to polar_data[xi]
+                std::array<std::list<morph::Rect>::iterator, 9> contrib;
+                unsigned int ncontrib = 0;
+                contrib[ncontrib++] = nearest;
                 for (unsigned short nn = 0; nn < 8; ++nn) {
-                    if (nearest->has_neighbour(nn)) {
-                        curr = nearest->get_neighbour(nn);
-                        float dd = (abs_xy_imframe - morph::vec<float, 2>({curr->x, curr->y})).length();
-                        // sum according to 2D Gaussian:
-                        expr += std::exp ( -(assumecirc * dd * dd) ) * image_data[curr->vi];
-                        contributors += 1.0f;
-                    }
+                    if (nearest->has_neighbour(nn)) { contrib[ncontrib++] = nearest->get_neighbour(nn); }
+                }
+                float contributors = static_cast<float>(ncontrib);
+                for (unsigned int k = 0; k < ncontrib; ++k) {
+                    float dd = (abs_xy_imframe - morph::vec<float, 2>({contrib[k]->x, contrib[k]->y})).length();
+                    // weight according to 2D Gaussian:
+                    f (xi, contrib[k]->vi, std::exp ( -(assumecirc * dd * dd) ) / contributors);
                 }
-
-                polar_data[xi] = expr / contributors;
             }
-
-            //polar_data /= polar_data.max(); // renormalise?
         }
 
 #ifdef CARTGRID_COMPILE_WITH_BEZCURVES
@@ -937,6 +965,7 @@ namespace morph {
          */
         void setBoundaryOnly (std::vector<BezCoord<float>>& bpoints, bool loffset)
         {
+            this->requireRects ("setBoundaryOnly");
             this->boundaryCentroid = morph::BezCurvePath<float>::getCentroid (bpoints);
 
             auto bpi = bpoints.begin();
@@ -983,6 +1012,20 @@ namespace morph {
         static constexpr bool debugSetBoundary = false;
         void setBoundaryOnOuterEdge()
         {
+            if (!this->withRects) {
+                // The outer edge of the raster is the boundary
+                const int w = this->w_px;
+                const int h = this->h_px;
+                for (int i = 0; i < w * h; ++i) {
+                    const int x = i % w;
+                    const int y = i / w;
+                    if (x == 0 || y == 0 || x == w - 1 || y == h - 1) {
+                        this->d_flags[i] |= (RECT_IS_BOUNDARY | RECT_INSIDE_BOUNDARY);
+                    }
+                }
+                return;
+            }
+
             // From centre head to boundary, then mark boundary and walk
             // around the edge.
             std::list<morph::Rect>::iterator bpi = this->rects.begin();
@@ -1145,20 +1188,21 @@ namespace morph {
          *
          * return The number of rects in the grid.
          */
-        unsigned int num() const { return this->rects.size(); }
+        unsigned int num() const { return this->withRects ? this->rects.size() : this->d_x.size(); }
 
         /*!
          * \brief Obtain the vector index of the last Rect in rects.
          *
          * return Rect::vi from the last Rect in the grid.
          */
-        unsigned int lastVectorIndex() const { return this->rects.rbegin()->vi; }
+        unsigned int lastVectorIndex() const { return this->withRects ? this->rects.rbegin()->vi : this->d_x.size() - 1; }
 
         /*!
          * Output some text information about the hexgrid.
          */
         std::string output() const
         {
+            this->requireRects ("output");
             std::stringstream ss;
             ss << "Rect grid with " << this->rects.size() << " rects:\n";
             auto i = this->rects.begin();
@@ -1296,35 +1340,72 @@ namespace morph {
         float getRectArea() const { return (this->d * this->v); }
 
         /*!
-         * Run through all the rects and compute the distance to the nearest boundary
-         * rect.
-         */
-        void computeDistanceToBoundary()
-        {
-            std::list<morph::Rect>::iterator r = this->rects.begin();
-            while (r != this->rects.end()) {
-                if (r->testFlags(RECT_IS_BOUNDARY) == true) {
-                    r->distToBoundary = 0.0f;
-                } else {
-                    if (r->testFlags(RECT_INSIDE_BOUNDARY) == false) {
+         * Compute the distance from every rect to the nearest boundary rect. Boundary
+         * rects get 0 and rects outside the boundary get -100. If there is no boundary
+         * (or, for DistanceMetric::HopCount, no path to it) inside rects get -1. The
+         * result is written to d_distToBoundary and Rect::distToBoundary.
+         *
+         * \param metric DistanceMetric::Euclidean (the default) gives the straight line
+         * distance to the nearest boundary rect, computed with the exact, linear time
+         * transform in morph::DistanceTransform::sqdist_2d. DistanceMetric::HopCount
+         * gives the number of 8-connected (i.e. including diagonal) steps to the
+         * boundary, multiplied by d, found by a breadth first search.
+         *
+         * \param parallel If true, the Euclidean transform runs its passes in OpenMP
+         * parallel loops. The result is the same either way.
+         */
+        void computeDistanceToBoundary (const DistanceMetric metric = DistanceMetric::Euclidean,
+                                        const bool parallel = false)
+        {
+            const unsigned int n = this->num();
+            if (this->withRects) {
+                if (this->d_x.size() != n) { this->populate_d_vectors(); }
+                // Take flags from rects, in case boundary flags changed since the d_ vectors were populated
+                for (const auto& r : this->rects) { this->d_flags[r.di] = r.getFlags(); }
+            }
+
+            std::vector<char> source (n, 0);
+            std::vector<char> inside (n, 0);
+            for (unsigned int i = 0; i < n; ++i) {
+                source[i] = (this->d_flags[i] & RECT_IS_BOUNDARY) ? 1 : 0;
+                inside[i] = (this->d_flags[i] & RECT_INSIDE_BOUNDARY) ? 1 : 0;
+            }
+
+            if (metric == DistanceMetric::HopCount) {
+                std::array<const std::vector<int>*, 8> nbrs = {{ &this->d_ne, &this->d_nne, &this->d_nn, &this->d_nnw,
+                                                                 &this->d_nw, &this->d_nsw, &this->d_ns, &this->d_nse }};
+                morph::DistanceTransform::hops<8> (nbrs, source, inside, this->d_distToBoundary, this->d);
+
+            } else if (n > 0) {
+                auto xmm = std::minmax_element (this->d_xi.begin(), this->d_xi.end());
+                auto ymm = std::minmax_element (this->d_yi.begin(), this->d_yi.end());
+                const int xmin = *xmm.first;
+                const int ymin = *ymm.first;
+                const int w = *xmm.second - xmin + 1;
+                const int h = *ymm.second - ymin + 1;
+                std::vector<float> lattice (static_cast<size_t>(w) * h, morph::DistanceTransform::inf);
+                for (unsigned int i = 0; i < n; ++i) {
+                    if (source[i]) { lattice[(this->d_yi[i] - ymin) * w + this->d_xi[i] - xmin] = 0.0f; }
+                }
+                morph::DistanceTransform::sqdist_2d (lattice, w, h, this->d, this->v, parallel);
+
+                this->d_distToBoundary.resize (n);
+#pragma omp parallel for if(parallel)
+                for (unsigned int i = 0; i < n; ++i) {
+                    const float sqd = lattice[(this->d_yi[i] - ymin) * w + this->d_xi[i] - xmin];
+                    if (!inside[i]) {
                         // Set to a dummy, negative value
-                        r->distToBoundary = -100.0;
+                        this->d_distToBoundary[i] = -100.0f;
+                    } else if (sqd == morph::DistanceTransform::inf) {
+                        // No boundary
+                        this->d_distToBoundary[i] = -1.0f;
                     } else {
-                        // Not a boundary rect, but inside boundary
-                        std::list<morph::Rect>::iterator br = this->rects.begin();
-                        while (br != this->rects.end()) {
-                            if (br->testFlags(RECT_IS_BOUNDARY) == true) {
-                                float delta = r->distanceFrom (*br);
-                                if (delta < r->distToBoundary || r->distToBoundary < 0.0f) {
-                                    r->distToBoundary = delta;
-                                }
-                            }
-                            ++br;
-                        }
+                        this->d_distToBoundary[i] = std::sqrt (sqd);
                     }
                 }
-                ++r;
             }
+
+            for (auto& r : this->rects) { r.distToBoundary = this->d_distToBoundary[r.di]; }
         }
 
         /*!
@@ -1345,6 +1426,7 @@ namespace morph {
          */
         void populate_d_vectors (const std::array<int, 4>& extnts)
         {
+            this->requireRects ("populate_d_vectors");
             // A rectangle iterator
             std::list<morph::Rect>::iterator ri = this->rects.begin();
             // Bottom left rectangle
@@ -1447,6 +1529,7 @@ namespace morph {
                                                           morph::vec<float, 2>& regionCentroid,
                                                           bool applyOriginalBoundaryCentroid = true)
         {
+            this->requireRects ("getRegion");
             // First clear all region boundary flags, as we'll be defining a new region boundary
             this->clearRegionBoundaryFlags();
 
@@ -1502,12 +1585,52 @@ namespace morph {
         }
 #endif
 
+        /*!
+         * Get the region made up of the rects at the integer coordinates (xi,yi) given
+         * in \a xycoords. The previous region flags are cleared, then each rect in the
+         * region is marked RECT_INSIDE_REGION and those rects of the region which have
+         * a neighbour outside the region (or no neighbour at all) are also marked
+         * RECT_IS_REGION_BOUNDARY. Coordinates that don't match a rect in the grid are
+         * ignored. The cost is linear in the number of rects plus the number of
+         * coordinates.
+         *
+         * \return a vector of iterators to the Rects that make up the region, in the
+         * order in which they appear in rects.
+         */
+        std::vector<std::list<Rect>::iterator> getRegion (const std::vector<morph::vec<int, 2>>& xycoords)
+        {
+            this->requireRects ("getRegion");
+            this->clearRegionBoundaryFlags();
+
+            std::unordered_set<std::uint64_t> rkeys;
+            rkeys.reserve (xycoords.size());
+            for (const auto& xy : xycoords) { rkeys.insert (CartGrid::indexKey (xy[0], xy[1])); }
+
+            std::vector<std::list<morph::Rect>::iterator> theRegion;
+            for (auto ri = this->rects.begin(); ri != this->rects.end(); ++ri) {
+                if (rkeys.count (CartGrid::indexKey (ri->xi, ri->yi)) > 0) {
+                    ri->setFlag (RECT_INSIDE_REGION);
+                    theRegion.push_back (ri);
+                }
+            }
+            for (auto ri : theRegion) {
+                for (unsigned short i = 0; i < 8; ++i) {
+                    if (!ri->has_neighbour(i) || !ri->get_neighbour(i)->testFlags (RECT_INSIDE_REGION)) {
+                        ri->setFlag (RECT_IS_REGION_BOUNDARY);
+                        break;
+                    }
+                }
+            }
+            return theRegion;
+        }
+
         /*!
          * For every rect in rects, unset the flags RECT_IS_REGION_BOUNDARY and
          * RECT_INSIDE_REGION
          */
         void clearRegionBoundaryFlags()
         {
+            this->requireRects ("clearRegionBoundaryFlags");
             for (auto& rr : this->rects) {
                 rr.unsetFlag (RECT_IS_REGION_BOUNDARY | RECT_INSIDE_REGION);
             }
@@ -1523,6 +1646,7 @@ namespace morph {
         template<typename T>
         void oncentre_offsurround (const std::vector<T>& data, std::vector<T>& result)
         {
+            this->requireRects ("oncentre_offsurround");
             if (result.size() != this->rects.size()) {
                 throw std::runtime_error ("The result vector is not the same size as the CartGrid.");
             }
@@ -1550,10 +1674,12 @@ namespace morph {
             }
         }
 
-        //! Apply a box filter. SLOOOOOW algorithm.
+        //! Apply a box filter. SLOOOOOW algorithm. For box filters of any size in
+        //! constant time per rect, see morph::SummedAreaTable (SummedAreaTable.h).
         template<typename T, bool onlysum=false>
         void boxfilter (const std::vector<T>& data, std::vector<T>& result, unsigned int boxside)
         {
+            this->requireRects ("boxfilter");
             if (result.size() != this->rects.size()) {
                 throw std::runtime_error ("The result vector is not the same size as the CartGrid.");
             }
@@ -1655,10 +1781,15 @@ namespace morph {
          * Using this CartGrid as the domain, convolve the domain data \a data with the
          * kernel data \a kerneldata, which exists on another CartGrid, \a
          * kernelgrid. Return the result in \a result.
+         *
+         * For repeated convolutions on a rectangular CartGrid, use morph::CartGridKernel
+         * (CartGridKernel.h), which resolves the kernel to row offsets just once, runs
+         * in parallel and applies separable kernels as two 1D passes.
          */
         template<typename T>
         void convolve (const CartGrid& kernelgrid, const std::vector<T>& kerneldata, const std::vector<T>& data, std::vector<T>& result)
         {
+            this->requireRects ("convolve");
             if (result.size() != this->rects.size()) {
                 throw std::runtime_error ("The result vector is not the same size as the CartGrid.");
             }
@@ -1754,6 +1885,18 @@ namespace morph {
          */
         std::list<Rect> rects;
 
+        /*!
+         * False if this CartGrid was constructed without its list of Rects. Such a
+         * CartGrid is a rectangle, and its d_ vectors (coordinates, indices, flags and
+         * neighbours) are computed directly from the raster index, which is much faster
+         * for large grids. num(), the d_ vectors, setBoundaryOnOuterEdge() and code
+         * which works with the d_ vectors (such as CartGridKernel and SummedAreaTable)
+         * can be used, as can computeDistanceToBoundary(). Methods which work through
+         * the Rects (such as convolve(), boxfilter(), resampleToPolar() and the
+         * setBoundary() methods) throw std::runtime_error.
+         */
+        bool withRects = true;
+
         /*!
          * Once boundary secured, fill this vector. Experimental - can I do parallel
          * loops with vectors of rects? Ans: Not very well.
@@ -1782,6 +1925,22 @@ namespace morph {
         morph::vec<float, 2> originalBoundaryCentroid = { 0.0f, 0.0f };
 
     private:
+        //! A single integer key for the rect coordinates (xi,yi), for hash lookups
+        static std::uint64_t indexKey (const int xi, const int yi)
+        {
+            return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(xi)) << 32)
+                | static_cast<std::uint64_t>(static_cast<std::uint32_t>(yi));
+        }
+
+        //! Throw if this CartGrid was constructed without Rects, which \a method needs
+        void requireRects (const std::string& method) const
+        {
+            if (!this->withRects) {
+                throw std::runtime_error ("CartGrid::" + method
+                                          + ": This CartGrid was constructed without Rects (with_rects = false)");
+            }
+        }
+
         /*!
          * Initialise a grid of rects in a raster fashion, setting neighbours as we
          * go. This method populates rects based on the grid parameters set in d, v and
@@ -1797,8 +1956,8 @@ namespace morph {
             int halfRows = std::abs(std::ceil(halfY/this->v));
 
             if (this->domainShape == GridDomainShape::Rectangle) {
-                this->w_px = 2 * halfRows + 1;
-                this->h_px = 2 * halfCols + 1;
+                this->w_px = 2 * halfCols + 1;
+                this->h_px = 2 * halfRows + 1;
             }
 
             this->x_minmax = morph::range<float>(-halfCols * this->d, halfCols * this->d);
@@ -1933,6 +2092,86 @@ namespace morph {
             }
         }
 
+        /*!
+         * The equivalent of init2() followed by populate_d_vectors(), without the list
+         * of Rects. The d_ vectors, including the neighbour flags and indices (with any
+         * horizontal wrapping), are computed from each element's raster index, as init2()
+         * would set them up.
+         */
+        void init2_vectors (float x1, float y1, float x2, float y2)
+        {
+            this->x_minmax = morph::range<float>(x1, x2);
+            this->y_minmax = morph::range<float>(y1, y2);
+
+            const int _xi = std::round(x1/this->d);
+            const int _xf = std::round(x2/this->d);
+            const int _yi = std::round(y1/this->v);
+            const int _yf = std::round(y2/this->v);
+            const int w = _xf - _xi + 1;
+            const int h = _yf - _yi + 1;
+            this->w_px = w;
+            this->h_px = h;
+            const bool wrap = this->domainWrap == morph::GridDomainWrap::Horizontal
+                              || this->domainWrap == morph::GridDomainWrap::Both;
+
+            const size_t n = static_cast<size_t>(w) * h;
+            this->d_x.resize (n);
+            this->d_y.resize (n);
+            this->d_xi.resize (n);
+            this->d_yi.resize (n);
+            this->d_flags.resize (n);
+            this->d_distToBoundary.assign (n, -1.0f);
+            this->d_ne.resize (n);
+            this->d_nne.resize (n);
+            this->d_nn.resize (n);
+            this->d_nnw.resize (n);
+            this->d_nw.resize (n);
+            this->d_nsw.resize (n);
+            this->d_ns.resize (n);
+            this->d_nse.resize (n);
+
+#pragma omp parallel for
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    const int i = y * w + x;
+                    this->d_xi[i] = _xi + x;
+                    this->d_yi[i] = _yi + y;
+                    // As Rect::computeLocation
+                    this->d_x[i] = this->d * this->d_xi[i];
+                    this->d_y[i] = this->v * this->d_yi[i];
+
+                    const bool east = x < w - 1;
+                    const bool west = x > 0;
+                    const bool north = y < h - 1;
+                    const bool south = y > 0;
+                    unsigned int f = 0;
+                    this->d_ne[i] = east ? i + 1 : (wrap ? i - (w - 1) : -1);
+                    this->d_nw[i] = west ? i - 1 : (wrap ? i + (w - 1) : -1);
+                    this->d_nn[i] = north ? i + w : -1;
+                    this->d_ns[i] = south ? i - w : -1;
+                    // The diagonal neighbours do not wrap
+                    this->d_nne[i] = (east && north) ? i + w + 1 : -1;
+                    this->d_nnw[i] = (west && north) ? i + w - 1 : -1;
+                    this->d_nsw[i] = (west && south) ? i - w - 1 : -1;
+                    this->d_nse[i] = (east && south) ? i - w + 1 : -1;
+                    if (this->d_ne[i] > -1) { f |= RECT_HAS_NE; }
+                    if (this->d_nne[i] > -1) { f |= RECT_HAS_NNE; }
+                    if (this->d_nn[i] > -1) { f |= RECT_HAS_NN; }
+                    if (this->d_nnw[i] > -1) { f |= RECT_HAS_NNW; }
+                    if (this->d_nw[i] > -1) { f |= RECT_HAS_NW; }
+                    if (this->d_nsw[i] > -1) { f |= RECT_HAS_NSW; }
+                    if (this->d_ns[i] > -1) { f |= RECT_HAS_NS; }
+                    if (this->d_nse[i] > -1) { f |= RECT_HAS_NSE; }
+                    if (wrap && !east) { f |= RECT_WRAPS_E; }
+                    if (wrap && !west) { f |= RECT_WRAPS_W; }
+                    this->d_flags[i] = f;
+                }
+            }
+
+            this->xi_minmax = morph::range<int>(_xi, _xf);
+            this->yi_minmax = morph::range<int>(_yi, _yf);
+        }
+
 #ifdef CARTGRID_COMPILE_WITH_BEZCURVES
         /*!
          * Starting from \a startFrom, and following nearest-neighbour relations, find
@@ -2584,6 +2823,7 @@ namespace morph {
          */
         std::list<Rect>::iterator findRectNearest (const morph::vec<float, 2>& pos)
         {
+            this->requireRects ("findRectNearest");
             std::list<morph::Rect>::iterator nearest = this->rects.end();
             std::list<morph::Rect>::iterator ri = this->rects.begin();
             float dist = std::numeric_limits<float>::max();
@@ -2602,6 +2842,7 @@ namespace morph {
         //! Assuming a rectangular CartGrid, find bottom left element
         std::list<Rect>::iterator findBottomLeft()
         {
+            this->requireRects ("findBottomLeft");
             std::list<morph::Rect>::iterator bottomleft = this->rects.begin();
             while (bottomleft->has_ns()) { bottomleft = bottomleft->ns; }
             while (bottomleft->has_nw()) { bottomleft = bottomleft->nw; }
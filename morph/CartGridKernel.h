@@ -0,0 +1,333 @@
+/*!
+ * \file CartGridKernel.h
+ *
+ * A convolution kernel, defined on one CartGrid, compiled into row offset tables for
+ * repeated convolutions of data on a rectangular CartGrid.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/CartGrid.h>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace morph {
+
+    /*!
+     * CartGrid::convolve() finds each (domain rect, kernel rect) pair by stepping
+     * through the Rect neighbour iterators, on a single thread, every time it is
+     * called. On a rectangular CartGrid the data is a raster, so a kernel rect at
+     * offset (dx, dy) contributes, to each domain rect (x, y), the datum at flat index
+     * (y + dy) * w + x + dx, if there is one. CartGridKernel resolves the kernel into
+     * rows of such offsets just once. For each kernel offset it also precomputes an
+     * edge table: the range of domain columns for which the source column exists
+     * and, if the domain wraps horizontally, the range which takes its source from the
+     * other side of the grid. convolve() then runs, for each domain row in an OpenMP
+     * parallel loop, one contiguous multiply-add loop per kernel rect.
+     *
+     * If the kernel is rank-1 (as is a Gaussian sampled on a rectangle of rects), it is
+     * factored into a row and a column, and convolve() runs a 1D pass along x followed
+     * by a 1D pass along y. For a kernel of kw by kh rects this costs kw + kh, rather
+     * than kw * kh, multiply-adds per domain rect.
+     *
+     * The result matches that of CartGrid::convolve() (including its horizontal
+     * wrapping), but the floating point summation order differs.
+     *
+     * \tparam T The type of the kernel and of the data to be convolved
+     */
+    template <typename T>
+    class CartGridKernel
+    {
+    public:
+        CartGridKernel() {}
+
+        /*!
+         * Construct and compile the kernel \a kerneldata, which exists on \a
+         * kernelgrid, for convolutions of data on the domain \a domain.
+         */
+        CartGridKernel (const CartGrid& domain, const CartGrid& kernelgrid, const std::vector<T>& kerneldata)
+        {
+            this->compile (domain, kernelgrid, kerneldata);
+        }
+
+        /*!
+         * Build the offset tables. \a domain must be a complete rectangle of rects,
+         * numbered in raster order from the bottom left (as a CartGrid is on
+         * construction), or a CartGrid constructed without Rects. \a kernelgrid must
+         * have the same d as \a domain, and may be of any shape (or may itself be a
+         * CartGrid without Rects).
+         */
+        void compile (const CartGrid& domain, const CartGrid& kernelgrid, const std::vector<T>& kerneldata)
+        {
+            if (kernelgrid.getd() != domain.getd()) {
+                throw std::runtime_error ("The kernel CartGrid must have same d as this CartGrid to carry out convolution.");
+            }
+            if (kerneldata.size() != kernelgrid.num()) {
+                throw std::runtime_error ("The kernel data vector is not the same size as the kernel CartGrid.");
+            }
+            this->setDomain (domain);
+
+            // The (xi,yi) offset of each kernel datum, from the rects or, for a kernel
+            // CartGrid without Rects, from the d_ vectors
+            std::vector<int> kxi;
+            std::vector<int> kyi;
+            if (kernelgrid.withRects) {
+                kxi.resize (kernelgrid.num());
+                kyi.resize (kernelgrid.num());
+                for (auto kr : kernelgrid.rects) {
+                    kxi[kr.vi] = kr.xi;
+                    kyi[kr.vi] = kr.yi;
+                }
+            } else {
+                kxi = kernelgrid.d_xi;
+                kyi = kernelgrid.d_yi;
+            }
+
+            // The extent of the kernel rects' (xi,yi) offsets
+            int kx0 = std::numeric_limits<int>::max();
+            int kx1 = std::numeric_limits<int>::min();
+            int ky0 = std::numeric_limits<int>::max();
+            int ky1 = std::numeric_limits<int>::min();
+            for (size_t i = 0; i < kxi.size(); ++i) {
+                kx0 = std::min (kx0, kxi[i]);
+                kx1 = std::max (kx1, kxi[i]);
+                ky0 = std::min (ky0, kyi[i]);
+                ky1 = std::max (ky1, kyi[i]);
+            }
+            this->rows_2d.clear();
+            this->rows_x.clear();
+            this->rows_y.clear();
+            if (kxi.empty()) { return; }
+
+            // The kernel, densely, on the rectangle that bounds it. Absent rects are 0.
+            const int kw = kx1 - kx0 + 1;
+            const int kh = ky1 - ky0 + 1;
+            std::vector<T> dense (static_cast<size_t>(kw) * kh, T{0});
+            for (size_t i = 0; i < kxi.size(); ++i) {
+                dense[(kyi[i] - ky0) * kw + kxi[i] - kx0] = kerneldata[i];
+            }
+
+            // Is the kernel the outer product of a column u and a row v? Factor it about
+            // its largest element and check the residual.
+            size_t pivot = 0;
+            for (size_t i = 1; i < dense.size(); ++i) {
+                if (std::abs (dense[i]) > std::abs (dense[pivot])) { pivot = i; }
+            }
+            const T kmax = std::abs (dense[pivot]);
+            const int pr = static_cast<int>(pivot) / kw;
+            const int pc = static_cast<int>(pivot) % kw;
+            std::vector<T> u (kh, T{0});
+            std::vector<T> v (kw, T{0});
+            this->separable = kmax > T{0};
+            if (this->separable) {
+                for (int r = 0; r < kh; ++r) { u[r] = dense[r * kw + pc]; }
+                for (int c = 0; c < kw; ++c) { v[c] = dense[pr * kw + c] / dense[pivot]; }
+                const T tol = T{64} * std::numeric_limits<T>::epsilon() * kmax;
+                for (int r = 0; r < kh && this->separable; ++r) {
+                    for (int c = 0; c < kw; ++c) {
+                        if (std::abs (dense[r * kw + c] - u[r] * v[c]) > tol) {
+                            this->separable = false;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (this->separable) {
+                // Pass along x with v, then along y with u
+                KernelRow rx;
+                rx.dy = 0;
+                for (int c = 0; c < kw; ++c) {
+                    if (v[c] != T{0}) { this->addEntry (rx, kx0 + c, v[c]); }
+                }
+                this->rows_x.push_back (rx);
+                for (int r = 0; r < kh; ++r) {
+                    if (u[r] == T{0}) { continue; }
+                    KernelRow ry;
+                    ry.dy = ky0 + r;
+                    this->addEntry (ry, 0, u[r]);
+                    this->rows_y.push_back (ry);
+                }
+            } else {
+                for (int r = 0; r < kh; ++r) {
+                    KernelRow kr;
+                    kr.dy = ky0 + r;
+                    for (int c = 0; c < kw; ++c) {
+                        if (dense[r * kw + c] != T{0}) { this->addEntry (kr, kx0 + c, dense[r * kw + c]); }
+                    }
+                    if (!kr.entries.empty()) { this->rows_2d.push_back (kr); }
+                }
+            }
+        }
+
+        /*!
+         * Convolve \a data (defined on the domain CartGrid) with the compiled kernel,
+         * writing the result into \a result. Both must be of the domain's size, and
+         * must be separate memory.
+         */
+        void convolve (const std::vector<T>& data, std::vector<T>& result) const
+        {
+            if (data.size() != this->n) {
+                throw std::runtime_error ("The data vector is not the same size as the CartGrid.");
+            }
+            if (result.size() != this->n) {
+                throw std::runtime_error ("The result vector is not the same size as the CartGrid.");
+            }
+            if (&data == &result) {
+                throw std::runtime_error ("Pass in separate memory for the result.");
+            }
+            if (this->separable) {
+                std::vector<T> tmp (this->n);
+                this->apply (this->rows_x, data.data(), tmp.data());
+                this->apply (this->rows_y, tmp.data(), result.data());
+            } else {
+                this->apply (this->rows_2d, data.data(), result.data());
+            }
+        }
+
+        //! True if the kernel was factored into a row and a column
+        bool isSeparable() const { return this->separable; }
+
+        //! The number of domain rects for which the kernel was compiled
+        size_t size() const { return this->n; }
+
+    private:
+        /*!
+         * One kernel rect at column offset dx: the ranges of domain columns, [x0, x1)
+         * and (if the domain wraps) [wx0, wx1), for which the source column x + dx (or
+         * x + dx + wshift) exists.
+         */
+        struct KernelEntry
+        {
+            T k = T{0};
+            int dx = 0;
+            int x0 = 0;
+            int x1 = 0;
+            int wx0 = 0;
+            int wx1 = 0;
+            int wshift = 0;
+        };
+
+        //! The kernel rects at one row offset dy
+        struct KernelRow
+        {
+            int dy = 0;
+            std::vector<KernelEntry> entries;
+        };
+
+        //! Check that \a domain is a rectangular raster and record its size and wrapping
+        void setDomain (const CartGrid& domain)
+        {
+            if (!domain.withRects) {
+                // A CartGrid without Rects is a raster of w_px by h_px, described by its d_ vectors
+                this->n = domain.num();
+                this->w = domain.w_px;
+                this->h = domain.h_px;
+                this->wrap_x = this->w > 0 && domain.d_ne[this->w - 1] > -1;
+                this->wrap_y = this->n > 0 && domain.d_nn[this->n - this->w] > -1;
+                return;
+            }
+            int x0 = std::numeric_limits<int>::max();
+            int x1 = std::numeric_limits<int>::min();
+            int y0 = std::numeric_limits<int>::max();
+            int y1 = std::numeric_limits<int>::min();
+            for (auto r : domain.rects) {
+                x0 = std::min (x0, r.xi);
+                x1 = std::max (x1, r.xi);
+                y0 = std::min (y0, r.yi);
+                y1 = std::max (y1, r.yi);
+            }
+            this->n = domain.rects.size();
+            this->w = this->n > 0 ? x1 - x0 + 1 : 0;
+            this->h = this->n > 0 ? y1 - y0 + 1 : 0;
+            if (static_cast<size_t>(this->w) * this->h != this->n) {
+                throw std::runtime_error ("CartGridKernel: The domain CartGrid is not a complete rectangle of rects.");
+            }
+            this->wrap_x = false;
+            this->wrap_y = false;
+            for (auto r : domain.rects) {
+                if (r.vi != static_cast<unsigned int>((r.yi - y0) * this->w + r.xi - x0)) {
+                    throw std::runtime_error ("CartGridKernel: The domain CartGrid's rects are not in raster order.");
+                }
+                if (r.xi == x1 && r.yi == y0) { this->wrap_x = r.has_ne(); }
+                if (r.xi == x0 && r.yi == y1) { this->wrap_y = r.has_nn(); }
+            }
+        }
+
+        //! Add the kernel rect at column offset \a dx, with weight \a k, to \a row
+        void addEntry (KernelRow& row, const int dx, const T k) const
+        {
+            KernelEntry e;
+            e.k = k;
+            e.dx = dx;
+            if (this->wrap_x) {
+                // The source column is (x + dx) mod w
+                const int dm = ((dx % this->w) + this->w) % this->w;
+                e.dx = dm;
+                e.x0 = 0;
+                e.x1 = this->w - dm;
+                e.wx0 = this->w - dm;
+                e.wx1 = this->w;
+                e.wshift = dm - this->w;
+            } else {
+                e.x0 = std::max (0, -dx);
+                e.x1 = std::max (e.x0, std::min (this->w, this->w - dx));
+            }
+            row.entries.push_back (e);
+        }
+
+        //! The source row for domain row \a y and row offset \a dy, or -1 if there is none
+        int sourceRow (const int y, const int dy) const
+        {
+            int sy = y + dy;
+            if (this->wrap_y) { return ((sy % this->h) + this->h) % this->h; }
+            return (sy < 0 || sy >= this->h) ? -1 : sy;
+        }
+
+        //! Convolve \a in with the kernel rows \a krows, into \a out
+        void apply (const std::vector<KernelRow>& krows, const T* in, T* out) const
+        {
+#pragma omp parallel for
+            for (int y = 0; y < this->h; ++y) {
+                T* orow = out + static_cast<size_t>(y) * this->w;
+                std::fill (orow, orow + this->w, T{0});
+                for (const KernelRow& kr : krows) {
+                    const int sy = this->sourceRow (y, kr.dy);
+                    if (sy < 0) { continue; }
+                    const T* irow = in + static_cast<size_t>(sy) * this->w;
+                    for (const KernelEntry& e : kr.entries) {
+                        const T k = e.k;
+                        const int dx = e.dx;
+                        const int wshift = e.wshift;
+#pragma omp simd
+                        for (int x = e.x0; x < e.x1; ++x) { orow[x] += k * irow[x + dx]; }
+#pragma omp simd
+                        for (int x = e.wx0; x < e.wx1; ++x) { orow[x] += k * irow[x + wshift]; }
+                    }
+                }
+            }
+        }
+
+        //! The number of domain rects
+        size_t n = 0;
+        //! The width and height of the domain, in rects
+        int w = 0;
+        int h = 0;
+        //! Whether the domain wraps in x and in y
+        bool wrap_x = false;
+        bool wrap_y = false;
+        //! True if the kernel is applied as a pass along x followed by a pass along y
+        bool separable = false;
+        //! The kernel rows for a general kernel
+        std::vector<KernelRow> rows_2d;
+        //! The single row and the column (one entry per row) of a separable kernel
+        std::vector<KernelRow> rows_x;
+        std::vector<KernelRow> rows_y;
+    };
+
+} // namespace morph
@@ -0,0 +1,179 @@
+/*!
+ * \file DistanceTransform.h
+ *
+ * Distance transforms for the grids of morphologica (HexGrid, CartGrid). These are
+ * used to compute each element's distance to the nearest boundary element in linear
+ * time, rather than by comparing every element with every boundary element.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace morph {
+
+    //! The metric used to measure distances on a grid
+    enum class DistanceMetric
+    {
+        Euclidean, // Straight line distance to the nearest source element
+        HopCount   // Number of neighbour-to-neighbour steps to a source element, times the step length
+    };
+
+    /*!
+     * Distance transforms.
+     *
+     * sqdist_2d() is the exact, separable squared Euclidean distance transform of
+     * Felzenszwalb & Huttenlocher ("Distance Transforms of Sampled Functions",
+     * Theory of Computing 8, 2012), applied to a regular w by h lattice with
+     * spacings sx and sy. A HexGrid maps onto such a lattice: the hex at (ri,gi)
+     * has x = (2ri+gi) d/2 and y = gi v, so it sits at column 2ri+gi of a lattice
+     * with sx = d/2 and sy = v.
+     *
+     * hops() is a breadth first search from all of the source elements at once,
+     * following d_ne-style neighbour vectors (in which -1 means 'no neighbour').
+     */
+    struct DistanceTransform
+    {
+        //! The value used to represent 'infinitely far from any source'
+        static constexpr float inf = std::numeric_limits<float>::max();
+
+        /*!
+         * One dimensional squared distance transform of the sampled function f (which
+         * is inf at non-source samples) with sample spacing s. The result is written
+         * to out. v and z are working storage.
+         */
+        static void sqdist_1d (const std::vector<float>& f, std::vector<float>& out, const float s,
+                               std::vector<int>& v, std::vector<float>& z)
+        {
+            const int n = static_cast<int>(f.size());
+            const float s2 = s * s;
+            v.resize (n);
+            z.resize (n + 1);
+            // Build the lower envelope of the parabolas s2 (x-p)^2 + f(p) of the finite samples
+            int k = -1;
+            for (int q = 0; q < n; ++q) {
+                if (f[q] == inf) { continue; }
+                if (k < 0) {
+                    k = 0;
+                    v[0] = q;
+                    z[0] = -inf;
+                    z[1] = inf;
+                    continue;
+                }
+                const int p0 = v[k];
+                float sx = ((f[q] + s2 * q * q) - (f[p0] + s2 * p0 * p0)) / (2.0f * s2 * (q - p0));
+                // z[0] is -inf, so this never pops the first parabola
+                while (sx <= z[k]) {
+                    --k;
+                    const int p = v[k];
+                    sx = ((f[q] + s2 * q * q) - (f[p] + s2 * p * p)) / (2.0f * s2 * (q - p));
+                }
+                ++k;
+                v[k] = q;
+                z[k] = sx;
+                z[k+1] = inf;
+            }
+
+            out.resize (n);
+            if (k < 0) {
+                for (int q = 0; q < n; ++q) { out[q] = inf; }
+                return;
+            }
+            int j = 0;
+            for (int q = 0; q < n; ++q) {
+                while (z[j+1] < static_cast<float>(q)) { ++j; }
+                const float dq = static_cast<float>(q - v[j]);
+                out[q] = s2 * dq * dq + f[v[j]];
+            }
+        }
+
+        /*!
+         * Two dimensional squared Euclidean distance transform. On entry, grid (of size
+         * w * h, row major, so that element (i,j) is at grid[j*w+i]) is 0 at source
+         * elements and inf elsewhere. On exit, it holds the squared distance to the
+         * nearest source, or inf if there were no sources. sx and sy are the lattice
+         * spacings. If parallel is true, the rows (then the columns) are processed in
+         * an OpenMP parallel loop.
+         */
+        static void sqdist_2d (std::vector<float>& grid, const int w, const int h,
+                               const float sx, const float sy, const bool parallel = false)
+        {
+            // Transform along each row
+#pragma omp parallel if(parallel)
+            {
+                std::vector<float> f (w);
+                std::vector<float> out (w);
+                std::vector<int> v;
+                std::vector<float> z;
+#pragma omp for
+                for (int j = 0; j < h; ++j) {
+                    for (int i = 0; i < w; ++i) { f[i] = grid[j*w+i]; }
+                    sqdist_1d (f, out, sx, v, z);
+                    for (int i = 0; i < w; ++i) { grid[j*w+i] = out[i]; }
+                }
+            }
+            // Then along each column
+#pragma omp parallel if(parallel)
+            {
+                std::vector<float> f (h);
+                std::vector<float> out (h);
+                std::vector<int> v;
+                std::vector<float> z;
+#pragma omp for
+                for (int i = 0; i < w; ++i) {
+                    for (int j = 0; j < h; ++j) { f[j] = grid[j*w+i]; }
+                    sqdist_1d (f, out, sy, v, z);
+                    for (int j = 0; j < h; ++j) { grid[j*w+i] = out[j]; }
+                }
+            }
+        }
+
+        /*!
+         * Hop count distance. Breadth first search through the elements which are
+         * inside, starting from all of the source elements. Each step adds hopstep to
+         * the distance. Source elements get 0. Elements that are not inside get
+         * outside_val. Inside elements that can't be reached from a source get -1.
+         *
+         * \tparam N The number of neighbour vectors (6 for a HexGrid, 8 for a CartGrid)
+         */
+        template <size_t N>
+        static void hops (const std::array<const std::vector<int>*, N>& nbrs,
+                          const std::vector<char>& source, const std::vector<char>& inside,
+                          std::vector<float>& dist, const float hopstep, const float outside_val = -100.0f)
+        {
+            const size_t n = source.size();
+            dist.assign (n, -1.0f);
+            std::vector<int> frontier;
+            for (size_t i = 0; i < n; ++i) {
+                if (!inside[i]) {
+                    dist[i] = outside_val;
+                } else if (source[i]) {
+                    dist[i] = 0.0f;
+                    frontier.push_back (static_cast<int>(i));
+                }
+            }
+            std::vector<int> next;
+            unsigned int nhops = 0;
+            while (!frontier.empty()) {
+                const float level = ++nhops * hopstep;
+                next.clear();
+                for (int i : frontier) {
+                    for (size_t k = 0; k < N; ++k) {
+                        const int nb = (*nbrs[k])[i];
+                        if (nb > -1 && inside[nb] && dist[nb] == -1.0f) {
+                            dist[nb] = level;
+                            next.push_back (nb);
+                        }
+                    }
+                }
+                frontier.swap (next);
+            }
+        }
+    };
+
+} // namespace morph
@@ -0,0 +1,286 @@
+/*!
+ * \file FFT.h
+ *
+ * Self contained fast Fourier transforms: a 1D complex transform of any length and a
+ * 2D real transform of data laid out on a morph::Grid.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/vvec.h>
+#include <morph/mathconst.h>
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace morph {
+
+    /*!
+     * A 1D discrete Fourier transform of length n,
+     *
+     *   X[k] = sum_j x[j] exp (-2 pi i j k / n).
+     *
+     * If n is a power of 2, this is an iterative radix 2 FFT with precomputed twiddle
+     * factors. Otherwise, it is computed by Bluestein's algorithm, as a convolution
+     * with a power of 2 FFT of length at least 2n - 1. Either way, the cost is O(n log
+     * n).
+     *
+     * A FFT object may be shared between threads; each thread passes its own work
+     * buffer to transform().
+     */
+    template <typename T>
+    class FFT
+    {
+    public:
+        using cplx = std::complex<T>;
+
+        FFT (const unsigned int _n) : n(_n)
+        {
+            if (this->n == 0) { throw std::runtime_error ("FFT: The length must be non-zero"); }
+            if (FFT<T>::is_pow2 (this->n)) {
+                this->init_radix2 (this->n, this->twiddle, this->bitrev);
+            } else {
+                // Bluestein: x * chirp, convolved with conj(chirp)
+                this->m = 1;
+                while (this->m < 2 * this->n - 1) { this->m <<= 1; }
+                this->init_radix2 (this->m, this->twiddle, this->bitrev);
+                this->chirp.resize (this->n);
+                const unsigned long long twon = 2ull * this->n;
+                for (unsigned int k = 0; k < this->n; ++k) {
+                    // exp (-i pi k^2 / n), with k^2 reduced mod 2n to keep the angle accurate
+                    const unsigned long long k2 = (static_cast<unsigned long long>(k) * k) % twon;
+                    const double a = -morph::mathconst<double>::pi * static_cast<double>(k2) / this->n;
+                    this->chirp[k] = cplx (static_cast<T>(std::cos (a)), static_cast<T>(std::sin (a)));
+                }
+                this->chirp_fft.assign (this->m, cplx (0, 0));
+                this->chirp_fft[0] = std::conj (this->chirp[0]);
+                for (unsigned int k = 1; k < this->n; ++k) {
+                    this->chirp_fft[k] = std::conj (this->chirp[k]);
+                    this->chirp_fft[this->m - k] = std::conj (this->chirp[k]);
+                }
+                this->radix2 (this->chirp_fft.data(), this->m, false);
+                // Fold in the 1/m of the inverse transform in the convolution
+                const T sc = T{1} / static_cast<T>(this->m);
+                for (auto& c : this->chirp_fft) { c *= sc; }
+            }
+        }
+
+        unsigned int size() const { return this->n; }
+
+        /*!
+         * Transform the n values in x, in place. The inverse transform includes the
+         * factor 1/n, so that it undoes the forward transform. work is resized as
+         * required (it is only used for lengths that are not powers of 2).
+         */
+        void transform (cplx* x, const bool inverse, std::vector<cplx>& work) const
+        {
+            if (this->m == 0) {
+                this->radix2 (x, this->n, inverse);
+            } else {
+                // An inverse transform is a forward transform of the conjugate
+                if (inverse) { for (unsigned int k = 0; k < this->n; ++k) { x[k] = std::conj (x[k]); } }
+                work.assign (this->m, cplx (0, 0));
+                for (unsigned int k = 0; k < this->n; ++k) { work[k] = x[k] * this->chirp[k]; }
+                this->radix2 (work.data(), this->m, false);
+                for (unsigned int k = 0; k < this->m; ++k) { work[k] *= this->chirp_fft[k]; }
+                this->radix2 (work.data(), this->m, true);
+                for (unsigned int k = 0; k < this->n; ++k) { x[k] = work[k] * this->chirp[k]; }
+                if (inverse) { for (unsigned int k = 0; k < this->n; ++k) { x[k] = std::conj (x[k]); } }
+            }
+            if (inverse) {
+                const T sc = T{1} / static_cast<T>(this->n);
+                for (unsigned int k = 0; k < this->n; ++k) { x[k] *= sc; }
+            }
+        }
+
+        //! Transform x, allocating a work buffer if necessary
+        void transform (std::vector<cplx>& x, const bool inverse) const
+        {
+            if (x.size() != this->n) { throw std::runtime_error ("FFT::transform: x is the wrong size"); }
+            std::vector<cplx> work;
+            this->transform (x.data(), inverse, work);
+        }
+
+        static bool is_pow2 (const unsigned int v) { return v != 0 && (v & (v - 1)) == 0; }
+
+    private:
+        //! Set up twiddle factors and the bit reversal permutation for length len
+        static void init_radix2 (const unsigned int len, std::vector<cplx>& tw, std::vector<unsigned int>& br)
+        {
+            tw.resize (len / 2);
+            for (unsigned int k = 0; k < len / 2; ++k) {
+                const double a = -2.0 * morph::mathconst<double>::pi * k / len;
+                tw[k] = cplx (static_cast<T>(std::cos (a)), static_cast<T>(std::sin (a)));
+            }
+            br.resize (len);
+            unsigned int bits = 0;
+            while ((1u << bits) < len) { ++bits; }
+            for (unsigned int k = 0; k < len; ++k) {
+                unsigned int r = 0;
+                for (unsigned int b = 0; b < bits; ++b) { r |= ((k >> b) & 1u) << (bits - 1 - b); }
+                br[k] = r;
+            }
+        }
+
+        //! In place radix 2 FFT of length len (which is n or m). No 1/len scaling.
+        void radix2 (cplx* x, const unsigned int len, const bool inverse) const
+        {
+            for (unsigned int k = 0; k < len; ++k) {
+                const unsigned int r = this->bitrev[k];
+                if (r > k) { std::swap (x[k], x[r]); }
+            }
+            for (unsigned int half = 1; half < len; half <<= 1) {
+                const unsigned int tstride = len / (2 * half);
+                for (unsigned int start = 0; start < len; start += 2 * half) {
+                    for (unsigned int j = 0; j < half; ++j) {
+                        const cplx w = inverse ? std::conj (this->twiddle[j * tstride]) : this->twiddle[j * tstride];
+                        const cplx t = w * x[start + j + half];
+                        x[start + j + half] = x[start + j] - t;
+                        x[start + j] += t;
+                    }
+                }
+            }
+        }
+
+        //! The transform length
+        unsigned int n = 0;
+        //! The length of the padded transform for Bluestein's algorithm; 0 if n is a power of 2
+        unsigned int m = 0;
+        std::vector<cplx> twiddle;
+        std::vector<unsigned int> bitrev;
+        //! exp (-i pi k^2 / n)
+        std::vector<cplx> chirp;
+        //! The transform of the (periodically extended, length m) conjugate chirp
+        std::vector<cplx> chirp_fft;
+    };
+
+    /*!
+     * The 2D Fourier transform of real data on a rectangular grid of nx by ny
+     * elements, stored with x varying fastest (row major, as morph::Grid with
+     * GridOrder::bottomleft_to_topright or topleft_to_bottomright; for the column major
+     * orders, pass ny as nx and vice versa).
+     *
+     * Because the data are real, only half of the spectrum is stored: the spectrum has
+     * ny rows of nx/2 + 1 complex values, element (kx, ky) at index ky * (nx/2 + 1) +
+     * kx. Wavenumber index ky runs from 0 to ny - 1, where ky > ny/2 stands for the
+     * negative wavenumber ky - ny.
+     */
+    template <typename T>
+    class FFT2
+    {
+    public:
+        using cplx = std::complex<T>;
+
+        FFT2 (const unsigned int _nx, const unsigned int _ny)
+            : nx(_nx), ny(_ny), nxh(_nx / 2 + 1), fx(_nx), fy(_ny) {}
+
+        //! The number of complex values in the half spectrum
+        size_t spectrum_size() const { return static_cast<size_t>(this->nxh) * this->ny; }
+
+        /*!
+         * Forward transform of the real data u (nx * ny values) into the half spectrum
+         * spec.
+         */
+        void forward (const morph::vvec<T>& u, std::vector<cplx>& spec) const
+        {
+            if (u.size() != static_cast<size_t>(this->nx) * this->ny) {
+                throw std::runtime_error ("FFT2::forward: The data is not nx * ny in size");
+            }
+            spec.resize (this->spectrum_size());
+            const int npairs = static_cast<int>((this->ny + 1) / 2);
+#pragma omp parallel
+            {
+                std::vector<cplx> z (std::max (this->nx, this->ny));
+                std::vector<cplx> work;
+                // Rows: two real rows are transformed together as the real and imaginary
+                // parts of one complex row
+#pragma omp for schedule(static)
+                for (int p = 0; p < npairs; ++p) {
+                    const unsigned int r0 = 2 * p;
+                    const bool two = r0 + 1 < this->ny;
+                    const T* a = u.data() + static_cast<size_t>(r0) * this->nx;
+                    const T* b = two ? a + this->nx : nullptr;
+                    for (unsigned int j = 0; j < this->nx; ++j) { z[j] = cplx (a[j], two ? b[j] : T{0}); }
+                    this->fx.transform (z.data(), false, work);
+                    cplx* sa = spec.data() + static_cast<size_t>(r0) * this->nxh;
+                    for (unsigned int k = 0; k < this->nxh; ++k) {
+                        const cplx zk = z[k];
+                        const cplx zc = std::conj (z[k == 0 ? 0 : this->nx - k]);
+                        sa[k] = (zk + zc) * T{0.5};
+                        if (two) { sa[this->nxh + k] = (zk - zc) * cplx (T{0}, T{-0.5}); }
+                    }
+                }
+                this->columns (spec, false, z, work);
+            }
+        }
+
+        /*!
+         * Inverse transform of the half spectrum spec into the real data u, which is
+         * resized to nx * ny. spec is used as workspace, and is overwritten.
+         */
+        void inverse (std::vector<cplx>& spec, morph::vvec<T>& u) const
+        {
+            if (spec.size() != this->spectrum_size()) {
+                throw std::runtime_error ("FFT2::inverse: The spectrum is the wrong size");
+            }
+            u.resize (static_cast<size_t>(this->nx) * this->ny);
+            const int npairs = static_cast<int>((this->ny + 1) / 2);
+#pragma omp parallel
+            {
+                std::vector<cplx> z (std::max (this->nx, this->ny));
+                std::vector<cplx> work;
+                this->columns (spec, true, z, work);
+                // Rows: the spectra of rows r0 and r0 + 1 are extended to full length
+                // (X[nx - k] = conj (X[k])) and combined as X0 + i X1
+#pragma omp for schedule(static)
+                for (int p = 0; p < npairs; ++p) {
+                    const unsigned int r0 = 2 * p;
+                    const bool two = r0 + 1 < this->ny;
+                    const cplx* sa = spec.data() + static_cast<size_t>(r0) * this->nxh;
+                    const cplx* sb = two ? sa + this->nxh : nullptr;
+                    const cplx iu (T{0}, T{1});
+                    for (unsigned int k = 0; k < this->nxh; ++k) {
+                        z[k] = two ? sa[k] + iu * sb[k] : sa[k];
+                    }
+                    for (unsigned int k = this->nxh; k < this->nx; ++k) {
+                        const unsigned int kc = this->nx - k;
+                        z[k] = two ? std::conj (sa[kc]) + iu * std::conj (sb[kc]) : std::conj (sa[kc]);
+                    }
+                    this->fx.transform (z.data(), true, work);
+                    T* a = u.data() + static_cast<size_t>(r0) * this->nx;
+                    for (unsigned int j = 0; j < this->nx; ++j) { a[j] = z[j].real(); }
+                    if (two) {
+                        T* b = a + this->nx;
+                        for (unsigned int j = 0; j < this->nx; ++j) { b[j] = z[j].imag(); }
+                    }
+                }
+            }
+        }
+
+        unsigned int get_nx() const { return this->nx; }
+        unsigned int get_ny() const { return this->ny; }
+
+    private:
+        //! Transform each of the nxh columns of spec. Called in an OpenMP parallel region.
+        void columns (std::vector<cplx>& spec, const bool inverse, std::vector<cplx>& z, std::vector<cplx>& work) const
+        {
+#pragma omp for schedule(static)
+            for (int k = 0; k < static_cast<int>(this->nxh); ++k) {
+                for (unsigned int r = 0; r < this->ny; ++r) { z[r] = spec[static_cast<size_t>(r) * this->nxh + k]; }
+                this->fy.transform (z.data(), inverse, work);
+                for (unsigned int r = 0; r < this->ny; ++r) { spec[static_cast<size_t>(r) * this->nxh + k] = z[r]; }
+            }
+        }
+
+        unsigned int nx = 1;
+        unsigned int ny = 1;
+        //! The number of stored x wavenumbers, nx / 2 + 1
+        unsigned int nxh = 1;
+        FFT<T> fx;
+        FFT<T> fy;
+    };
+
+} // namespace morph
@@ -18,6 +18,7 @@
 #include <morph/vec.h>
 #include <morph/vvec.h>
 #include <morph/GridFeatures.h>
+#include <morph/ImageSampler.h>
 
 namespace morph {
 
@@ -618,6 +619,41 @@ namespace morph {
             return index < n ? index / h : std::numeric_limits<I>::max();
         }
 
+        /*!
+         * The placement of an image of \a image_w by \a image_h pixels on this Grid, as
+         * used by resample_image: the image is scaled to the width of the Grid, then by
+         * \a image_scale, and its first pixel is at \a image_offset.
+         */
+        morph::ImageSampler image_sampler (const unsigned int image_w, const unsigned int image_h,
+                                           const morph::vec<float, 2>& image_scale,
+                                           const morph::vec<float, 2>& image_offset) const
+        {
+            if (this->order != morph::GridOrder::bottomleft_to_topright) {
+                throw std::runtime_error ("Grid::resample_image: resampling assumes image has morph::GridOrder::bottomleft_to_topright, so your Grid should, too.");
+            }
+            morph::vec<unsigned int, 2> image_pixelsz = { image_w, image_h };
+
+            // Before scaling, image assumed to have width 1, height whatever
+            morph::vec<float, 2> image_dims = { 1.0f, 0.0f };
+            image_dims[1] = 1.0f / (image_pixelsz[0] - 1u) * (image_pixelsz[1] - 1u);
+            // Now scale the image dims to have the same width as *this:
+            image_dims *= this->width();
+            // Then apply any manual scaling requested:
+            image_dims *= image_scale;
+
+            // Distance per pixel in the image. This defines the Gaussian width (sigma) for the
+            // resample. Compute this from the image dimensions, assuming pixels are square
+            morph::vec<float, 2> dist_per_pix = image_dims / (image_pixelsz - 1u);
+
+            // The input pixel at index idx is at (dist_per_pix * idx) + image_offset (in target units)
+            morph::ImageSampler sampler;
+            sampler.w = image_pixelsz[0];
+            sampler.h = image_pixelsz[1];
+            sampler.dist_per_pix = dist_per_pix;
+            sampler.origin = image_offset;
+            return sampler;
+        }
+
         /*!
          * Resampling function (monochrome).
          *
@@ -630,14 +666,19 @@ namespace morph {
          * \param image_pixelwidth (input) The number of pixels that the image is wide
          * \param image_scale (input) The size that the image should be resampled to (same units as Grid)
          * \param image_offset (input) An offset in Grid units to shift the image wrt to the Grid's origin
-         * \param sigma (input) The sigma for the 2D resampling Gaussian
+         * \param mode (input) ResampleMode::Gaussian to sum the image pixels within 3 sigma
+         * of each Grid pixel, weighted by a 2D Gaussian with sigma equal to the (scaled)
+         * image pixel spacing, or ResampleMode::Bilinear for a fast, bilinearly
+         * interpolated preview. Only the image pixels inside the 3 sigma window of each
+         * Grid pixel are visited (see morph::ImageSampler).
          *
          * \return A new data vvec containing the resampled (and renormalised) hex pixel values
          */
         morph::vvec<float> resample_image (const morph::vvec<float>& image_data,
                                            const unsigned int image_pixelwidth,
                                            const morph::vec<float, 2>& image_scale,
-                                           const morph::vec<float, 2>& image_offset) const
+                                           const morph::vec<float, 2>& image_offset,
+                                           const ResampleMode mode = ResampleMode::Gaussian) const
         {
             if (this->order != morph::GridOrder::bottomleft_to_topright) {
                 throw std::runtime_error ("Grid::resample_image: resampling assumes image has morph::GridOrder::bottomleft_to_topright, so your Grid should, too.");
@@ -661,41 +702,14 @@ namespace morph {
                 return expr_resampled;
             }
 
-            unsigned int csz = image_data.size();
-            morph::vec<unsigned int, 2> image_pixelsz = {image_pixelwidth, csz / image_pixelwidth};
+            const morph::ImageSampler sampler = this->image_sampler (image_pixelwidth, image_data.size() / image_pixelwidth,
+                                                                     image_scale, image_offset);
 
-            // Before scaling, image assumed to have width 1, height whatever
-            morph::vec<float, 2> image_dims = { 1.0f, 0.0f };
-            image_dims[1] = 1.0f / (image_pixelsz[0] - 1u) * (image_pixelsz[1] - 1u);
-            // Now scale the image dims to have the same width as *this:
-            image_dims *= this->width();
-            // Then apply any manual scaling requested:
-            image_dims *= image_scale;
-
-            // Distance per pixel in the image. This defines the Gaussian width (sigma) for the
-            // resample. Compute this from the image dimensions, assuming pixels are square
-            morph::vec<float, 2> dist_per_pix = image_dims / (image_pixelsz - 1u);
-
-            // Parameters for the Gaussian computation
-            morph::vec<float, 2> params = 1.0f / (2.0f * dist_per_pix * dist_per_pix);
-            morph::vec<float, 2> threesig = 3.0f * dist_per_pix;
-
-#pragma omp parallel for // parallel on this outer loop gives best result (5.8 s vs 7 s)
-            for (typename std::vector<float>::size_type xi = 0u; xi < this->v_c.size(); ++xi) {
-                float expr = 0.0f;
-                for (unsigned int i = 0; i < csz; ++i) {
-                    // Get x/y pixel coords:
-                    morph::vec<unsigned int, 2> idx = {(i % image_pixelsz[0]), (i / image_pixelsz[0])};
-                    // Get the coordinates of the input pixel at index idx (in target units):
-                    morph::vec<float, 2> posn = (dist_per_pix * idx) + image_offset;
-                    // Distance from input pixel to output pixel:
-                    morph::vec<float, 2> _v_c = this->v_c[xi] - posn;
-                    // Compute contributions to each Grid pixel, using 2D (elliptical) Gaussian
-                    if (_v_c < threesig) { // Testing for distance gives slight speedup
-                        expr += std::exp ( - ( (params[0] * _v_c[0] * _v_c[0]) + (params[1] * _v_c[1] * _v_c[1]) ) ) * image_data[i];
-                    }
-                }
-                expr_resampled[xi] = expr;
+            const int nc = static_cast<int>(this->v_c.size());
+#pragma omp parallel for schedule(static)
+            for (int xi = 0; xi < nc; ++xi) {
+                expr_resampled[xi] = sampler.sample (image_data.data(), static_cast<float>(this->v_c[xi][0]),
+                                                     static_cast<float>(this->v_c[xi][1]), mode);
             }
 
             expr_resampled /= expr_resampled.max(); // renormalise result
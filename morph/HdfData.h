@@ -24,6 +24,7 @@
 #include <morph/vec.h>
 #include <morph/vvec.h>
 #include <morph/tools.h>
+#include <morph/float16.h>
 
 #ifdef __WIN__
 #define __PRETTY_FUNCTION__ __FUNCSIG__
@@ -83,6 +84,32 @@ namespace morph {
             }
         }
 
+        /*!
+         * Make the HDF5 floating point datatype for T, which is float16 or bfloat16:
+         * 16 bits, little endian, with the sign in bit 15. HDF5 converts it to and from
+         * the native float types, and h5py reads the float16 type as numpy.float16.
+         * The caller must H5Tclose the type.
+         */
+        template <typename T>
+        hid_t float16_type() const
+        {
+            hid_t tid = H5Tcopy (H5T_IEEE_F32LE);
+            herr_t status = 0;
+            if constexpr (std::is_same<std::decay_t<T>, morph::float16>::value == true) {
+                status = H5Tset_fields (tid, 15, 10, 5, 0, 10);
+                if (status >= 0) { status = H5Tset_size (tid, 2); }
+                if (status >= 0) { status = H5Tset_ebias (tid, 15); }
+            } else {
+                status = H5Tset_fields (tid, 15, 7, 8, 0, 7);
+                if (status >= 0) { status = H5Tset_size (tid, 2); }
+            }
+            if (status < 0) {
+                H5Tclose (tid);
+                throw std::runtime_error ("HdfData::float16_type: Failed to make the 16 bit float datatype");
+            }
+            return tid;
+        }
+
         /*!
          * Open a dataset, by creating it, unless we're in read-write mode. In that
          * case, create it and if that fails, open it. When opening for writing, this
@@ -381,6 +408,11 @@ namespace morph {
                                  || std::is_same<typename std::decay<T>::type, std::pair<double, double>>::value == true) {
                 status = H5Dread (dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &(invals[0]));
 
+            } else if constexpr (morph::is_float16<T>::value == true) {
+                hid_t tid = this->float16_type<T>();
+                status = H5Dread (dataset_id, tid, H5S_ALL, H5S_ALL, H5P_DEFAULT, &(invals[0]));
+                H5Tclose (tid);
+
             } else if constexpr (std::is_same<std::decay_t<T>, int>::value == true
                                  || std::is_same<typename std::decay<T>::type, std::array<int,2>>::value == true
                                  || std::is_same<typename std::decay<T>::type, morph::vec<int,2>>::value == true
@@ -1017,6 +1049,13 @@ namespace morph {
                 this->check_dataset_space_1_dim (dataset_id, vals.size());
                 status = H5Dwrite (dataset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &(outvals[0]));
 
+            } else if constexpr (morph::is_float16<T>::value == true) {
+                hid_t tid = this->float16_type<T>();
+                dataset_id = this->open_dataset (path, tid, dataspace_id);
+                this->check_dataset_space_1_dim (dataset_id, vals.size());
+                status = H5Dwrite (dataset_id, tid, H5S_ALL, H5S_ALL, H5P_DEFAULT, &(outvals[0]));
+                H5Tclose (tid);
+
             } else if constexpr (std::is_same<std::decay_t<T>, char>::value == true) {
                 dataset_id = this->open_dataset (path, H5T_STD_I64LE, dataspace_id);
                 this->check_dataset_space_1_dim (dataset_id, vals.size());
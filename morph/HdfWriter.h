@@ -0,0 +1,195 @@
+/*!
+ * \file HdfWriter.h
+ *
+ * A background writer of HDF5 snapshots, so that a simulation need not wait while its
+ * data is written to disk.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/HdfData.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <utility>
+
+namespace morph {
+
+    /*!
+     * Writes snapshots of data vectors to HDF5 files in a dedicated writer thread.
+     *
+     * save() copies the vectors into a staging buffer and returns; the writer thread
+     * then creates the file and writes each vector as a dataset with
+     * HdfData::add_contained_vals. The staging buffers are recycled, so once they have
+     * grown to size, save() costs a memcpy of each vector. At most capacity snapshots
+     * wait in the queue; if it is full, save() blocks until the writer has finished
+     * one. flush() waits for the queue to empty. The destructor writes any snapshots
+     * that are still queued before it returns.
+     *
+     * An exception thrown while writing is passed back to the caller by the next call
+     * to save() or flush().
+     *
+     * The HDF5 library is not usually built to be thread safe, so the program should
+     * not use HdfData in any other thread while snapshots are being written; call
+     * flush() first.
+     *
+     * \tparam T The element type of the data vectors
+     */
+    template <typename T>
+    class HdfWriter
+    {
+    public:
+        //! Start the writer thread, with a queue of at most \a _capacity snapshots
+        HdfWriter (const unsigned int _capacity = 2)
+        {
+            this->capacity = _capacity > 0 ? _capacity : 1;
+            this->writer = std::thread (&HdfWriter<T>::run, this);
+        }
+
+        //! Write any queued snapshots, then stop the writer thread
+        ~HdfWriter()
+        {
+            {
+                std::lock_guard<std::mutex> lk (this->m);
+                this->stopping = true;
+            }
+            this->cv_work.notify_all();
+            if (this->writer.joinable()) { this->writer.join(); }
+        }
+
+        HdfWriter (const HdfWriter&) = delete;
+        HdfWriter& operator= (const HdfWriter&) = delete;
+
+        /*!
+         * Queue a snapshot, to be written to the HDF5 file \a fname (which is truncated,
+         * as by HdfData). Each of \a datasets is a path within the file and a pointer to
+         * the vector to write there. The vectors are copied before save() returns.
+         */
+        void save (const std::string& fname, const std::vector<std::pair<std::string, const std::vector<T>*>>& datasets)
+        {
+            std::unique_ptr<Snapshot> snap;
+            {
+                std::unique_lock<std::mutex> lk (this->m);
+                this->rethrow();
+                this->cv_done.wait (lk, [this] { return this->queue.size() < this->capacity || this->error; });
+                this->rethrow();
+                if (!this->pool.empty()) {
+                    snap = std::move (this->pool.back());
+                    this->pool.pop_back();
+                }
+            }
+            if (!snap) { snap = std::make_unique<Snapshot>(); }
+
+            // Copy into the staging buffer. Its vectors keep their capacity from earlier
+            // snapshots, so this does not usually allocate.
+            snap->fname = fname;
+            snap->paths.resize (datasets.size());
+            snap->data.resize (datasets.size());
+            for (size_t i = 0; i < datasets.size(); ++i) {
+                snap->paths[i] = datasets[i].first;
+                snap->data[i].assign (datasets[i].second->begin(), datasets[i].second->end());
+            }
+
+            {
+                std::lock_guard<std::mutex> lk (this->m);
+                this->queue.push_back (std::move (snap));
+            }
+            this->cv_work.notify_one();
+        }
+
+        //! Wait until all of the queued snapshots have been written
+        void flush()
+        {
+            std::unique_lock<std::mutex> lk (this->m);
+            this->cv_done.wait (lk, [this] { return (this->queue.empty() && !this->busy) || this->error; });
+            this->rethrow();
+        }
+
+        //! The number of snapshots written so far
+        unsigned long long written() const
+        {
+            std::lock_guard<std::mutex> lk (this->m);
+            return this->nwritten;
+        }
+
+    private:
+        //! One snapshot: a file name and the datasets to write into it
+        struct Snapshot
+        {
+            std::string fname;
+            std::vector<std::string> paths;
+            std::vector<std::vector<T>> data;
+        };
+
+        //! The writer thread's loop
+        void run()
+        {
+            std::unique_lock<std::mutex> lk (this->m);
+            while (true) {
+                this->cv_work.wait (lk, [this] { return this->stopping || !this->queue.empty(); });
+                if (this->queue.empty()) { return; } // stopping, and nothing left to write
+                std::unique_ptr<Snapshot> snap = std::move (this->queue.front());
+                this->queue.pop_front();
+                this->busy = true;
+                lk.unlock();
+
+                std::exception_ptr ep;
+                try {
+                    HdfData data (snap->fname);
+                    for (size_t i = 0; i < snap->paths.size(); ++i) {
+                        data.add_contained_vals (snap->paths[i].c_str(), snap->data[i]);
+                    }
+                } catch (...) {
+                    ep = std::current_exception();
+                }
+
+                lk.lock();
+                this->busy = false;
+                if (ep) {
+                    if (!this->error) { this->error = ep; }
+                } else {
+                    ++this->nwritten;
+                }
+                this->pool.push_back (std::move (snap));
+                this->cv_done.notify_all();
+            }
+        }
+
+        //! Rethrow (once) an exception from the writer thread. Call with m locked.
+        void rethrow()
+        {
+            if (this->error) {
+                std::exception_ptr ep = this->error;
+                this->error = nullptr;
+                std::rethrow_exception (ep);
+            }
+        }
+
+        //! The maximum length of the queue
+        unsigned int capacity = 2;
+        //! Snapshots waiting to be written
+        std::deque<std::unique_ptr<Snapshot>> queue;
+        //! Written snapshots, whose buffers are reused
+        std::vector<std::unique_ptr<Snapshot>> pool;
+        //! True while the writer thread is writing a snapshot
+        bool busy = false;
+        //! Set by the destructor to stop the writer thread
+        bool stopping = false;
+        unsigned long long nwritten = 0;
+        //! An exception thrown in the writer thread
+        std::exception_ptr error;
+        mutable std::mutex m;
+        //! Signals the writer that there is work (or that it should stop)
+        std::condition_variable cv_work;
+        //! Signals that a snapshot has been written
+        std::condition_variable cv_done;
+        std::thread writer;
+    };
+
+} // namespace morph
@@ -17,6 +17,10 @@
 #include <morph/MathAlgo.h>
 #include <morph/debug.h>
 #include <morph/Matrix22.h>
+#include <morph/DistanceTransform.h>
+#include <morph/AlignedAllocator.h>
+#include <morph/ImageSampler.h>
+#include <morph/BinaryCache.h>
 
 // If the HexGrid::save and HexGrid::load methods are required, define
 // HEXGRID_COMPILE_LOAD_AND_SAVE. A link to libhdf5 will be required in your program.
@@ -25,6 +29,7 @@
 #endif
 
 #include <set>
+#include <unordered_set>
 #include <list>
 #include <string>
 #include <array>
@@ -36,9 +41,31 @@
 #include <vector>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#ifndef __WIN__
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 namespace morph {
 
+    /*!
+     * Orderings for the d_ vectors of a HexGrid, for use with HexGrid::renumber.
+     * These are all defined on the axial coordinates (ri,gi) of the hexes.
+     */
+    enum class HexDomainOrder
+    {
+        Raster,  // Row by row (increasing gi), each row left to right (increasing ri)
+        Morton,  // Z-order curve: the bits of ri and gi are interleaved
+        Hilbert  // Hilbert curve, which has better locality than the Z-order curve
+    };
+
     /*!
      * This class is used to build an hexagonal grid of hexagons. The member hexagons
      * are all arranged with a vertex pointing vertically - "point up". The extent of
@@ -96,6 +123,28 @@ namespace morph {
         alignas(8) std::vector<int> d_nsw;
         alignas(8) std::vector<int> d_nse;
 
+        //! One row of the packed neighbour table: the d_ indices of the neighbours E,
+        //! NE, NW, W, SW and SE (the order of Hex::get_neighbour).
+        using neighbour_row = std::array<std::int32_t, 6>;
+
+        /*!
+         * The packed neighbour table, built by build_neighbour_table(). Row i holds the
+         * six neighbours of hex i, so a stencil reads one 24 byte row per hex, rather
+         * than one element from each of six vectors. A missing neighbour holds the
+         * index d_nbrs_missing (if >= 0) or the index of the hex itself, which gives a
+         * 'ghost' neighbour with the same value as the hex (a no-flux boundary) with no
+         * need to test for neighbours in the stencil. The start of the table is 32 byte
+         * aligned.
+         */
+        std::vector<neighbour_row, morph::AlignedAllocator<neighbour_row, 32>> d_nbrs;
+
+        //! The value stored in d_nbrs for a missing neighbour, or -1 for 'the hex itself'
+        int d_nbrs_missing = -1;
+
+        //! Incremented each time d_nbrs is (re)built, so that users of the table can
+        //! tell when data derived from it is stale.
+        unsigned int d_nbrs_generation = 0;
+
         /*!
          * Flags, such as "on boundary", "inside boundary", "outside boundary", "has
          * neighbour east", etc.
@@ -200,6 +249,9 @@ namespace morph {
 
                 ++hi;
             }
+
+            this->build_ritable();
+            this->refresh_neighbour_table();
         }
 
         //! Clear out all the d_ vectors
@@ -211,6 +263,8 @@ namespace morph {
             this->d_gi.clear();
             this->d_bi.clear();
             this->d_flags.clear();
+            this->d_distToBoundary.clear();
+            this->ritable.clear();
         }
 
 #ifdef HEXGRID_COMPILE_LOAD_AND_SAVE
@@ -272,6 +326,9 @@ namespace morph {
             }
             hgdata.add_val ("/hcount", hcount);
 
+            // A grid built by init_flat() has no hexen; it is saved (and loaded) as d_ vectors only
+            if (this->hexen.empty()) { return; }
+
             // What about vhexen? Probably don't save and re-call method to populate.
             this->renumberVectorIndices();
 
@@ -429,9 +486,161 @@ namespace morph {
                     }
                 }
             }
+
+            this->build_ritable();
+            this->refresh_neighbour_table();
         }
 #endif // HEXGRID_COMPILE_LOAD_AND_SAVE
 
+        /*!
+         * The version of the binary cache format written by saveBinary(). Increment if
+         * the layout changes; loadBinary() rejects files of any other version.
+         */
+        static constexpr std::uint32_t binary_cache_version = 1;
+
+        /*!
+         * Compute a key for a binary cache of a HexGrid with hex to hex distance \a d_,
+         * span \a x_span_ and a boundary given by the points \a bpoints (as passed to
+         * setBoundary (std::vector<BezCoord<float>>&, bool)) and \a loffset. This is a
+         * 64 bit FNV-1a hash of these parameters.
+         */
+        static std::uint64_t cacheKey (float d_, float x_span_, const std::vector<BezCoord<float>>& bpoints,
+                                       bool loffset = true)
+        {
+            CacheKey k;
+            k.add (&binary_cache_version, sizeof binary_cache_version);
+            k.add (&d_, sizeof d_);
+            k.add (&x_span_, sizeof x_span_);
+            unsigned char lo = loffset ? 1 : 0;
+            k.add (&lo, 1);
+            for (const auto& bp : bpoints) {
+                float xy[2] = { bp.x(), bp.y() };
+                k.add (xy, sizeof xy);
+            }
+            return k.h;
+        }
+
+        /*!
+         * Compute a cache key for a HexGrid with a boundary set from the BezCurvePath
+         * \a p by setBoundary (const BezCurvePath<float>&, bool).
+         */
+        static std::uint64_t cacheKey (float d_, float x_span_, const BezCurvePath<float>& p, bool loffset = true)
+        {
+            std::vector<morph::BezCoord<float>> bpoints;
+            if (!p.isNull()) {
+                BezCurvePath<float> pc = p;
+                // As in setBoundary (const BezCurvePath<float>&, bool)
+                pc.computePoints (d_/2.0f, true);
+                bpoints = pc.getPoints();
+            }
+            return HexGrid::cacheKey (d_, x_span_, bpoints, loffset);
+        }
+
+        /*!
+         * Save the grid parameters and all of the d_ vectors into a flat binary file at
+         * \a path, tagged with the cache \a key (see cacheKey()). The Hexes in hexen
+         * are not saved; they can be recreated from the d_ vectors with build_hexen().
+         */
+        void saveBinary (const std::string& path, std::uint64_t key = 0) const
+        {
+            std::ofstream f (path, std::ios::binary | std::ios::trunc);
+            if (!f.is_open()) { throw std::runtime_error ("HexGrid::saveBinary: Failed to open " + path); }
+
+            BinaryCacheHeader hdr;
+            hdr.pre.key = key;
+            hdr.d = this->d;
+            hdr.v = this->v;
+            hdr.x_span = this->x_span;
+            hdr.z = this->z;
+            hdr.boundaryCentroid[0] = this->boundaryCentroid[0];
+            hdr.boundaryCentroid[1] = this->boundaryCentroid[1];
+            hdr.originalBoundaryCentroid[0] = this->originalBoundaryCentroid[0];
+            hdr.originalBoundaryCentroid[1] = this->originalBoundaryCentroid[1];
+            hdr.gridReduced = this->gridReduced ? 1 : 0;
+            hdr.d_rowlen = this->d_rowlen;
+            hdr.d_numrows = this->d_numrows;
+            hdr.d_size = this->d_size;
+            hdr.d_growthbuffer_horz = this->d_growthbuffer_horz;
+            hdr.d_growthbuffer_vert = this->d_growthbuffer_vert;
+            hdr.n = this->d_x.size();
+            f.write (reinterpret_cast<const char*>(&hdr), sizeof hdr);
+
+            const size_t n = this->d_x.size();
+            auto write_vec = [&f, n](const auto& vec) {
+                if (vec.size() != n) { throw std::runtime_error ("HexGrid::saveBinary: d_ vectors differ in size"); }
+                f.write (reinterpret_cast<const char*>(vec.data()), n * sizeof (vec[0]));
+            };
+            write_vec (this->d_x);
+            write_vec (this->d_y);
+            write_vec (this->d_ri);
+            write_vec (this->d_gi);
+            write_vec (this->d_bi);
+            write_vec (this->d_ne);
+            write_vec (this->d_nne);
+            write_vec (this->d_nnw);
+            write_vec (this->d_nw);
+            write_vec (this->d_nsw);
+            write_vec (this->d_nse);
+            write_vec (this->d_flags);
+            write_vec (this->d_distToBoundary);
+            if (!f.good()) { throw std::runtime_error ("HexGrid::saveBinary: Failed to write " + path); }
+        }
+
+        /*!
+         * Load a grid saved by saveBinary(). The file is memory mapped and the d_
+         * vectors are copied straight out of it; hexen is left empty (it is built on
+         * demand, as for init_flat()). Returns false, leaving this HexGrid unchanged, if
+         * the file does not exist, has the wrong version or does not match \a key. If
+         * \a key is 0, the key is not checked.
+         */
+        bool loadBinary (const std::string& path, std::uint64_t key = 0)
+        {
+            std::vector<char> buffer;
+            const char* data = nullptr;
+            size_t len = 0;
+#ifndef __WIN__
+            int fd = open (path.c_str(), O_RDONLY);
+            if (fd < 0) { return false; }
+            struct stat st;
+            if (fstat (fd, &st) != 0) { close (fd); return false; }
+            len = static_cast<size_t>(st.st_size);
+            void* mapped = len > 0 ? mmap (nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close (fd);
+            if (mapped == MAP_FAILED) { return false; }
+            data = static_cast<const char*>(mapped);
+#else
+            std::ifstream f (path, std::ios::binary | std::ios::ate);
+            if (!f.is_open()) { return false; }
+            len = static_cast<size_t>(f.tellg());
+            buffer.resize (len);
+            f.seekg (0);
+            f.read (buffer.data(), len);
+            data = buffer.data();
+#endif
+            bool ok = this->loadBinaryData (data, len, key);
+#ifndef __WIN__
+            munmap (const_cast<char*>(data), len);
+#endif
+            return ok;
+        }
+
+        /*!
+         * If a binary cache for this grid with boundary \a p exists at \a cachepath,
+         * load it. Otherwise, set the boundary with setBoundary (p, loffset) and write
+         * the cache to \a cachepath. Construct the HexGrid with init_flat() (e.g.
+         * HexGrid (d, x_span, z, false)) so that no list is built when the cache is hit.
+         *
+         * \return true if the grid was loaded from the cache.
+         */
+        bool setBoundaryCached (const BezCurvePath<float>& p, const std::string& cachepath, bool loffset = true)
+        {
+            std::uint64_t key = HexGrid::cacheKey (this->d, this->x_span, p, loffset);
+            if (this->loadBinary (cachepath, key)) { return true; }
+            this->setBoundary (p, loffset);
+            this->saveBinary (cachepath, key);
+            return false;
+        }
+
         /*!
          * Default constructor
          */
@@ -470,6 +679,100 @@ namespace morph {
             this->init();
         }
 
+        /*!
+         * Construct the hexagonal hex grid as for HexGrid (float, float, float), but
+         * if @a with_hexen is false, build the grid directly into the d_ vectors
+         * without creating the std::list<Hex> hexen. See init_flat().
+         */
+        HexGrid (float d_, float x_span_, float z_, bool with_hexen) : d(d_), x_span(x_span_), z(z_)
+        {
+            this->v = this->d * morph::mathconst<float>::root_3_over_2;
+            if (with_hexen) {
+                this->init();
+            } else {
+                this->init_flat();
+            }
+        }
+
+        /*!
+         * Initialise the hexagonal hex grid straight into the d_ vectors (d_x, d_y,
+         * d_ri, d_gi, d_bi, d_ne and friends, d_flags and d_distToBoundary). No Hex
+         * objects are created; hexen stays empty until build_hexen() is called. The
+         * d_ vectors are identical to those that init() followed by
+         * populate_d_vectors() would produce. Use this for very large grids, where the
+         * many small allocations of a std::list<Hex> are slow and memory hungry.
+         */
+        void init_flat (float d_, float x_span_, float z_ = 0.0f)
+        {
+            this->d = d_;
+            this->v = this->d * morph::mathconst<float>::root_3_over_2;
+            this->x_span = x_span_;
+            this->z = z_;
+            this->init_flat();
+        }
+
+        /*!
+         * Create hexen (and vhexen) from the d_ vectors. This is for client code which
+         * requires the std::list<Hex> after the grid was built with init_flat(). Any
+         * existing Hexes in hexen are discarded. Boundaries are applied to a flat grid
+         * on its d_ vectors, without hexen; only the methods which return Hex iterators
+         * (findHexNearest(), findHexAt(), getRegion() and getHexagonalRegion()) call
+         * this themselves if hexen has not yet been built.
+         */
+        void build_hexen()
+        {
+            this->hexen.clear();
+            this->vhexen.clear();
+            this->bhexen.clear();
+
+            const unsigned int n = this->d_x.size();
+            std::vector<std::list<morph::Hex>::iterator> hexits (n);
+            for (unsigned int i = 0; i < n; ++i) {
+                this->hexen.emplace_back (i, this->d, this->d_ri[i], this->d_gi[i]);
+                auto hi = this->hexen.end(); --hi;
+                hi->di = i;
+                hi->bi = this->d_bi[i];
+                if (hi->bi != 0) { hi->computeLocation(); }
+                // Neighbour flags are re-applied by the set_n* calls, below.
+                hi->setFlags (this->d_flags[i] & ~HEX_HAS_NEIGHB_ALL);
+                hi->distToBoundary = this->d_distToBoundary[i];
+                hexits[i] = hi;
+            }
+
+            for (unsigned int i = 0; i < n; ++i) {
+                if (this->d_ne[i] > -1) { hexits[i]->set_ne (hexits[this->d_ne[i]]); }
+                if (this->d_nne[i] > -1) { hexits[i]->set_nne (hexits[this->d_nne[i]]); }
+                if (this->d_nnw[i] > -1) { hexits[i]->set_nnw (hexits[this->d_nnw[i]]); }
+                if (this->d_nw[i] > -1) { hexits[i]->set_nw (hexits[this->d_nw[i]]); }
+                if (this->d_nsw[i] > -1) { hexits[i]->set_nsw (hexits[this->d_nsw[i]]); }
+                if (this->d_nse[i] > -1) { hexits[i]->set_nse (hexits[this->d_nse[i]]); }
+                if (hexits[i]->testFlags (HEX_IS_BOUNDARY) == true) { this->bhexen.push_back (&(*hexits[i])); }
+            }
+
+            this->renumberVectorIndices();
+
+            // The vertices of the original hexagonal grid are only meaningful if no
+            // boundary has been applied.
+            if (this->gridReduced == false && n > 0) {
+                int maxRing = 0;
+                for (unsigned int i = 0; i < n; ++i) {
+                    int ring = std::max (std::abs (this->d_ri[i]),
+                                         std::max (std::abs (this->d_gi[i]), std::abs (this->d_ri[i] + this->d_gi[i])));
+                    maxRing = std::max (maxRing, ring);
+                }
+                for (unsigned int i = 0; i < n; ++i) {
+                    const int r = this->d_ri[i];
+                    const int g = this->d_gi[i];
+                    if (r == -maxRing && g == maxRing) { this->vertexNW = hexits[i]; }
+                    if (r == 0 && g == maxRing) { this->vertexNE = hexits[i]; }
+                    if (r == maxRing && g == 0) { this->vertexE = hexits[i]; }
+                    if (r == maxRing && g == -maxRing) { this->vertexSE = hexits[i]; }
+                    if (r == 0 && g == -maxRing) { this->vertexSW = hexits[i]; }
+                    if (r == -maxRing && g == 0) { this->vertexW = hexits[i]; }
+                }
+            }
+        }
+
         /*!
          * Compute the centroid of the passed in list of Hexes.
          */
@@ -486,10 +789,12 @@ namespace morph {
 
         /*!
          * Find the Hex in the Hex grid which is closest to the x,y position given by
-         * pos.
+         * pos. This searches every Hex in hexen; prefer findHexIndex() where a d_
+         * index is sufficient.
          */
         std::list<Hex>::iterator findHexNearest (const morph::vec<float, 2>& pos)
         {
+            this->ensure_hexen();
             std::list<morph::Hex>::iterator nearest = this->hexen.end();
             std::list<morph::Hex>::iterator hi = this->hexen.begin();
             float dist = std::numeric_limits<float>::max();
@@ -506,9 +811,58 @@ namespace morph {
             return nearest;
         }
 
+        /*!
+         * Find the d_ index of the hex whose area contains the x,y position @a pos;
+         * that is, the nearest hex in the grid to @a pos. The position is rounded to
+         * the nearest (ri,gi) lattice coordinate in closed form, then looked up in a
+         * table of d_ indices, so this is O(1). Returns -1 if that lattice position is
+         * not a hex in the grid (e.g. if @a pos lies outside the boundary).
+         */
+        int findHexIndex (const morph::vec<float, 2>& pos) const
+        {
+            // Fractional axial coordinates. y = v*gi and x = d*ri + (d/2)*gi (bi is 0)
+            float gf = pos[1] / this->v;
+            float rf = pos[0] / this->d - gf / 2.0f;
+            // Round in cube coordinates (r + g + b' = 0), correcting the component
+            // with the largest rounding error.
+            float bf = -rf - gf;
+            float rr = std::round (rf);
+            float gr = std::round (gf);
+            float br = std::round (bf);
+            float rdiff = std::abs (rr - rf);
+            float gdiff = std::abs (gr - gf);
+            float bdiff = std::abs (br - bf);
+            if (rdiff > gdiff && rdiff > bdiff) {
+                rr = -gr - br;
+            } else if (gdiff > bdiff) {
+                gr = -rr - br;
+            }
+            return this->ritable_index (static_cast<int>(rr), static_cast<int>(gr));
+        }
+
+        /*!
+         * Find the d_ indices of the hexes containing each of the @a positions. The
+         * lookups are carried out in parallel. Elements of the returned vvec are -1
+         * for positions that do not lie within a hex of the grid.
+         */
+        morph::vvec<int> findHexIndex (const morph::vvec<morph::vec<float, 2>>& positions) const
+        {
+            morph::vvec<int> indices (positions.size(), -1);
+#pragma omp parallel for
+            for (size_t i = 0; i < positions.size(); ++i) {
+                indices[i] = this->findHexIndex (positions[i]);
+            }
+            return indices;
+        }
+
+        //! Find the d_ index of the hex at the axial coordinates (\a ri, \a gi), or -1
+        //! if there is no such hex in the grid. O(1).
+        int findHexIndex (const int ri, const int gi) const { return this->ritable_index (ri, gi); }
+
         // If possible, get the hex at the given rgb position
         std::list<Hex>::iterator findHexAt (const morph::vec<int, 3>& rgbpos)
         {
+            this->ensure_hexen();
             std::list<morph::Hex>::iterator hi = this->hexen.begin(); // First hex in hexen is always 0,0,0
 
             // +ri is East
@@ -553,20 +907,31 @@ namespace morph {
         {
             this->boundaryCentroid = this->computeCentroid (pHexes);
 
+            // Key the boundary hexes on their (ri,gi) coordinates. NB: The assumption right
+            // now is that the pHexes are from the same dimension hex grid as this->hexen.
+            std::unordered_set<std::uint64_t> pkeys;
+            pkeys.reserve (pHexes.size());
+            for (const auto& ph : pHexes) { pkeys.insert (HexGrid::axialKey (ph.ri, ph.gi)); }
+
+            if (this->is_flat()) {
+                int bpoint = 0;
+                for (unsigned int i = 0; i < this->d_x.size(); ++i) {
+                    if (pkeys.count (HexGrid::axialKey (this->d_ri[i], this->d_gi[i])) > 0) {
+                        this->d_flags[i] |= (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
+                        bpoint = i;
+                    }
+                }
+                this->flat_applyBoundary (bpoint, "The boundary is not a contiguous sequence of hexes.");
+                return;
+            }
+
             std::list<morph::Hex>::iterator bpoint = this->hexen.begin();
             std::list<morph::Hex>::iterator bpi = this->hexen.begin();
             while (bpi != this->hexen.end()) {
-                std::list<morph::Hex>::const_iterator ppi = pHexes.begin();
-                while (ppi != pHexes.end()) {
-                    // NB: The assumption right now is that the pHexes are from the same dimension hex grid
-                    // as this->hexen.
-                    if (bpi->ri == ppi->ri && bpi->gi == ppi->gi) {
-                        // Set h as boundary hex.
-                        bpi->setFlag (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
-                        bpoint = bpi;
-                        break;
-                    }
-                    ++ppi;
+                if (pkeys.count (HexGrid::axialKey (bpi->ri, bpi->gi)) > 0) {
+                    // Set h as boundary hex.
+                    bpi->setFlag (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
+                    bpoint = bpi;
                 }
                 ++bpi;
             }
@@ -649,6 +1014,16 @@ namespace morph {
             }
 
             // now proceed with centroid changed or unchanged
+            if (this->is_flat()) {
+                int nearby = 0; // i.e the hex at 0,0
+                for (const auto& bp : bpoints) {
+                    nearby = this->flat_findHexNearPoint (bp, nearby);
+                    this->d_flags[nearby] |= (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
+                }
+                this->flat_applyBoundary (nearby, "The constructed boundary is not a contiguous sequence of hexes.");
+                return;
+            }
+
             std::list<morph::Hex>::iterator nearbyBoundaryPoint = this->hexen.begin(); // i.e the Hex at 0,0
             bpi = bpoints.begin();
             while (bpi != bpoints.end()) {
@@ -698,6 +1073,21 @@ namespace morph {
             }
 
             // now proceed with centroid changed or unchanged. First: clear all boundary flags
+            if (this->is_flat()) {
+                for (auto& f : this->d_flags) { f &= ~HEX_IS_BOUNDARY; }
+                int nearby = 0; // i.e the hex at 0,0
+                for (const auto& bp : bpoints) {
+                    nearby = this->flat_findHexNearPoint (bp, nearby);
+                    this->d_flags[nearby] |= (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
+                }
+                std::set<unsigned int> seen;
+                if (this->flat_boundaryContiguous (nearby, nearby, seen) == false) {
+                    std::stringstream ee;
+                    ee << "The constructed boundary is not a contiguous sequence of hexes.";
+                    throw std::runtime_error (ee.str());
+                }
+                return;
+            }
             for (auto h : this->hexen) { h.unsetUserFlag (HEX_IS_BOUNDARY); }
 
             std::list<morph::Hex>::iterator nearbyBoundaryPoint = this->hexen.begin(); // i.e the Hex at 0,0
@@ -727,6 +1117,18 @@ namespace morph {
          */
         void setBoundaryOnOuterEdge()
         {
+            if (this->is_flat()) {
+                // On the initial hexagonal layout, the outer hexes are those which lack a neighbour
+                int bpoint = 0;
+                for (unsigned int i = 0; i < this->d_x.size(); ++i) {
+                    if ((this->d_flags[i] & HEX_HAS_NEIGHB_ALL) != HEX_HAS_NEIGHB_ALL) {
+                        this->d_flags[i] |= (HEX_IS_BOUNDARY | HEX_INSIDE_BOUNDARY);
+                        bpoint = i;
+                    }
+                }
+                this->flat_applyBoundary (bpoint, "The boundary is not a contiguous sequence of hexes.");
+                return;
+            }
             // From centre head to boundary, then mark boundary and walk
             // around the edge.
             std::list<morph::Hex>::iterator bpi = this->hexen.begin();
@@ -996,14 +1398,17 @@ namespace morph {
          *
          * return The number of hexes in the grid.
          */
-        unsigned int num() const { return this->hexen.size(); }
+        unsigned int num() const { return this->hexen.empty() ? this->d_x.size() : this->hexen.size(); }
 
         /*!
          * \brief Obtain the vector index of the last Hex in hexen.
          *
          * return Hex::vi from the last Hex in the grid.
          */
-        unsigned int lastVectorIndex() const { return this->hexen.rbegin()->vi; }
+        unsigned int lastVectorIndex() const
+        {
+            return this->hexen.empty() ? this->d_x.size() - 1 : this->hexen.rbegin()->vi;
+        }
 
         /*!
          * Output some text information about the hexgrid.
@@ -1149,35 +1554,83 @@ namespace morph {
         }
 
         /*!
-         * Run through all the hexes and compute the distance to the nearest boundary
-         * hex.
+         * Compute the distance from every hex to the nearest boundary hex. Boundary hexes
+         * get 0 and hexes outside the boundary get -100. If there is no boundary (or, for
+         * DistanceMetric::HopCount, no path to it) inside hexes get -1. The result is
+         * written to d_distToBoundary, and to Hex::distToBoundary if hexen has been built.
+         *
+         * \param metric DistanceMetric::Euclidean (the default) gives the straight line
+         * distance to the nearest boundary hex, computed with the exact, linear time
+         * transform in morph::DistanceTransform::sqdist_2d. DistanceMetric::HopCount
+         * gives the number of hex-to-hex steps to the boundary, multiplied by d, found by
+         * a breadth first search from the boundary hexes.
+         *
+         * \param parallel If true, the Euclidean transform runs its passes in OpenMP
+         * parallel loops. The result is the same either way.
          */
-        void computeDistanceToBoundary()
+        void computeDistanceToBoundary (const DistanceMetric metric = DistanceMetric::Euclidean,
+                                        const bool parallel = false)
         {
-            std::list<morph::Hex>::iterator h = this->hexen.begin();
-            while (h != this->hexen.end()) {
-                if (h->testFlags(HEX_IS_BOUNDARY) == true) {
-                    h->distToBoundary = 0.0f;
-                } else {
-                    if (h->testFlags(HEX_INSIDE_BOUNDARY) == false) {
+            const unsigned int n = this->hexen.empty() ? this->d_x.size() : this->hexen.size();
+            // The d_ vectors may not yet have been populated if no boundary was applied
+            if (!this->hexen.empty() && this->d_x.size() != n) { this->populate_d_vectors(); }
+
+            // Boundary flags may have changed in hexen (e.g. via setBoundaryOnly) since
+            // the d_ vectors were populated, so take flags from hexen where possible.
+            if (!this->hexen.empty()) {
+                for (const auto& h : this->hexen) { this->d_flags[h.di] = h.getFlags(); }
+            }
+
+            std::vector<char> source (n, 0);
+            std::vector<char> inside (n, 0);
+            for (unsigned int i = 0; i < n; ++i) {
+                source[i] = (this->d_flags[i] & HEX_IS_BOUNDARY) ? 1 : 0;
+                inside[i] = (this->d_flags[i] & HEX_INSIDE_BOUNDARY) ? 1 : 0;
+            }
+
+            if (metric == DistanceMetric::HopCount) {
+                std::array<const std::vector<int>*, 6> nbrs = {{ &this->d_ne, &this->d_nne, &this->d_nnw,
+                                                                 &this->d_nw, &this->d_nsw, &this->d_nse }};
+                morph::DistanceTransform::hops<6> (nbrs, source, inside, this->d_distToBoundary, this->d);
+
+            } else if (n > 0) {
+                // The hex at (ri,gi) is at x = (2ri+gi)*d/2, y = gi*v, so lay the hexes out on a
+                // lattice with columns k = 2ri+gi and rows gi.
+                int kmin = std::numeric_limits<int>::max();
+                int kmax = std::numeric_limits<int>::min();
+                for (unsigned int i = 0; i < n; ++i) {
+                    kmin = std::min (kmin, 2 * this->d_ri[i] + this->d_gi[i]);
+                    kmax = std::max (kmax, 2 * this->d_ri[i] + this->d_gi[i]);
+                }
+                auto gmm = std::minmax_element (this->d_gi.begin(), this->d_gi.end());
+                const int gmin = *gmm.first;
+                const int w = kmax - kmin + 1;
+                const int h = *gmm.second - gmin + 1;
+                std::vector<float> lattice (static_cast<size_t>(w) * h, morph::DistanceTransform::inf);
+                for (unsigned int i = 0; i < n; ++i) {
+                    if (source[i]) {
+                        lattice[(this->d_gi[i] - gmin) * w + 2 * this->d_ri[i] + this->d_gi[i] - kmin] = 0.0f;
+                    }
+                }
+                morph::DistanceTransform::sqdist_2d (lattice, w, h, this->d / 2.0f, this->v, parallel);
+
+                this->d_distToBoundary.resize (n);
+#pragma omp parallel for if(parallel)
+                for (unsigned int i = 0; i < n; ++i) {
+                    const float sqd = lattice[(this->d_gi[i] - gmin) * w + 2 * this->d_ri[i] + this->d_gi[i] - kmin];
+                    if (!inside[i]) {
                         // Set to a dummy, negative value
-                        h->distToBoundary = -100.0;
+                        this->d_distToBoundary[i] = -100.0f;
+                    } else if (sqd == morph::DistanceTransform::inf) {
+                        // No boundary
+                        this->d_distToBoundary[i] = -1.0f;
                     } else {
-                        // Not a boundary hex, but inside boundary
-                        std::list<morph::Hex>::iterator bh = this->hexen.begin();
-                        while (bh != this->hexen.end()) {
-                            if (bh->testFlags(HEX_IS_BOUNDARY) == true) {
-                                float delta = h->distanceFrom (*bh);
-                                if (delta < h->distToBoundary || h->distToBoundary < 0.0f) {
-                                    h->distToBoundary = delta;
-                                }
-                            }
-                            ++bh;
-                        }
+                        this->d_distToBoundary[i] = std::sqrt (sqd);
                     }
                 }
-                ++h;
             }
+
+            for (auto& h : this->hexen) { h.distToBoundary = this->d_distToBoundary[h.di]; }
         }
 
         /*!
@@ -1185,6 +1638,8 @@ namespace morph {
          */
         void populate_d_vectors()
         {
+            // A grid built by init_flat() has no hexen; its d_ vectors are already populated
+            if (this->is_flat()) { return; }
             // The starting hex is always the centre one.
             std::list<morph::Hex>::iterator hi = this->hexen.begin();
             // Clear the d_ vectors.
@@ -1198,6 +1653,159 @@ namespace morph {
             this->populate_d_neighbours();
         }
 
+        /*!
+         * Build the packed neighbour table d_nbrs from d_ne and friends. If \a missing
+         * is negative, a missing neighbour is recorded as the hex itself; otherwise it
+         * is recorded as \a missing, which is intended to be the index of a sentinel
+         * slot at the end of the data (e.g. num(), with data of size num()+1). Once
+         * built, the table is kept up to date whenever the d_ vectors are rebuilt.
+         */
+        void build_neighbour_table (const int missing = -1)
+        {
+            const int n = static_cast<int>(this->d_ne.size());
+            this->d_nbrs_missing = missing;
+            ++this->d_nbrs_generation;
+            this->d_nbrs.resize (n);
+#pragma omp parallel for
+            for (int i = 0; i < n; ++i) {
+                const std::int32_t none = missing < 0 ? i : missing;
+                this->d_nbrs[i] = { this->d_ne[i] > -1 ? this->d_ne[i] : none,
+                                    this->d_nne[i] > -1 ? this->d_nne[i] : none,
+                                    this->d_nnw[i] > -1 ? this->d_nnw[i] : none,
+                                    this->d_nw[i] > -1 ? this->d_nw[i] : none,
+                                    this->d_nsw[i] > -1 ? this->d_nsw[i] : none,
+                                    this->d_nse[i] > -1 ? this->d_nse[i] : none };
+            }
+        }
+
+        /*!
+         * Renumber the hexes of the domain so that the d_ vectors (and the Hex::vi and
+         * Hex::di indices) follow \a order. The neighbour vectors d_ne and friends
+         * are rewritten to match. In the default (spiral) ordering, the neighbours of a
+         * hex in the adjacent rings lie far apart in memory. With the Raster ordering,
+         * a stencil loop over the d_ vectors streams through three neighbouring rows,
+         * which suits the hardware prefetcher. With the Morton or Hilbert orderings,
+         * hexes which are close in the plane are close in memory in both directions,
+         * which suits work that is split into tiles or partitions of the domain.
+         *
+         * Call this after the boundary has been set; any later call to
+         * populate_d_vectors() (e.g. from setBoundary) restores the default ordering.
+         * The order of the std::list hexen is not changed. Data for the grid can be
+         * converted to and from raster order with toRaster() and fromRaster().
+         */
+        void renumber (const HexDomainOrder order)
+        {
+            if (this->d_x.size() != this->num()) { this->populate_d_vectors(); }
+            const unsigned int n = this->d_x.size();
+            if (n == 0) { return; }
+
+            // Find the curve key for each hex and sort by it
+            std::vector<std::uint64_t> keys (n);
+            this->domainOrderKeys (order, keys);
+            // oldidx[i] is the current index of the hex which is to have index i
+            std::vector<unsigned int> oldidx (n);
+            for (unsigned int i = 0; i < n; ++i) { oldidx[i] = i; }
+            std::stable_sort (oldidx.begin(), oldidx.end(),
+                              [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+            std::vector<int> newidx (n);
+            for (unsigned int i = 0; i < n; ++i) { newidx[oldidx[i]] = static_cast<int>(i); }
+
+            auto permute = [&oldidx, n](auto& vec) {
+                std::remove_reference_t<decltype(vec)> tmp (n);
+                for (unsigned int i = 0; i < n; ++i) { tmp[i] = vec[oldidx[i]]; }
+                vec.swap (tmp);
+            };
+            auto permute_nbrs = [&oldidx, &newidx, n](std::vector<int>& vec) {
+                std::vector<int> tmp (n);
+                for (unsigned int i = 0; i < n; ++i) {
+                    int nb = vec[oldidx[i]];
+                    tmp[i] = nb > -1 ? newidx[nb] : -1;
+                }
+                vec.swap (tmp);
+            };
+            permute (this->d_x);
+            permute (this->d_y);
+            permute (this->d_ri);
+            permute (this->d_gi);
+            permute (this->d_bi);
+            permute (this->d_flags);
+            permute (this->d_distToBoundary);
+            permute_nbrs (this->d_ne);
+            permute_nbrs (this->d_nne);
+            permute_nbrs (this->d_nnw);
+            permute_nbrs (this->d_nw);
+            permute_nbrs (this->d_nsw);
+            permute_nbrs (this->d_nse);
+
+            // Hex::vi and Hex::di both index the d_ vectors (and client data), and
+            // vhexen is indexed by vi
+            if (!this->hexen.empty()) {
+                this->vhexen.assign (n, nullptr);
+                for (auto& h : this->hexen) {
+                    h.di = newidx[h.di];
+                    h.vi = h.di;
+                    this->vhexen[h.vi] = &h;
+                }
+            }
+
+            this->build_ritable();
+            this->refresh_neighbour_table();
+        }
+
+        /*!
+         * Return the permutation which takes the d_ vectors into raster order (row by
+         * row from the bottom, each row from left to right). Element r of the returned
+         * vector is the d_ index of the r-th hex in raster order.
+         */
+        std::vector<unsigned int> rasterToIndex() const
+        {
+            const unsigned int n = this->d_x.size();
+            std::vector<std::uint64_t> keys (n);
+            this->domainOrderKeys (HexDomainOrder::Raster, keys);
+            std::vector<unsigned int> r2i (n);
+            for (unsigned int i = 0; i < n; ++i) { r2i[i] = i; }
+            std::sort (r2i.begin(), r2i.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+            return r2i;
+        }
+
+        /*!
+         * The inverse of rasterToIndex(). Element i of the returned vector is the
+         * position in raster order of the hex with d_ index i.
+         */
+        std::vector<unsigned int> indexToRaster() const
+        {
+            std::vector<unsigned int> r2i = this->rasterToIndex();
+            std::vector<unsigned int> i2r (r2i.size());
+            for (unsigned int r = 0; r < r2i.size(); ++r) { i2r[r2i[r]] = r; }
+            return i2r;
+        }
+
+        //! Copy \a data, which is in d_ order, into raster order (see rasterToIndex())
+        template<typename T>
+        std::vector<T> toRaster (const std::vector<T>& data) const
+        {
+            if (data.size() != this->d_x.size()) {
+                throw std::runtime_error ("HexGrid::toRaster: data is not the same size as the HexGrid");
+            }
+            std::vector<unsigned int> r2i = this->rasterToIndex();
+            std::vector<T> rdata (data.size());
+            for (unsigned int r = 0; r < r2i.size(); ++r) { rdata[r] = data[r2i[r]]; }
+            return rdata;
+        }
+
+        //! Copy \a rdata, which is in raster order, into d_ order
+        template<typename T>
+        std::vector<T> fromRaster (const std::vector<T>& rdata) const
+        {
+            if (rdata.size() != this->d_x.size()) {
+                throw std::runtime_error ("HexGrid::fromRaster: data is not the same size as the HexGrid");
+            }
+            std::vector<unsigned int> r2i = this->rasterToIndex();
+            std::vector<T> data (rdata.size());
+            for (unsigned int r = 0; r < r2i.size(); ++r) { data[r2i[r]] = rdata[r]; }
+            return data;
+        }
+
         /*!
          * Get a vector of Hex pointers for all hexes that are inside/on the path
          * defined by the BezCurvePath \a p, thus this gets a 'region of hexes'. The Hex
@@ -1230,6 +1838,7 @@ namespace morph {
         std::vector<std::list<Hex>::iterator> getRegion (std::vector<BezCoord<float>>& bpoints, morph::vec<float, 2>& regionCentroid,
                                                          bool applyOriginalBoundaryCentroid = true)
         {
+            this->ensure_hexen();
             // First clear all region boundary flags, as we'll be defining a new region boundary
             this->clearRegionBoundaryFlags();
 
@@ -1284,10 +1893,50 @@ namespace morph {
             return theRegion;
         }
 
+        /*!
+         * Get the region made up of the hexes at the axial coordinates (ri,gi) given
+         * in \a rgcoords. As for the other getRegion overloads, the previous region
+         * flags are cleared, then each hex in the region is marked HEX_INSIDE_REGION and
+         * those hexes of the region which have a neighbour outside the region (or no
+         * neighbour at all) are also marked HEX_IS_REGION_BOUNDARY. Coordinates that
+         * don't match a hex in the grid are ignored. The cost is linear in the number of
+         * hexes plus the number of coordinates.
+         *
+         * \return a vector of iterators to the Hexes that make up the region, in the
+         * order in which they appear in hexen.
+         */
+        std::vector<std::list<Hex>::iterator> getRegion (const std::vector<morph::vec<int, 2>>& rgcoords)
+        {
+            this->ensure_hexen();
+            this->clearRegionBoundaryFlags();
+
+            std::unordered_set<std::uint64_t> rkeys;
+            rkeys.reserve (rgcoords.size());
+            for (const auto& rg : rgcoords) { rkeys.insert (HexGrid::axialKey (rg[0], rg[1])); }
+
+            std::vector<std::list<morph::Hex>::iterator> theRegion;
+            for (auto hi = this->hexen.begin(); hi != this->hexen.end(); ++hi) {
+                if (rkeys.count (HexGrid::axialKey (hi->ri, hi->gi)) > 0) {
+                    hi->setFlag (HEX_INSIDE_REGION);
+                    theRegion.push_back (hi);
+                }
+            }
+            for (auto hi : theRegion) {
+                for (unsigned short i = 0; i < 6; ++i) {
+                    if (!hi->has_neighbour(i) || !hi->get_neighbour(i)->testFlags (HEX_INSIDE_REGION)) {
+                        hi->setFlag (HEX_IS_REGION_BOUNDARY);
+                        break;
+                    }
+                }
+            }
+            return theRegion;
+        }
+
         //! Obtain a hexagonal region of hexes around a given central hex, marked by its
         //! d_ index. This is easier than getting a properly circular region of hexes.
         std::vector<std::list<Hex>::iterator> getHexagonalRegion (unsigned int centreindex, float radius)
         {
+            this->ensure_hexen();
             std::vector<std::list<morph::Hex>::iterator> theRegion;
 
             // Find the hex with index centreindex
@@ -1350,6 +1999,9 @@ namespace morph {
          * Using this HexGrid as the domain, convolve the domain data \a data with the
          * kernel data \a kerneldata, which exists on another HexGrid, \a
          * kernelgrid. Return the result in \a result.
+         *
+         * For repeated convolutions with the same kernel, use morph::HexGridKernel
+         * (HexGridKernel.h), which resolves the kernel's neighbour paths just once.
          */
         template<typename T>
         void convolve (const HexGrid& kernelgrid, const std::vector<T>& kerneldata, const std::vector<T>& data, std::vector<T>& result)
@@ -1441,6 +2093,31 @@ namespace morph {
             }
         }
 
+        /*!
+         * The placement of an image of \a image_w by \a image_h pixels on this HexGrid, as
+         * used by resampleImage: the image is \a image_scale[0] wide (with square
+         * pixels), centred on \a image_offset.
+         */
+        morph::ImageSampler imageSampler (const unsigned int image_w, const unsigned int image_h,
+                                          const morph::vec<float, 2>& image_scale,
+                                          const morph::vec<float, 2>& image_offset) const
+        {
+            morph::vec<unsigned int, 2> image_pixelsz = { image_w, image_h };
+            // Distance per pixel in the image. This defines the Gaussian width (sigma) for the
+            // resample. Assume that the unscaled image pixels are square. Use the image width to
+            // set the distance per pixel (hence divide by image_scale by image_pixelsz[*0*]).
+            morph::vec<float, 2> dist_per_pix = image_scale / (image_pixelsz[0] - 1u);
+            // This is an offset to centre the image wrt to the HexGrid
+            morph::vec<float, 2> input_centering_offset = dist_per_pix * image_pixelsz * 0.5f;
+            // The pixel at index idx is at (dist_per_pix * idx) - input_centering_offset + image_offset
+            morph::ImageSampler sampler;
+            sampler.w = image_pixelsz[0];
+            sampler.h = image_pixelsz[1];
+            sampler.dist_per_pix = dist_per_pix;
+            sampler.origin = image_offset - input_centering_offset;
+            return sampler;
+        }
+
         /*!
          * Resampling function (monochrome).
          *
@@ -1451,13 +2128,17 @@ namespace morph {
          * \param image_pixelwidth (input) The number of pixels that the image is wide
          * \param image_scale (input) The size that the image should be resampled to (same units as HexGrid)
          * \param image_offset (input) An offset in HexGrid units to shift the image wrt to the HexGrid's origin
+         * \param mode (input) ResampleMode::Gaussian (a Gaussian weighted sum of the image
+         * pixels within 3 sigma of each hex) or ResampleMode::Bilinear (a fast preview).
+         * Only the pixels in the 3 sigma window of each hex are visited.
          *
          * \return A new data vvec containing the resampled (and renormalised) hex pixel values
          */
         morph::vvec<float> resampleImage (const morph::vvec<float>& image_data,
                                           const unsigned int image_pixelwidth,
                                           const morph::vec<float, 2>& image_scale,
-                                          const morph::vec<float, 2>& image_offset)
+                                          const morph::vec<float, 2>& image_offset,
+                                          const ResampleMode mode = ResampleMode::Gaussian)
         {
             unsigned int csz = image_data.size();
             morph::vec<unsigned int, 2> image_pixelsz = {image_pixelwidth, csz / image_pixelwidth};
@@ -1481,33 +2162,12 @@ namespace morph {
                 return expr_resampled;
             }
 
-            // Distance per pixel in the image. This defines the Gaussian width (sigma) for the
-            // resample. Assume that the unscaled image pixels are square. Use the image width to
-            // set the distance per pixel (hence divide by image_scale by image_pixelsz[*0*]).
-            morph::vec<float, 2> dist_per_pix = image_scale / (image_pixelsz[0] - 1u);
-            // This is an offset to centre the image wrt to the HexGrid
-            morph::vec<float, 2> input_centering_offset = dist_per_pix * image_pixelsz * 0.5f;
-            // Parameters for the Gaussian computation
-            morph::vec<float, 2> params = 1.0f / (2.0f * dist_per_pix * dist_per_pix);
-            morph::vec<float, 2> threesig = 3.0f * dist_per_pix;
+            const morph::ImageSampler sampler = this->imageSampler (image_pixelsz[0], image_pixelsz[1], image_scale, image_offset);
 
-#pragma omp parallel for // parallel on this outer loop gives best result (5.8 s vs 7 s)
-            for (typename std::vector<float>::size_type xi = 0u; xi < this->d_x.size(); ++xi) {
-                float expr = 0.0f;
-                for (unsigned int i = 0; i < csz; ++i) {
-                    // Get x/y pixel coords:
-                    morph::vec<unsigned int, 2> idx = {(i % image_pixelsz[0]), (i / image_pixelsz[0])};
-                    // Get the coordinates of the pixel at index i (in HexGrid units):
-                    morph::vec<float, 2> posn = (dist_per_pix * idx) - input_centering_offset + image_offset;
-                    // Distance from input pixel to output hex:
-                    float _d_x = this->d_x[xi] - posn[0];
-                    float _d_y = this->d_y[xi] - posn[1];
-                    // Compute contributions to each hex pixel, using 2D (elliptical) Gaussian
-                    if (_d_x < threesig[0] && _d_y < threesig[1]) { // Testing for distance gives slight speedup
-                        expr += std::exp ( - ( (params[0] * _d_x * _d_x) + (params[1] * _d_y * _d_y) ) ) * image_data[i];
-                    }
-                }
-                expr_resampled[xi] = expr;
+            const int nh = static_cast<int>(this->d_x.size());
+#pragma omp parallel for schedule(static)
+            for (int xi = 0; xi < nh; ++xi) {
+                expr_resampled[xi] = sampler.sample (image_data.data(), this->d_x[xi], this->d_y[xi], mode);
             }
 
             expr_resampled /= expr_resampled.max(); // renormalise result
@@ -3249,6 +3909,426 @@ namespace morph {
             DBG ("Finished creating " << this->hexen.size() << " hexes in " << maxRing << " rings.");
         }
 
+        /*!
+         * Initialise the same hex spiral as init(), but write the hexes directly into
+         * the d_ vectors. Each ring is walked in the same order as in init(), so the
+         * d_ index of each hex is the same as its Hex::vi in the list-based grid.
+         * Neighbour relations are found from the (ri,gi) to d_ index table, ritable.
+         */
+        void init_flat()
+        {
+            float halfX = this->x_span/2.0f;
+            const int maxRing = static_cast<int>(std::abs(std::ceil(halfX/this->d)));
+
+            DBG ("Creating flat hexagonal hex grid with maxRing: " << maxRing);
+
+            this->hexen.clear();
+            this->vhexen.clear();
+            this->bhexen.clear();
+            this->gridReduced = false;
+
+            // 1 hex in the centre, then 6*ring hexes in each ring
+            const unsigned int n = 1 + 3 * maxRing * (maxRing + 1);
+            this->d_x.resize (n);
+            this->d_y.resize (n);
+            this->d_ri.resize (n);
+            this->d_gi.resize (n);
+            this->d_bi.assign (n, 0);
+            this->d_flags.assign (n, 0x0);
+            this->d_distToBoundary.assign (n, -1.0f);
+
+            // The walk directions for the six sides of each ring: r, -b, -g, -r, b, g
+            constexpr std::array<int, 6> walk_dr = {{ 1, 1, 0, -1, -1, 0 }};
+            constexpr std::array<int, 6> walk_dg = {{ 0, -1, -1, 0, 1, 1 }};
+
+            this->d_ri[0] = 0;
+            this->d_gi[0] = 0;
+            unsigned int vi = 1;
+            int ri = 0;
+            int gi = 0;
+            for (int ring = 1; ring <= maxRing; ++ring) {
+                // Start each ring up and left of the start of the previous ring
+                --ri; ++gi;
+                for (unsigned int side = 0; side < 6; ++side) {
+                    for (int i = 0; i < ring; ++i) {
+                        this->d_ri[vi] = ri;
+                        this->d_gi[vi++] = gi;
+                        ri += walk_dr[side];
+                        gi += walk_dg[side];
+                    }
+                }
+            }
+
+            this->build_ritable();
+            this->refresh_neighbour_table();
+
+            // Neighbour offsets in (ri,gi) in the order E, NE, NW, W, SW, SE
+            constexpr std::array<int, 6> nb_dr = {{ 1, 0, -1, -1, 0, 1 }};
+            constexpr std::array<int, 6> nb_dg = {{ 0, 1, 1, 0, -1, -1 }};
+            constexpr std::array<unsigned int, 6> nb_flag = {{ HEX_HAS_NE, HEX_HAS_NNE, HEX_HAS_NNW,
+                                                               HEX_HAS_NW, HEX_HAS_NSW, HEX_HAS_NSE }};
+            std::array<std::vector<int>*, 6> nb_vec = {{ &this->d_ne, &this->d_nne, &this->d_nnw,
+                                                         &this->d_nw, &this->d_nsw, &this->d_nse }};
+            for (auto nv : nb_vec) { nv->resize (n); }
+
+            const float halfd = this->d/2.0f;
+#pragma omp parallel for
+            for (unsigned int i = 0; i < n; ++i) {
+                // Compute location exactly as Hex::computeLocation() does
+                this->d_x[i] = this->d * this->d_ri[i] + halfd * this->d_gi[i] - halfd * this->d_bi[i];
+                this->d_y[i] = this->v * this->d_gi[i] + this->v * this->d_bi[i];
+                for (unsigned int k = 0; k < 6; ++k) {
+                    int ni = this->ritable_index (this->d_ri[i] + nb_dr[k], this->d_gi[i] + nb_dg[k]);
+                    (*nb_vec[k])[i] = ni;
+                    if (ni > -1) { this->d_flags[i] |= nb_flag[k]; }
+                }
+            }
+
+            DBG ("Finished creating " << n << " hexes in " << maxRing << " rings (flat).");
+        }
+
+        //! True if the grid was built by init_flat() and hexen has not been built
+        bool is_flat() const { return this->hexen.empty() && !this->d_x.empty(); }
+
+        //! If the grid was built by init_flat(), build hexen before it is needed.
+        void ensure_hexen()
+        {
+            if (this->is_flat()) { this->build_hexen(); }
+        }
+
+        /*!
+         * The flat grid equivalent of findHexNearPoint(). Starting from the d_ index
+         * \a startFrom, and following nearest-neighbour relations, find the d_ index
+         * of the hex closest to \a point.
+         */
+        int flat_findHexNearPoint (const BezCoord<float>& point, const int startFrom) const
+        {
+            const std::array<const std::vector<int>*, 6> nbrs = {{ &this->d_ne, &this->d_nne, &this->d_nnw,
+                                                                   &this->d_nw, &this->d_nsw, &this->d_nse }};
+            auto dist = [this, &point](const int i) {
+                float dx = point.x() - this->d_x[i];
+                float dy = point.y() - this->d_y[i];
+                return std::sqrt (dx*dx + dy*dy);
+            };
+            int h = startFrom;
+            float dmin = dist (h);
+            bool neighbourNearer = true;
+            while (neighbourNearer == true) {
+                neighbourNearer = false;
+                for (auto nv : nbrs) {
+                    const int nb = (*nv)[h];
+                    float dcur = 0.0f;
+                    if (nb > -1 && (dcur = dist (nb)) < dmin) {
+                        dmin = dcur;
+                        h = nb;
+                        neighbourNearer = true;
+                        break;
+                    }
+                }
+            }
+            return h;
+        }
+
+        /*!
+         * The flat grid equivalent of boundaryContiguous(): determine whether the
+         * boundary marked in d_flags is contiguous, starting from the boundary hex with
+         * d_ index \a bhi.
+         */
+        bool flat_boundaryContiguous (const int bhi, const int hi, std::set<unsigned int>& seen) const
+        {
+            seen.insert (hi);
+            const std::array<const std::vector<int>*, 6> nbrs = {{ &this->d_ne, &this->d_nne, &this->d_nnw,
+                                                                   &this->d_nw, &this->d_nsw, &this->d_nse }};
+            for (auto nv : nbrs) {
+                const int nb = (*nv)[hi];
+                if (nb > -1 && (this->d_flags[nb] & HEX_IS_BOUNDARY) && seen.find (nb) == seen.end()) {
+                    if (this->flat_boundaryContiguous (bhi, nb, seen)) { return true; }
+                }
+            }
+            // Checked all neighbours. Back at start?
+            return hi == bhi;
+        }
+
+        /*!
+         * For a flat grid, with its boundary hexes marked in d_flags: check that the
+         * boundary is contiguous from the boundary hex \a bpoint (throwing \a errmsg
+         * if not), then mark the hexes inside it and discard those outside it.
+         */
+        void flat_applyBoundary (const int bpoint, const char* errmsg)
+        {
+            std::set<unsigned int> seen;
+            if (this->flat_boundaryContiguous (bpoint, bpoint, seen) == false) {
+                throw std::runtime_error (errmsg);
+            }
+            this->flat_discardOutsideBoundary();
+        }
+
+        /*!
+         * The flat grid equivalent of discardOutsideBoundary() followed by
+         * populate_d_vectors(). The hexes inside the boundary are found by a flood fill
+         * from the hex nearest to boundaryCentroid, then those outside it are removed
+         * from the d_ vectors, keeping the order of the remaining hexes. Neighbour
+         * indices (and the HEX_HAS_* flags of hexes that lose a neighbour) are updated.
+         */
+        void flat_discardOutsideBoundary()
+        {
+            const unsigned int n = this->d_x.size();
+            std::array<std::vector<int>*, 6> nbrs = {{ &this->d_ne, &this->d_nne, &this->d_nnw,
+                                                       &this->d_nw, &this->d_nsw, &this->d_nse }};
+            constexpr std::array<unsigned int, 6> nb_flag = {{ HEX_HAS_NE, HEX_HAS_NNE, HEX_HAS_NNW,
+                                                               HEX_HAS_NW, HEX_HAS_NSW, HEX_HAS_NSE }};
+
+            // Find the hex nearest to the boundary centroid, as findHexNearest() does
+            int centroidHex = 0;
+            float dist = std::numeric_limits<float>::max();
+            for (unsigned int i = 0; i < n; ++i) {
+                float dx = this->boundaryCentroid[0] - this->d_x[i];
+                float dy = this->boundaryCentroid[1] - this->d_y[i];
+                float dl = std::sqrt (dx*dx + dy*dy);
+                if (dl < dist) {
+                    dist = dl;
+                    centroidHex = i;
+                }
+            }
+
+            // Flood fill the inside of the boundary from there
+            std::vector<char> filled (n, 0);
+            std::vector<int> todo;
+            todo.push_back (centroidHex);
+            filled[centroidHex] = 1;
+            while (!todo.empty()) {
+                const int i = todo.back();
+                todo.pop_back();
+                this->d_flags[i] |= HEX_INSIDE_BOUNDARY;
+                if (this->d_flags[i] & HEX_IS_BOUNDARY) { continue; }
+                for (auto nv : nbrs) {
+                    const int nb = (*nv)[i];
+                    if (nb > -1 && !filled[nb]) {
+                        filled[nb] = 1;
+                        todo.push_back (nb);
+                    }
+                }
+            }
+
+            // The new index of each hex that is kept, or -1
+            std::vector<int> newidx (n, -1);
+            unsigned int m = 0;
+            for (unsigned int i = 0; i < n; ++i) {
+                if (this->d_flags[i] & HEX_INSIDE_BOUNDARY) { newidx[i] = m++; }
+            }
+            auto compact = [&newidx, n, m](auto& vec) {
+                std::remove_reference_t<decltype(vec)> tmp (m);
+                for (unsigned int i = 0; i < n; ++i) { if (newidx[i] > -1) { tmp[newidx[i]] = vec[i]; } }
+                vec.swap (tmp);
+            };
+            compact (this->d_x);
+            compact (this->d_y);
+            compact (this->d_ri);
+            compact (this->d_gi);
+            compact (this->d_bi);
+            compact (this->d_flags);
+            compact (this->d_distToBoundary);
+            for (unsigned int k = 0; k < 6; ++k) {
+                std::vector<int> tmp (m);
+                for (unsigned int i = 0; i < n; ++i) {
+                    if (newidx[i] < 0) { continue; }
+                    const int nb = (*nbrs[k])[i];
+                    tmp[newidx[i]] = nb > -1 ? newidx[nb] : -1;
+                    if (tmp[newidx[i]] < 0) { this->d_flags[newidx[i]] &= ~nb_flag[k]; }
+                }
+                nbrs[k]->swap (tmp);
+            }
+
+            // As for discardOutsideBoundary(), the grid vertices are no longer valid
+            this->gridReduced = true;
+            this->build_ritable();
+            this->refresh_neighbour_table();
+        }
+
+        /*!
+         * Compute, for each hex in the d_ vectors, its position along the curve given
+         * by \a order. The axial coordinates are first offset so that they are
+         * non-negative.
+         */
+        void domainOrderKeys (const HexDomainOrder order, std::vector<std::uint64_t>& keys) const
+        {
+            const unsigned int n = this->d_ri.size();
+            keys.resize (n);
+            if (n == 0) { return; }
+            int rmin = *std::min_element (this->d_ri.begin(), this->d_ri.end());
+            int rmax = *std::max_element (this->d_ri.begin(), this->d_ri.end());
+            int gmin = *std::min_element (this->d_gi.begin(), this->d_gi.end());
+            int gmax = *std::max_element (this->d_gi.begin(), this->d_gi.end());
+            // The side of the smallest power-of-two square containing all the hexes
+            std::uint64_t side = 1;
+            while (side <= static_cast<std::uint64_t>(std::max (rmax - rmin, gmax - gmin))) { side <<= 1; }
+
+            for (unsigned int i = 0; i < n; ++i) {
+                std::uint64_t u = static_cast<std::uint64_t>(this->d_ri[i] - rmin);
+                std::uint64_t w = static_cast<std::uint64_t>(this->d_gi[i] - gmin);
+                switch (order) {
+                case HexDomainOrder::Raster:
+                {
+                    keys[i] = (w << 32) | u;
+                    break;
+                }
+                case HexDomainOrder::Morton:
+                {
+                    std::uint64_t k = 0;
+                    for (unsigned int b = 0; b < 32; ++b) {
+                        k |= ((u >> b) & 1ULL) << (2*b);
+                        k |= ((w >> b) & 1ULL) << (2*b+1);
+                    }
+                    keys[i] = k;
+                    break;
+                }
+                case HexDomainOrder::Hilbert:
+                {
+                    // The classic conversion from (x,y) to distance along the Hilbert curve
+                    std::uint64_t k = 0;
+                    for (std::uint64_t s = side/2; s > 0; s /= 2) {
+                        std::uint64_t rx = (u & s) > 0 ? 1 : 0;
+                        std::uint64_t ry = (w & s) > 0 ? 1 : 0;
+                        k += s * s * ((3 * rx) ^ ry);
+                        // Rotate the quadrant
+                        if (ry == 0) {
+                            if (rx == 1) {
+                                u = side - 1 - u;
+                                w = side - 1 - w;
+                            }
+                            std::swap (u, w);
+                        }
+                    }
+                    keys[i] = k;
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+                }
+            }
+        }
+
+        //! If the packed neighbour table has been built, rebuild it from the d_ vectors
+        void refresh_neighbour_table()
+        {
+            if (!this->d_nbrs.empty()) { this->build_neighbour_table (this->d_nbrs_missing); }
+        }
+
+        //! A single integer key for the axial coordinates (ri,gi), for hash lookups
+        static std::uint64_t axialKey (const int ri, const int gi)
+        {
+            return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(ri)) << 32)
+                | static_cast<std::uint64_t>(static_cast<std::uint32_t>(gi));
+        }
+
+        //! The fixed size header of a binary cache file written by saveBinary()
+        struct BinaryCacheHeader
+        {
+            BinaryCachePreamble pre { "MORPHHEX", binary_cache_version };
+            float d = 0.0f;
+            float v = 0.0f;
+            float x_span = 0.0f;
+            float z = 0.0f;
+            float boundaryCentroid[2] = { 0.0f, 0.0f };
+            float originalBoundaryCentroid[2] = { 0.0f, 0.0f };
+            std::uint32_t gridReduced = 0;
+            std::uint32_t d_rowlen = 0;
+            std::uint32_t d_numrows = 0;
+            std::uint32_t d_size = 0;
+            std::uint32_t d_growthbuffer_horz = 0;
+            std::uint32_t d_growthbuffer_vert = 0;
+            std::uint64_t n = 0;
+        };
+
+        //! Populate this HexGrid from the \a len bytes at \a data, written by saveBinary().
+        bool loadBinaryData (const char* data, const size_t len, const std::uint64_t key)
+        {
+            static_assert (sizeof (int) == 4 && sizeof (float) == 4, "binary cache assumes 32 bit int and float");
+            BinaryCacheHeader hdr;
+            const BinaryCacheHeader ref;
+            if (len < sizeof hdr) { return false; }
+            std::memcpy (&hdr, data, sizeof hdr);
+            if (!hdr.pre.matches (ref.pre, key)) { return false; }
+            const size_t n = hdr.n;
+            // 13 vectors of 4 byte elements follow the header
+            if (len != sizeof hdr + 13 * 4 * n) { return false; }
+
+            this->d = hdr.d;
+            this->v = hdr.v;
+            this->x_span = hdr.x_span;
+            this->z = hdr.z;
+            this->boundaryCentroid = { hdr.boundaryCentroid[0], hdr.boundaryCentroid[1] };
+            this->originalBoundaryCentroid = { hdr.originalBoundaryCentroid[0], hdr.originalBoundaryCentroid[1] };
+            this->gridReduced = hdr.gridReduced != 0;
+            this->d_rowlen = hdr.d_rowlen;
+            this->d_numrows = hdr.d_numrows;
+            this->d_size = hdr.d_size;
+            this->d_growthbuffer_horz = hdr.d_growthbuffer_horz;
+            this->d_growthbuffer_vert = hdr.d_growthbuffer_vert;
+
+            const char* p = data + sizeof hdr;
+            auto read_vec = [&p, n](auto& vec) {
+                vec.resize (n);
+                std::memcpy (vec.data(), p, n * sizeof (vec[0]));
+                p += n * sizeof (vec[0]);
+            };
+            read_vec (this->d_x);
+            read_vec (this->d_y);
+            read_vec (this->d_ri);
+            read_vec (this->d_gi);
+            read_vec (this->d_bi);
+            read_vec (this->d_ne);
+            read_vec (this->d_nne);
+            read_vec (this->d_nnw);
+            read_vec (this->d_nw);
+            read_vec (this->d_nsw);
+            read_vec (this->d_nse);
+            read_vec (this->d_flags);
+            read_vec (this->d_distToBoundary);
+
+            this->hexen.clear();
+            this->vhexen.clear();
+            this->bhexen.clear();
+            this->build_ritable();
+            this->refresh_neighbour_table();
+            return true;
+        }
+
+        /*!
+         * Build ritable, the dense table of d_ indices covering the bounding box of
+         * the (ri,gi) coordinates in d_ri and d_gi. Assumes that d_bi is 0 for all
+         * hexes, as it is for every HexGrid built by init() or init_flat().
+         */
+        void build_ritable()
+        {
+            this->ritable.clear();
+            if (this->d_ri.empty()) { return; }
+            auto rmm = std::minmax_element (this->d_ri.begin(), this->d_ri.end());
+            auto gmm = std::minmax_element (this->d_gi.begin(), this->d_gi.end());
+            this->ritable_rmin = *rmm.first;
+            this->ritable_gmin = *gmm.first;
+            this->ritable_w = *rmm.second - *rmm.first + 1;
+            this->ritable_h = *gmm.second - *gmm.first + 1;
+            this->ritable.assign (static_cast<size_t>(this->ritable_w) * this->ritable_h, -1);
+            for (size_t i = 0; i < this->d_ri.size(); ++i) {
+                this->ritable[static_cast<size_t>(this->d_gi[i] - this->ritable_gmin) * this->ritable_w
+                              + this->d_ri[i] - this->ritable_rmin] = static_cast<int>(i);
+            }
+        }
+
+        //! Look up the d_ index of the hex at (ri,gi) in ritable. Returns -1 if there is no such hex.
+        int ritable_index (const int ri, const int gi) const
+        {
+            const int r = ri - this->ritable_rmin;
+            const int g = gi - this->ritable_gmin;
+            if (this->ritable.empty() || r < 0 || g < 0 || r >= this->ritable_w || g >= this->ritable_h) {
+                return -1;
+            }
+            return this->ritable[static_cast<size_t>(g) * this->ritable_w + r];
+        }
+
         /*!
          * Starting from \a startFrom, and following nearest-neighbour relations, find
          * the closest Hex in hexen to the coordinate point \a point, and set its
@@ -4030,6 +5110,16 @@ namespace morph {
          */
         bool gridReduced = false;
 
+        /*!
+         * Dense table of d_ indices, indexed by (gi - ritable_gmin) * ritable_w + (ri -
+         * ritable_rmin). Entries are -1 where there is no hex. Used by findHexIndex().
+         */
+        std::vector<int> ritable;
+        int ritable_rmin = 0;
+        int ritable_gmin = 0;
+        int ritable_w = 0;
+        int ritable_h = 0;
+
     };
 
 } // namespace morph
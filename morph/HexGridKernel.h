@@ -0,0 +1,194 @@
+/*!
+ * \file HexGridKernel.h
+ *
+ * A convolution kernel, defined on one HexGrid, compiled into a sparse table for
+ * repeated convolutions of data on another HexGrid.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/HexGrid.h>
+#include <vector>
+#include <stdexcept>
+#include <cstddef>
+
+namespace morph {
+
+    /*!
+     * HexGrid::convolve() resolves the path from each domain hex to each kernel hex,
+     * step by step through the Hex neighbour iterators, every time it is called.
+     * HexGridKernel resolves these paths just once. The result is a compressed sparse
+     * row table: for each hex in the domain, a list of (source d_ index, weight)
+     * pairs. Each convolve() call is then a sparse matrix-vector product over
+     * the data vector, carried out in an OpenMP parallel loop.
+     *
+     * The paths are resolved exactly as in HexGrid::convolve(), but with the d_
+     * neighbour vectors (so any wrapping set up by HexGrid::setParallelogramWrap is
+     * respected). So the result matches that of HexGrid::convolve(), but the
+     * floating point summation order may differ.
+     *
+     * \tparam T The type of the kernel and of the data to be convolved
+     */
+    template <typename T>
+    class HexGridKernel
+    {
+    public:
+        HexGridKernel() {}
+
+        /*!
+         * Construct and compile the kernel \a kerneldata, which exists on \a
+         * kernelgrid, for convolutions of data on the domain \a domain.
+         */
+        HexGridKernel (const HexGrid& domain, const HexGrid& kernelgrid, const std::vector<T>& kerneldata)
+        {
+            this->compile (domain, kernelgrid, kerneldata);
+        }
+
+        /*!
+         * Build the sparse table. \a domain must have its d_ vectors populated (which
+         * is the case once a boundary has been set). \a kernelgrid must have the same d
+         * as \a domain.
+         */
+        void compile (const HexGrid& domain, const HexGrid& kernelgrid, const std::vector<T>& kerneldata)
+        {
+            if (kernelgrid.getd() != domain.getd()) {
+                throw std::runtime_error ("The kernel HexGrid must have same d as the domain HexGrid to carry out convolution.");
+            }
+            if (kerneldata.size() != kernelgrid.num()) {
+                throw std::runtime_error ("The kernel data vector is not the same size as the kernel HexGrid.");
+            }
+            if (domain.d_x.size() != domain.num()) {
+                throw std::runtime_error ("HexGridKernel: The domain HexGrid's d_ vectors have not been populated.");
+            }
+
+            // The (ri,gi) offset and the kerneldata index of each kernel hex
+            std::vector<int> k_ri;
+            std::vector<int> k_gi;
+            std::vector<unsigned int> k_idx;
+            if (!kernelgrid.hexen.empty()) {
+                for (auto kh : kernelgrid.hexen) {
+                    k_ri.push_back (kh.ri);
+                    k_gi.push_back (kh.gi);
+                    k_idx.push_back (kh.vi);
+                }
+            } else {
+                k_ri = kernelgrid.d_ri;
+                k_gi = kernelgrid.d_gi;
+                for (unsigned int i = 0; i < kernelgrid.d_ri.size(); ++i) { k_idx.push_back (i); }
+            }
+            const unsigned int nk = k_ri.size();
+
+            this->n = domain.d_x.size();
+            const int nd = static_cast<int>(this->n);
+
+            // First pass: count the contributions to each domain hex
+            std::vector<size_t> counts (this->n, 0);
+#pragma omp parallel for
+            for (int i = 0; i < nd; ++i) {
+                size_t c = 0;
+                for (unsigned int k = 0; k < nk; ++k) {
+                    if (HexGridKernel<T>::walk (domain, i, k_ri[k], k_gi[k]) > -1) { ++c; }
+                }
+                counts[i] = c;
+            }
+
+            this->row_start.resize (this->n + 1);
+            this->row_start[0] = 0;
+            for (size_t i = 0; i < this->n; ++i) { this->row_start[i+1] = this->row_start[i] + counts[i]; }
+            this->src.resize (this->row_start[this->n]);
+            this->weight.resize (this->row_start[this->n]);
+
+            // Second pass: fill the table
+#pragma omp parallel for
+            for (int i = 0; i < nd; ++i) {
+                size_t j = this->row_start[i];
+                for (unsigned int k = 0; k < nk; ++k) {
+                    int s = HexGridKernel<T>::walk (domain, i, k_ri[k], k_gi[k]);
+                    if (s > -1) {
+                        this->src[j] = s;
+                        this->weight[j] = kerneldata[k_idx[k]];
+                        ++j;
+                    }
+                }
+            }
+        }
+
+        /*!
+         * Convolve \a data (defined on the domain HexGrid) with the compiled kernel,
+         * writing the result into \a result. Both must be of the domain's size, and
+         * must be separate memory.
+         */
+        void convolve (const std::vector<T>& data, std::vector<T>& result) const
+        {
+            if (data.size() != this->n) {
+                throw std::runtime_error ("The data vector is not the same size as the HexGrid.");
+            }
+            if (result.size() != this->n) {
+                throw std::runtime_error ("The result vector is not the same size as the HexGrid.");
+            }
+            if (&data == &result) {
+                throw std::runtime_error ("Pass in separate memory for the result.");
+            }
+            const int nd = static_cast<int>(this->n);
+            const size_t* rs = this->row_start.data();
+            const int* sp = this->src.data();
+            const T* wp = this->weight.data();
+            const T* dp = data.data();
+#pragma omp parallel for
+            for (int i = 0; i < nd; ++i) {
+                T sum = T{0};
+#pragma omp simd reduction(+:sum)
+                for (size_t j = rs[i]; j < rs[i+1]; ++j) {
+                    sum += dp[sp[j]] * wp[j];
+                }
+                result[i] = sum;
+            }
+        }
+
+        //! The number of domain hexes for which the kernel was compiled
+        size_t size() const { return this->n; }
+
+        //! The number of (source, weight) pairs in the table
+        size_t nnz() const { return this->src.size(); }
+
+    private:
+        /*!
+         * Starting from the domain hex \a i, walk \a rr hexes in the r direction and \a
+         * gg hexes in the g direction, following the same route as
+         * HexGrid::convolve(). Return the d_ index of the destination hex, or -1 if
+         * the walk gets stuck at the edge of the domain.
+         */
+        static int walk (const HexGrid& domain, int i, int rr, int gg)
+        {
+            while (true) {
+                bool moved = false;
+                // Try to move in r direction
+                if (rr > 0) {
+                    if (domain.d_ne[i] > -1) { i = domain.d_ne[i]; --rr; moved = true; }
+                } else if (rr < 0) {
+                    if (domain.d_nw[i] > -1) { i = domain.d_nw[i]; ++rr; moved = true; }
+                }
+                // Try to move in g direction
+                if (gg > 0) {
+                    if (domain.d_nne[i] > -1) { i = domain.d_nne[i]; --gg; moved = true; }
+                } else if (gg < 0) {
+                    if (domain.d_nsw[i] > -1) { i = domain.d_nsw[i]; ++gg; moved = true; }
+                }
+                if (rr == 0 && gg == 0) { return i; }
+                // Stuck; can't move in r or g direction, so no contribution
+                if (!moved) { return -1; }
+            }
+        }
+
+        //! The number of domain hexes
+        size_t n = 0;
+        //! Index into src and weight of the first entry for each domain hex (size n+1)
+        std::vector<size_t> row_start;
+        //! The d_ index of the source hex for each entry
+        std::vector<int> src;
+        //! The kernel weight for each entry
+        std::vector<T> weight;
+    };
+
+} // namespace morph
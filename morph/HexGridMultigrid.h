@@ -0,0 +1,375 @@
+/*!
+ * \file HexGridMultigrid.h
+ *
+ * A geometric multigrid solver for the Helmholtz-type problem (a - b Del^2) u = f on
+ * the arbitrary boundary domain of a HexGrid, with no-flux (Neumann) boundaries.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/HexGrid.h>
+#include <morph/HexGridPyramid.h>
+#include <vector>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+namespace morph {
+
+    /*!
+     * Solve (a - b Del^2) u = f on level 0 of a HexGridPyramid with V-cycles.
+     *
+     * The Laplacian is the six point hex stencil used in RD_Base::compute_laplace,
+     * (2 / 3d^2) * (sum of the six neighbours - 6 u), in which a missing neighbour is
+     * a ghost with the value of the hex itself; that is, the boundary is no-flux.
+     *
+     * The operator on each coarser level is the Galerkin product R A P of the
+     * restriction R, the operator A of the level above and the prolongation P, from
+     * the HexGridPyramid. This is a seven point stencil on the coarse level. Because
+     * the levels' boundaries do not nest exactly, simply rediscretising the Laplacian
+     * on each level gives a coarse grid correction that is poor near the boundary; the
+     * Galerkin operator is consistent with the fine level there. Any coupling of a
+     * coarse hex to a hex other than its six neighbours (which can happen only at the
+     * edge of the domain) is added to its diagonal.
+     *
+     * The coarsest level is solved directly, with a dense LU factorisation made when the
+     * coefficients are set, if it has no more than direct_max hexes; otherwise with
+     * coarse_sweeps smoothing sweeps. Smoothing alone converges slowly there when b
+     * dominates, and the V-cycle then converges no faster than the coarsest solve.
+     *
+     * The smoother is Gauss-Seidel in three colours. The hex at (ri,gi) has colour (ri
+     * - gi) mod 3, and no two neighbouring hexes share a colour, so all the hexes of
+     * one colour can be updated at once in an OpenMP parallel loop. The result does not
+     * depend on the number of threads.
+     *
+     * With a == 0, the problem is the Neumann Poisson problem, which has a solution
+     * only if f sums to zero, and then only up to a constant; the solver then removes
+     * the mean of u after each cycle.
+     *
+     * \tparam T The type of the data; float or double.
+     */
+    template <typename T>
+    class HexGridMultigrid
+    {
+    public:
+        //! The number of smoothing sweeps before and after each coarse grid correction
+        unsigned int presmooth = 2;
+        unsigned int postsmooth = 2;
+        //! The number of sweeps used to solve on the coarsest level, if it is too big to solve directly
+        unsigned int coarse_sweeps = 40;
+        //! The largest coarsest level that is solved directly
+        static constexpr unsigned int direct_max = 2000;
+
+        /*!
+         * Set up the solver on the pyramid \a pyr (which must outlive this object) with
+         * coefficients \a a_ and \a b_.
+         */
+        HexGridMultigrid (HexGridPyramid& pyr, const T a_, const T b_)
+        {
+            this->pyramid = &pyr;
+            const unsigned int nl = pyr.size();
+            this->levels.resize (nl);
+            for (unsigned int k = 0; k < nl; ++k) {
+                HexGrid& g = pyr.grid(k);
+                g.build_neighbour_table();
+                Level& lv = this->levels[k];
+                const unsigned int n = g.num();
+                lv.coef.resize (n);
+                for (unsigned int i = 0; i < n; ++i) {
+                    int c = (g.d_ri[i] - g.d_gi[i]) % 3;
+                    lv.colour[c < 0 ? c + 3 : c].push_back (static_cast<int>(i));
+                }
+                lv.u.assign (n, T{0});
+                lv.f.assign (n, T{0});
+                lv.r.assign (n, T{0});
+                lv.e.assign (n, T{0});
+            }
+            this->setCoefficients (a_, b_);
+        }
+
+        //! Change the coefficients a and b
+        void setCoefficients (const T a_, const T b_)
+        {
+            if (a_ < T{0} || b_ < T{0}) { throw std::runtime_error ("HexGridMultigrid: a and b must be non-negative"); }
+            this->a = a_;
+            this->b = b_;
+
+            // The fine level operator. Ghost neighbours cancel out of the Laplacian.
+            const HexGrid& g0 = this->pyramid->grid(0);
+            Level& l0 = this->levels[0];
+            const T bn = this->b * T{2} / (T{3} * static_cast<T>(g0.getd()) * static_cast<T>(g0.getd()));
+            const int n0 = static_cast<int>(l0.coef.size());
+#pragma omp parallel for
+            for (int i = 0; i < n0; ++i) {
+                l0.coef[i][0] = this->a;
+                for (unsigned int j = 0; j < 6; ++j) {
+                    if (g0.d_nbrs[i][j] != i) {
+                        l0.coef[i][0] += bn;
+                        l0.coef[i][j+1] = -bn;
+                    } else {
+                        l0.coef[i][j+1] = T{0};
+                    }
+                }
+            }
+            for (unsigned int k = 0; k + 1 < this->levels.size(); ++k) { this->galerkin (k); }
+            this->factorise_coarsest();
+        }
+
+        /*!
+         * Carry out V-cycles, starting from the initial guess \a u, until the 2-norm of
+         * the residual is less than \a tol times the 2-norm of \a f, or until \a
+         * maxcycles cycles have been carried out. Return the number of cycles.
+         */
+        unsigned int solve (const std::vector<T>& f, std::vector<T>& u, const T tol = T{1e-6},
+                            const unsigned int maxcycles = 50)
+        {
+            Level& l0 = this->levels[0];
+            if (f.size() != l0.f.size()) { throw std::runtime_error ("HexGridMultigrid: f is not the size of the HexGrid"); }
+            if (u.size() != l0.u.size()) { u.assign (l0.u.size(), T{0}); }
+            l0.f = f;
+            l0.u = u;
+            const T fnorm = HexGridMultigrid<T>::norm2 (f);
+            unsigned int cycles = 0;
+            this->residual (0);
+            this->last_residual = HexGridMultigrid<T>::norm2 (l0.r);
+            while (cycles < maxcycles && this->last_residual > tol * fnorm) {
+                this->vcycle (0);
+                if (this->a == T{0}) { HexGridMultigrid<T>::remove_mean (l0.u); }
+                this->residual (0);
+                this->last_residual = HexGridMultigrid<T>::norm2 (l0.r);
+                ++cycles;
+            }
+            u = l0.u;
+            return cycles;
+        }
+
+        //! The 2-norm of the residual at the end of the last call to solve()
+        T residualNorm() const { return this->last_residual; }
+
+        /*!
+         * Apply the operator to \a u, on level \a k of the pyramid, writing the result
+         * into \a au. On level 0, this is (a - b Del^2) u.
+         */
+        void apply (const unsigned int k, const std::vector<T>& u, std::vector<T>& au) const
+        {
+            const Level& lv = this->levels[k];
+            const HexGrid& g = this->pyramid->grid(k);
+            const int n = static_cast<int>(lv.coef.size());
+            au.resize (n);
+#pragma omp parallel for
+            for (int i = 0; i < n; ++i) {
+                const HexGrid::neighbour_row& nb = g.d_nbrs[i];
+                const std::array<T, 7>& c = lv.coef[i];
+                T sum = c[0] * u[i];
+                for (unsigned int j = 0; j < 6; ++j) { sum += c[j+1] * u[nb[j]]; }
+                au[i] = sum;
+            }
+        }
+
+    private:
+        //! The working data for one level of the pyramid
+        struct Level
+        {
+            //! The operator's coefficients for each hex: itself, then its six neighbours
+            //! in the order of HexGrid::d_nbrs. Zero for ghost neighbours.
+            std::vector<std::array<T, 7>> coef;
+            //! The indices of the hexes of each of the three colours
+            std::array<std::vector<int>, 3> colour;
+            //! Solution, right hand side, residual and correction
+            std::vector<T> u;
+            std::vector<T> f;
+            std::vector<T> r;
+            std::vector<T> e;
+            //! The LU factors (row major) and row pivots of the operator, on the coarsest level only
+            std::vector<T> lu;
+            std::vector<int> piv;
+        };
+
+        //! Gauss-Seidel sweeps on level k, one colour at a time
+        void smooth (const unsigned int k, const unsigned int sweeps)
+        {
+            Level& lv = this->levels[k];
+            const HexGrid& g = this->pyramid->grid(k);
+            for (unsigned int s = 0; s < sweeps; ++s) {
+                for (unsigned int c = 0; c < 3; ++c) {
+                    const std::vector<int>& idx = lv.colour[c];
+                    const int nc = static_cast<int>(idx.size());
+#pragma omp parallel for
+                    for (int q = 0; q < nc; ++q) {
+                        const int i = idx[q];
+                        const HexGrid::neighbour_row& nb = g.d_nbrs[i];
+                        const std::array<T, 7>& cf = lv.coef[i];
+                        T thesum = lv.f[i];
+                        for (unsigned int j = 0; j < 6; ++j) { thesum -= cf[j+1] * lv.u[nb[j]]; }
+                        lv.u[i] = thesum / cf[0];
+                    }
+                }
+            }
+        }
+
+        //! Compute the operator of level k+1 as the Galerkin product R A P
+        void galerkin (const unsigned int k)
+        {
+            const HexGrid& gf = this->pyramid->grid(k);
+            const HexGrid& gc = this->pyramid->grid(k+1);
+            const HexGridPyramid::Transfer& tr = this->pyramid->transfer(k);
+            const Level& lf = this->levels[k];
+            Level& lc = this->levels[k+1];
+            const int nc = static_cast<int>(gc.num());
+#pragma omp parallel for
+            for (int ci = 0; ci < nc; ++ci) {
+                std::array<T, 7>& row = lc.coef[ci];
+                row.fill (T{0});
+                const HexGrid::neighbour_row& cnb = gc.d_nbrs[ci];
+                // Add weight w to the coupling of coarse hex ci with coarse hex cj
+                auto accumulate = [&row, &cnb, ci](const int cj, const T w) {
+                    if (cj == ci) { row[0] += w; return; }
+                    for (unsigned int j = 0; j < 6; ++j) {
+                        if (cnb[j] == cj) { row[j+1] += w; return; }
+                    }
+                    // Not a neighbour; lump onto the diagonal
+                    row[0] += w;
+                };
+                for (size_t q = tr.r_start[ci]; q < tr.r_start[ci+1]; ++q) {
+                    const int fi = tr.r_src[q];
+                    const T rw = static_cast<T>(tr.r_weight[q]);
+                    const std::array<T, 7>& fc = lf.coef[fi];
+                    for (unsigned int j = 0; j < 7; ++j) {
+                        if (fc[j] == T{0}) { continue; }
+                        const int fl = j == 0 ? fi : gf.d_nbrs[fi][j-1];
+                        for (unsigned int p = 0; p < 2; ++p) {
+                            const T pw = static_cast<T>(tr.p_weight[2*fl+p]);
+                            if (pw != T{0}) { accumulate (tr.p_src[2*fl+p], rw * fc[j] * pw); }
+                        }
+                    }
+                }
+            }
+        }
+
+        /*!
+         * Make the dense LU factorisation, with partial pivoting, of the coarsest level's
+         * operator. When a == 0 the operator is singular (constants are in its null
+         * space), so its last equation is replaced by the condition that u sums to zero.
+         */
+        void factorise_coarsest()
+        {
+            const unsigned int k = this->levels.size() - 1;
+            Level& lv = this->levels[k];
+            const HexGrid& g = this->pyramid->grid(k);
+            const int n = static_cast<int>(lv.coef.size());
+            if (n > static_cast<int>(direct_max)) {
+                lv.lu.clear();
+                lv.piv.clear();
+                return;
+            }
+            std::vector<T>& m = lv.lu;
+            m.assign (static_cast<size_t>(n) * n, T{0});
+            for (int i = 0; i < n; ++i) {
+                m[i*n+i] += lv.coef[i][0];
+                for (unsigned int j = 0; j < 6; ++j) { m[i*n+g.d_nbrs[i][j]] += lv.coef[i][j+1]; }
+            }
+            if (this->a == T{0}) {
+                for (int j = 0; j < n; ++j) { m[(n-1)*n+j] = T{1}; }
+            }
+            lv.piv.resize (n);
+            for (int c = 0; c < n; ++c) {
+                int p = c;
+                for (int i = c + 1; i < n; ++i) {
+                    if (std::abs (m[i*n+c]) > std::abs (m[p*n+c])) { p = i; }
+                }
+                lv.piv[c] = p;
+                if (m[p*n+c] == T{0}) { throw std::runtime_error ("HexGridMultigrid: the coarsest level operator is singular"); }
+                if (p != c) {
+                    for (int j = 0; j < n; ++j) { std::swap (m[c*n+j], m[p*n+j]); }
+                }
+                const T inv = T{1} / m[c*n+c];
+#pragma omp parallel for
+                for (int i = c + 1; i < n; ++i) {
+                    const T l = m[i*n+c] * inv;
+                    m[i*n+c] = l;
+                    if (l == T{0}) { continue; }
+                    for (int j = c + 1; j < n; ++j) { m[i*n+j] -= l * m[c*n+j]; }
+                }
+            }
+        }
+
+        //! Solve the coarsest level's problem with the LU factors
+        void solve_coarsest()
+        {
+            Level& lv = this->levels.back();
+            const int n = static_cast<int>(lv.f.size());
+            const std::vector<T>& m = lv.lu;
+            std::vector<T>& x = lv.u;
+            x = lv.f;
+            if (this->a == T{0}) { x[n-1] = T{0}; }
+            for (int c = 0; c < n; ++c) { std::swap (x[c], x[lv.piv[c]]); }
+            for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < i; ++j) { x[i] -= m[i*n+j] * x[j]; }
+            }
+            for (int i = n - 1; i >= 0; --i) {
+                for (int j = i + 1; j < n; ++j) { x[i] -= m[i*n+j] * x[j]; }
+                x[i] /= m[i*n+i];
+            }
+        }
+
+        //! Compute r = f - A u on level k
+        void residual (const unsigned int k)
+        {
+            Level& lv = this->levels[k];
+            this->apply (k, lv.u, lv.r);
+            const int n = static_cast<int>(lv.r.size());
+#pragma omp parallel for
+            for (int i = 0; i < n; ++i) { lv.r[i] = lv.f[i] - lv.r[i]; }
+        }
+
+        //! One V-cycle for the problem held in levels[k].f, improving levels[k].u
+        void vcycle (const unsigned int k)
+        {
+            Level& lv = this->levels[k];
+            if (k + 1 == this->levels.size()) {
+                if (lv.lu.empty()) {
+                    this->smooth (k, this->coarse_sweeps);
+                } else {
+                    this->solve_coarsest();
+                }
+                return;
+            }
+            this->smooth (k, this->presmooth);
+            this->residual (k);
+            Level& lc = this->levels[k+1];
+            this->pyramid->restrictToCoarse (k, lv.r, lc.f);
+            lc.u.assign (lc.u.size(), T{0});
+            this->vcycle (k + 1);
+            this->pyramid->prolongToFine (k, lc.u, lv.e);
+            const int n = static_cast<int>(lv.u.size());
+#pragma omp parallel for
+            for (int i = 0; i < n; ++i) { lv.u[i] += lv.e[i]; }
+            this->smooth (k, this->postsmooth);
+        }
+
+        static T norm2 (const std::vector<T>& v)
+        {
+            T sum = T{0};
+            const int n = static_cast<int>(v.size());
+#pragma omp parallel for reduction(+:sum)
+            for (int i = 0; i < n; ++i) { sum += v[i] * v[i]; }
+            return std::sqrt (sum);
+        }
+
+        static void remove_mean (std::vector<T>& v)
+        {
+            T sum = T{0};
+            for (auto vi : v) { sum += vi; }
+            const T mean = sum / static_cast<T>(v.size());
+            for (auto& vi : v) { vi -= mean; }
+        }
+
+        HexGridPyramid* pyramid = nullptr;
+        std::vector<Level> levels;
+        T a = T{1};
+        T b = T{1};
+        T last_residual = T{0};
+    };
+
+} // namespace morph
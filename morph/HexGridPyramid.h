@@ -0,0 +1,312 @@
+/*!
+ * \file HexGridPyramid.h
+ *
+ * A hierarchy of HexGrids of hex to hex distance d, 2d, 4d, ... over the same
+ * boundary, with the operators that transfer data between neighbouring levels.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/HexGrid.h>
+#include <morph/BezCurvePath.h>
+#include <morph/vec.h>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+namespace morph {
+
+    /*!
+     * A pyramid of HexGrids. Level 0 has hex to hex distance d; level k has d * 2^k.
+     * All levels are built from the same boundary.
+     *
+     * The hexes of level k+1 sit on every other hex of level k in both axial
+     * directions: the coarse hex (R,G) is at the same place as the fine hex (2R,2G).
+     * Every other fine hex lies half way between two coarse hexes. This gives simple
+     * transfer operators:
+     *
+     * Prolongation (coarse to fine) is linear interpolation. A fine hex which
+     * coincides with a coarse hex takes its value; a fine hex which lies between two
+     * coarse hexes takes their mean.
+     *
+     * Restriction (fine to coarse) is the weighted average of the coincident fine hex
+     * (weight 1) and the six fine hexes around it (weight 1/2 each), which is the
+     * transpose of the prolongation, normalised. It is exact for linear data in the
+     * interior of the domain.
+     *
+     * Near the boundary, where some of these hexes are missing, the weights of the
+     * hexes that are present are renormalised. A hex with no partner at all on the
+     * other level is connected to a nearby hex on that level.
+     *
+     * The operators are stored as tables of indices and weights. Prolongation has
+     * two entries per fine hex; restriction is a compressed sparse row table with up
+     * to seven entries per coarse hex (more at the edges).
+     */
+    class HexGridPyramid
+    {
+    public:
+        HexGridPyramid() {}
+
+        /*!
+         * Build \a nlevels levels, from hex to hex distance \a d_, each with the span
+         * \a x_span_, and with a boundary set on each by \a setboundary (for example
+         * a lambda which calls HexGrid::setEllipticalBoundary).
+         */
+        HexGridPyramid (const float d_, const float x_span_, const unsigned int nlevels,
+                        const std::function<void(HexGrid&)>& setboundary)
+        {
+            this->init (d_, x_span_, nlevels, setboundary);
+        }
+
+        //! Build \a nlevels levels, each with the boundary \a p applied by HexGrid::setBoundary
+        HexGridPyramid (const float d_, const float x_span_, const unsigned int nlevels,
+                        const BezCurvePath<float>& p, const bool loffset = true)
+        {
+            this->init (d_, x_span_, nlevels, [&p, loffset](HexGrid& g) { g.setBoundary (p, loffset); });
+        }
+
+        //! Build the levels and the transfer operators between them
+        void init (const float d_, const float x_span_, const unsigned int nlevels,
+                   const std::function<void(HexGrid&)>& setboundary)
+        {
+            if (nlevels == 0) { throw std::runtime_error ("HexGridPyramid: Need at least one level"); }
+            this->grids.clear();
+            this->transfers.clear();
+
+            float dl = d_;
+            for (unsigned int k = 0; k < nlevels; ++k) {
+                this->grids.push_back (std::make_unique<HexGrid>(dl, x_span_, 0.0f, false));
+                setboundary (*this->grids.back());
+                if (this->grids.back()->num() == 0) {
+                    throw std::runtime_error ("HexGridPyramid: Level " + std::to_string(k) + " has no hexes");
+                }
+                // The position lookup (and so findHexIndex) needs the d_ vectors
+                if (this->grids.back()->d_x.size() != this->grids.back()->num()) {
+                    this->grids.back()->populate_d_vectors();
+                }
+                dl *= 2.0f;
+            }
+            this->transfers.resize (nlevels - 1);
+            for (unsigned int k = 0; k + 1 < nlevels; ++k) {
+                this->build_transfer (*this->grids[k], *this->grids[k+1], this->transfers[k]);
+            }
+        }
+
+        //! The number of levels
+        unsigned int size() const { return this->grids.size(); }
+
+        //! Access the HexGrid of level \a k (0 is the finest)
+        HexGrid& grid (const unsigned int k) { return *this->grids.at(k); }
+        const HexGrid& grid (const unsigned int k) const { return *this->grids.at(k); }
+
+        /*!
+         * Restrict \a fine, which is data on level \a k, to level \a k+1, writing the
+         * result into \a coarse (which is resized as necessary).
+         */
+        template <typename T>
+        void restrictToCoarse (const unsigned int k, const std::vector<T>& fine, std::vector<T>& coarse) const
+        {
+            const Transfer& tr = this->transfers.at(k);
+            if (fine.size() != this->grids[k]->num()) {
+                throw std::runtime_error ("HexGridPyramid::restrictToCoarse: Data is not the size of the fine level");
+            }
+            const int nc = static_cast<int>(this->grids[k+1]->num());
+            coarse.resize (nc);
+#pragma omp parallel for
+            for (int i = 0; i < nc; ++i) {
+                T sum = T{0};
+                for (size_t j = tr.r_start[i]; j < tr.r_start[i+1]; ++j) {
+                    sum += static_cast<T>(tr.r_weight[j]) * fine[tr.r_src[j]];
+                }
+                coarse[i] = sum;
+            }
+        }
+
+        /*!
+         * Prolong \a coarse, which is data on level \a k+1, to level \a k, writing the
+         * result into \a fine (which is resized as necessary).
+         */
+        template <typename T>
+        void prolongToFine (const unsigned int k, const std::vector<T>& coarse, std::vector<T>& fine) const
+        {
+            const Transfer& tr = this->transfers.at(k);
+            if (coarse.size() != this->grids[k+1]->num()) {
+                throw std::runtime_error ("HexGridPyramid::prolongToFine: Data is not the size of the coarse level");
+            }
+            const int nf = static_cast<int>(this->grids[k]->num());
+            fine.resize (nf);
+#pragma omp parallel for
+            for (int i = 0; i < nf; ++i) {
+                fine[i] = static_cast<T>(tr.p_weight[2*i]) * coarse[tr.p_src[2*i]]
+                    + static_cast<T>(tr.p_weight[2*i+1]) * coarse[tr.p_src[2*i+1]];
+            }
+        }
+
+        /*!
+         * The transfer operators between level k (fine) and level k+1 (coarse).
+         */
+        struct Transfer
+        {
+            //! Prolongation: fine[i] = sum over j in {0,1} of p_weight[2i+j] * coarse[p_src[2i+j]]
+            std::vector<int> p_src;
+            std::vector<float> p_weight;
+            //! Restriction: coarse[i] = sum over j in [r_start[i], r_start[i+1]) of r_weight[j] * fine[r_src[j]]
+            std::vector<size_t> r_start;
+            std::vector<int> r_src;
+            std::vector<float> r_weight;
+        };
+
+        //! Access the transfer operators between level \a k and level \a k+1
+        const Transfer& transfer (const unsigned int k) const { return this->transfers.at(k); }
+
+    private:
+        /*!
+         * Find the index of the hex in \a g which contains (x,y) or, if there is none,
+         * a nearby hex, searching ring by ring about the lattice position.
+         */
+        static int nearby_index (const HexGrid& g, const float x, const float y)
+        {
+            int i = g.findHexIndex (morph::vec<float, 2>{x, y});
+            if (i > -1) { return i; }
+            const float gf = y / g.getv();
+            const int g0 = static_cast<int>(std::round (gf));
+            const int r0 = static_cast<int>(std::round (x / g.getd() - gf / 2.0f));
+            for (int ring = 1; ring <= 4; ++ring) {
+                float mind = std::numeric_limits<float>::max();
+                int best = -1;
+                for (int dr = -ring; dr <= ring; ++dr) {
+                    for (int dg = -ring; dg <= ring; ++dg) {
+                        if (std::abs (dr + dg) > ring || std::max (std::abs (dr), std::max (std::abs (dg), std::abs (dr + dg))) != ring) {
+                            continue;
+                        }
+                        int j = g.findHexIndex (r0 + dr, g0 + dg);
+                        if (j < 0) { continue; }
+                        float dx = g.d_x[j] - x;
+                        float dy = g.d_y[j] - y;
+                        if (dx*dx + dy*dy < mind) { mind = dx*dx + dy*dy; best = j; }
+                    }
+                }
+                if (best > -1) { return best; }
+            }
+            // Far from the grid. Search every hex.
+            float mind = std::numeric_limits<float>::max();
+            int best = -1;
+            for (unsigned int j = 0; j < g.d_x.size(); ++j) {
+                float dx = g.d_x[j] - x;
+                float dy = g.d_y[j] - y;
+                if (dx*dx + dy*dy < mind) { mind = dx*dx + dy*dy; best = j; }
+            }
+            return best;
+        }
+
+        //! Build the transfer operators between \a fine and \a coarse.
+        static void build_transfer (const HexGrid& fine, const HexGrid& coarse, Transfer& tr)
+        {
+            const int nf = static_cast<int>(fine.num());
+            const int nc = static_cast<int>(coarse.num());
+
+            // For each fine hex, up to two coarse partners, their interpolation weights
+            // and their (unnormalised) restriction weights.
+            tr.p_src.assign (2 * nf, 0);
+            tr.p_weight.assign (2 * nf, 0.0f);
+            std::vector<float> rw (2 * nf, 0.0f);
+
+#pragma omp parallel for
+            for (int i = 0; i < nf; ++i) {
+                const int r = fine.d_ri[i];
+                const int g = fine.d_gi[i];
+                int c0 = -1;
+                int c1 = -1;
+                float base = 0.5f;
+                if (!(r & 1) && !(g & 1)) {
+                    // Coincides with the coarse hex (r/2,g/2)
+                    c0 = coarse.findHexIndex (r/2, g/2);
+                    base = 1.0f;
+                } else if (!(g & 1)) {
+                    // Between coarse hexes to the W and E
+                    c0 = coarse.findHexIndex ((r-1)/2, g/2);
+                    c1 = coarse.findHexIndex ((r+1)/2, g/2);
+                } else if (!(r & 1)) {
+                    // Between coarse hexes to the SW and NE
+                    c0 = coarse.findHexIndex (r/2, (g-1)/2);
+                    c1 = coarse.findHexIndex (r/2, (g+1)/2);
+                } else {
+                    // Between coarse hexes to the SE and NW
+                    c0 = coarse.findHexIndex ((r+1)/2, (g-1)/2);
+                    c1 = coarse.findHexIndex ((r-1)/2, (g+1)/2);
+                }
+                if (c0 < 0) { std::swap (c0, c1); }
+                if (c0 < 0) {
+                    // No partner on the coarse level
+                    c0 = nearby_index (coarse, fine.d_x[i], fine.d_y[i]);
+                }
+                if (c1 < 0) {
+                    tr.p_src[2*i] = c0;
+                    tr.p_src[2*i+1] = c0;
+                    tr.p_weight[2*i] = 1.0f;
+                    rw[2*i] = base;
+                } else {
+                    tr.p_src[2*i] = c0;
+                    tr.p_src[2*i+1] = c1;
+                    tr.p_weight[2*i] = 0.5f;
+                    tr.p_weight[2*i+1] = 0.5f;
+                    rw[2*i] = base;
+                    rw[2*i+1] = base;
+                }
+            }
+
+            // Restriction is the transpose. Count the entries for each coarse hex.
+            std::vector<size_t> counts (nc, 0);
+            for (int i = 0; i < 2 * nf; ++i) {
+                if (rw[i] > 0.0f) { ++counts[tr.p_src[i]]; }
+            }
+            // Coarse hexes with no fine partners take the value of a nearby fine hex
+            std::vector<int> orphan_src (nc, -1);
+            for (int c = 0; c < nc; ++c) {
+                if (counts[c] == 0) {
+                    orphan_src[c] = nearby_index (fine, coarse.d_x[c], coarse.d_y[c]);
+                    counts[c] = 1;
+                }
+            }
+            tr.r_start.assign (nc + 1, 0);
+            for (int c = 0; c < nc; ++c) { tr.r_start[c+1] = tr.r_start[c] + counts[c]; }
+            tr.r_src.assign (tr.r_start[nc], 0);
+            tr.r_weight.assign (tr.r_start[nc], 0.0f);
+            std::vector<size_t> fill (tr.r_start.begin(), tr.r_start.end() - 1);
+            for (int c = 0; c < nc; ++c) {
+                if (orphan_src[c] > -1) {
+                    tr.r_src[fill[c]] = orphan_src[c];
+                    tr.r_weight[fill[c]++] = 1.0f;
+                }
+            }
+            for (int i = 0; i < 2 * nf; ++i) {
+                if (rw[i] > 0.0f) {
+                    const int c = tr.p_src[i];
+                    tr.r_src[fill[c]] = i / 2;
+                    tr.r_weight[fill[c]++] = rw[i];
+                }
+            }
+            // Normalise each row
+#pragma omp parallel for
+            for (int c = 0; c < nc; ++c) {
+                float sum = 0.0f;
+                for (size_t j = tr.r_start[c]; j < tr.r_start[c+1]; ++j) { sum += tr.r_weight[j]; }
+                for (size_t j = tr.r_start[c]; j < tr.r_start[c+1]; ++j) { tr.r_weight[j] /= sum; }
+            }
+        }
+
+        //! The grids, finest first
+        std::vector<std::unique_ptr<HexGrid>> grids;
+        //! The transfer operators between level k and level k+1
+        std::vector<Transfer> transfers;
+    };
+
+} // namespace morph
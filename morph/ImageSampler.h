@@ -0,0 +1,155 @@
+/*!
+ * \file ImageSampler.h
+ *
+ * Sample a monochrome image, placed on the plane, at arbitrary points: with the
+ * windowed Gaussian of Grid::resample_image and HexGrid::resampleImage, or bilinearly.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/vec.h>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace morph {
+
+    //! How Grid::resample_image and HexGrid::resampleImage sample the image
+    enum class ResampleMode
+    {
+        Gaussian, // A Gaussian weighted sum of the pixels within 3 sigma (sigma is the pixel spacing)
+        Bilinear  // Bilinear interpolation of the 4 nearest pixels; a fast preview
+    };
+
+    /*!
+     * The placement of an image of w by h pixels on the plane. The pixels are in rows,
+     * from bottom left to top right, and pixel (i, j) is at origin + dist_per_pix * (i,
+     * j).
+     *
+     * The Gaussian sample at a point (x, y) is the sum, over the pixels whose distance
+     * from (x, y) is less than 3 dist_per_pix in each of x and y, of the pixel values
+     * weighted by exp (-dx^2 / (2 sx^2) - dy^2 / (2 sy^2)) with (sx, sy) = dist_per_pix.
+     * Only the pixels in that window are visited, so a sample costs a few dozen
+     * multiply-adds, however large the image. The Gaussian is separable, so the
+     * weights are computed as one row of x weights and one column of y weights.
+     */
+    struct ImageSampler
+    {
+        //! The image width and height, in pixels
+        unsigned int w = 0;
+        unsigned int h = 0;
+        //! The distance between pixel centres in x and in y. This is also the Gaussian sigma.
+        morph::vec<float, 2> dist_per_pix = { 1.0f, 1.0f };
+        //! The location of pixel (0, 0)
+        morph::vec<float, 2> origin = { 0.0f, 0.0f };
+
+        /*!
+         * Call f (i, wt) for each pixel, of index i (into the image data), within the
+         * 3 sigma window around (x, y), with its Gaussian weight wt. The window is at
+         * most 6 pixels across in each direction.
+         */
+        template <typename F>
+        void gaussian_window (const float x, const float y, F&& f) const
+        {
+            std::array<float, 8> wx;
+            std::array<float, 8> wy;
+            int i0 = 0;
+            int j0 = 0;
+            const int ni = this->weights (x, 0, wx, i0);
+            const int nj = this->weights (y, 1, wy, j0);
+            for (int j = 0; j < nj; ++j) {
+                const unsigned int row = static_cast<unsigned int>(j0 + j) * this->w;
+                for (int i = 0; i < ni; ++i) {
+                    if (wx[i] != 0.0f && wy[j] != 0.0f) { f (row + static_cast<unsigned int>(i0 + i), wx[i] * wy[j]); }
+                }
+            }
+        }
+
+        //! The Gaussian weighted sum of the pixels of \a img around (x, y)
+        float gaussian (const float* img, const float x, const float y) const
+        {
+            std::array<float, 8> wx;
+            std::array<float, 8> wy;
+            int i0 = 0;
+            int j0 = 0;
+            const int ni = this->weights (x, 0, wx, i0);
+            const int nj = this->weights (y, 1, wy, j0);
+            float expr = 0.0f;
+            for (int j = 0; j < nj; ++j) {
+                const float* row = img + static_cast<size_t>(j0 + j) * this->w + i0;
+                float rowsum = 0.0f;
+                for (int i = 0; i < ni; ++i) { rowsum += wx[i] * row[i]; }
+                expr += wy[j] * rowsum;
+            }
+            return expr;
+        }
+
+        /*!
+         * Call f (i, wt) for each of the (up to) 4 pixels, of index i, with which the
+         * image is bilinearly interpolated at (x, y), with its weight wt. Outside the
+         * image (beyond the outermost pixel centres), there are none.
+         */
+        template <typename F>
+        void bilinear_window (const float x, const float y, F&& f) const
+        {
+            if (this->w == 0 || this->h == 0) { return; }
+            const float fx = (x - this->origin[0]) / this->dist_per_pix[0];
+            const float fy = (y - this->origin[1]) / this->dist_per_pix[1];
+            const float xmax = static_cast<float>(this->w - 1);
+            const float ymax = static_cast<float>(this->h - 1);
+            if (!(fx >= 0.0f && fx <= xmax && fy >= 0.0f && fy <= ymax)) { return; }
+            const unsigned int i = std::min (static_cast<unsigned int>(fx), this->w > 1 ? this->w - 2 : 0u);
+            const unsigned int j = std::min (static_cast<unsigned int>(fy), this->h > 1 ? this->h - 2 : 0u);
+            const float ax = this->w > 1 ? fx - static_cast<float>(i) : 0.0f;
+            const float ay = this->h > 1 ? fy - static_cast<float>(j) : 0.0f;
+            const unsigned int i1 = this->w > 1 ? i + 1 : i;
+            const unsigned int j1 = this->h > 1 ? j + 1 : j;
+            f (j * this->w + i, (1.0f - ax) * (1.0f - ay));
+            if (ax != 0.0f) { f (j * this->w + i1, ax * (1.0f - ay)); }
+            if (ay != 0.0f) { f (j1 * this->w + i, (1.0f - ax) * ay); }
+            if (ax != 0.0f && ay != 0.0f) { f (j1 * this->w + i1, ax * ay); }
+        }
+
+        //! The bilinear interpolation of \a img at (x, y); 0 outside the image
+        float bilinear (const float* img, const float x, const float y) const
+        {
+            float v = 0.0f;
+            this->bilinear_window (x, y, [img, &v](const unsigned int i, const float wt) { v += wt * img[i]; });
+            return v;
+        }
+
+        //! Sample \a img at (x, y) with the given \a mode
+        float sample (const float* img, const float x, const float y, const ResampleMode mode) const
+        {
+            return mode == ResampleMode::Bilinear ? this->bilinear (img, x, y) : this->gaussian (img, x, y);
+        }
+
+    private:
+        /*!
+         * The 1D Gaussian weights, in direction \a d, of the pixels within 3 sigma of
+         * coordinate \a c. The first pixel is written to p0, and the number of pixels is
+         * returned. Pixels in the window range, but just beyond 3 sigma, have weight 0.
+         */
+        int weights (const float c, const unsigned int d, std::array<float, 8>& wt, int& p0) const
+        {
+            const int n = static_cast<int>(d == 0 ? this->w : this->h);
+            const float dpp = this->dist_per_pix[d];
+            const float param = 1.0f / (2.0f * dpp * dpp);
+            const float threesig = 3.0f * dpp;
+            const float fc = (c - this->origin[d]) / dpp;
+            if (!(fc > -4.0f && fc < static_cast<float>(n) + 3.0f)) { return 0; }
+            // The 8 pixels from floor(fc) - 3 to floor(fc) + 4 cover (fc - 3, fc + 3)
+            const int lo = std::max (0, static_cast<int>(std::floor (fc)) - 3);
+            const int hi = std::min (n, static_cast<int>(std::floor (fc)) + 5);
+            p0 = lo;
+            for (int p = lo; p < hi; ++p) {
+                const float dc = c - (dpp * static_cast<float>(p) + this->origin[d]);
+                wt[p - lo] = (dc < threesig && dc > -threesig) ? std::exp (-param * dc * dc) : 0.0f;
+            }
+            return std::max (0, hi - lo);
+        }
+    };
+
+} // namespace morph
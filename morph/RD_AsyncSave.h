@@ -0,0 +1,59 @@
+/*!
+ * \file RD_AsyncSave.h
+ *
+ * An RD_Base which can save its snapshots in the background, with HdfWriter. This is
+ * kept out of RD_Base itself, because HdfWriter runs a std::thread; a program which
+ * uses RD_AsyncSave must link with the threads library (Threads::Threads in cmake).
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/RD_Base.h>
+#include <morph/HdfWriter.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace morph {
+
+    /*!
+     * A reaction diffusion base class which adds saveAsync to RD_Base. Derive a model
+     * from RD_AsyncSave<Flt> in place of RD_Base<Flt> to save snapshots without
+     * waiting for them to be written to disk.
+     */
+    template <class Flt>
+    class RD_AsyncSave : public RD_Base<Flt>
+    {
+    public:
+        /*!
+         * The number of snapshots that saveAsync may queue before it waits for the
+         * writer. Set this before the first call to saveAsync.
+         */
+        unsigned int saveQueueLength = 2;
+
+        /*!
+         * Save the state vectors \a datasets (each a path in the file and a pointer to
+         * the vector) to the HDF5 file \a fname in the background. The vectors are
+         * copied into a staging buffer and the function returns; a writer thread
+         * writes the file. See HdfWriter.
+         */
+        void saveAsync (const std::string& fname, const std::vector<std::pair<std::string, const std::vector<Flt>*>>& datasets)
+        {
+            if (!this->hdfwriter) { this->hdfwriter = std::make_unique<HdfWriter<Flt>>(this->saveQueueLength); }
+            this->hdfwriter->save (fname, datasets);
+        }
+
+        //! Wait until all of the snapshots queued by saveAsync have been written
+        void flushSaves() override
+        {
+            if (this->hdfwriter) { this->hdfwriter->flush(); }
+        }
+
+    protected:
+        //! The background writer for saveAsync, created on first use
+        std::unique_ptr<HdfWriter<Flt>> hdfwriter;
+    };
+
+} // namespace morph
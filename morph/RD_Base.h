@@ -6,13 +6,27 @@
 #define HEXGRID_COMPILE_LOAD_AND_SAVE 1
 #include <morph/HexGrid.h>
 #include <morph/HdfData.h>
+#include <morph/float16.h>
 #include <memory>
 #include <sstream>
 #include <vector>
 #include <array>
+#include <cstdint>
 #include <iomanip>
 #include <cmath>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
 #include <hdf5.h>
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/syscall.h>
+#endif
 #include <morph/MorphDbg.h>
 
 /*
@@ -53,6 +67,70 @@
 
 namespace morph {
 
+    //! The explicit time integration schemes of RD_Base::fused_step
+    enum class RD_Integrator
+    {
+        Euler, // Forward Euler; one evaluation of the right hand side per step
+        RK2,   // The midpoint method; two evaluations per step
+        RK4    // Classical 4th order Runge-Kutta; four evaluations per step
+    };
+
+    //! How RD_Base::reduced_step rounds the state to its 16 bit storage type
+    enum class RD_Rounding
+    {
+        Nearest,   // Round to nearest, ties to even
+        Stochastic // Round up or down at random, with probabilities that make it unbiased
+    };
+
+    /*!
+     * A contiguous range of hexes of an RD_Base in partitioned mode (see
+     * RD_Base::partition), with the halo of hexes, owned by other partitions, that the
+     * stencils of its own hexes read. The state of the partition is held in buf, which
+     * is allocated (and so first touched) by the thread that owns the partition.
+     */
+    template <typename Flt>
+    struct RD_Partition
+    {
+        //! The hexes [begin, end) in the d_ order of the HexGrid are owned by the partition
+        unsigned int begin = 0;
+        unsigned int end = 0;
+        //! The global indices of the halo hexes, sorted by owner, then by index
+        std::vector<unsigned int> halo;
+        //! The partition that owns each halo hex
+        std::vector<unsigned int> halo_part;
+        //! The index of each halo hex within the hexes of its owner (halo[k] - begin of owner)
+        std::vector<unsigned int> halo_src;
+        //! The neighbour table in local indices: own hexes are 0 to end - begin - 1, then the halo
+        std::vector<HexGrid::neighbour_row> nbrs;
+        //! The state y, stages s1 and s2, and accumulator; N (own + halo) values each
+        std::array<std::vector<Flt>, 4> buf;
+        //! The OpenMP thread that allocated buf, and the CPU and NUMA node it ran on (-1 if unknown)
+        int thread = -1;
+        int cpu = -1;
+        int node = -1;
+
+        unsigned int num_own() const { return this->end - this->begin; }
+        unsigned int num_local() const { return this->num_own() + static_cast<unsigned int>(this->halo.size()); }
+    };
+
+    /*!
+     * A state variable of a partition, as passed to the right hand side functions of
+     * RD_Base::partitioned_step. Element hi (a global hex index, which must be owned by
+     * the partition) is read with operator[], and laplace_at accepts an RD_LocalField.
+     */
+    template <typename Flt>
+    struct RD_LocalField
+    {
+        //! The values of the partition's own hexes, followed by its halo
+        const Flt* f;
+        //! The global index of the partition's first hex
+        int begin;
+        //! The partition's local neighbour table
+        const HexGrid::neighbour_row* nbrs;
+
+        Flt operator[] (const int hi) const { return this->f[hi - this->begin]; }
+    };
+
     /*!
      * Base class for RD systems
      */
@@ -137,12 +215,47 @@ namespace morph {
          */
         alignas(Flt) unsigned int stepCount = 0;
 
+        /*!
+         * The simulated time. Advanced by adaptive_step; models with a fixed dt may
+         * advance it themselves.
+         */
+        alignas(Flt) Flt simTime = Flt{0};
+
         /*!
          * ALIGNAS REGION ENDS.
          *
          * Below here, there's no need to worry about alignas keywords.
          */
 
+        /*!
+         * Error tolerances for adaptive_step. Either one value, for all of the state
+         * variables, or one for each state variable.
+         */
+        std::vector<Flt> atol = { Flt{1e-6} };
+        std::vector<Flt> rtol = { Flt{1e-3} };
+
+        //! The limits of the timestep chosen by adaptive_step
+        Flt dt_min = Flt{0};
+        Flt dt_max = std::numeric_limits<Flt>::max();
+
+        //! The number of right hand side evaluations (of all hexes) made by adaptive_step
+        unsigned long long rhsCount = 0;
+
+        //! The number of attempted timesteps rejected by adaptive_step
+        unsigned long long rejectCount = 0;
+
+        //! The relative residual to which imex_step solves its linear systems
+        Flt cg_tol = Flt{1e-6};
+
+        //! The maximum number of conjugate gradient iterations per linear solve
+        unsigned int cg_maxiter = 500;
+
+        //! The number of conjugate gradient iterations in the last imex_step (for all variables)
+        unsigned int cgIterations = 0;
+
+        //! How reduced_step rounds the new state to float16 or bfloat16
+        RD_Rounding rounding = RD_Rounding::Nearest;
+
         /*!
          * Hold on to the ReadCurves object, so that the additional contours are available.
          */
@@ -455,11 +568,19 @@ namespace morph {
          */
         virtual void save() {}
 
+        /*!
+         * Wait until any snapshots that are being saved in the background have been
+         * written. RD_Base saves nothing in the background; see RD_AsyncSave.
+         */
+        virtual void flushSaves() {}
+
         /*!
          * Save position information
          */
         void savePositions()
         {
+            // HDF5 must not be used by the background writer at the same time
+            this->flushSaves();
             std::stringstream fname;
             fname << this->logpath << "/positions.h5";
             HdfData data(fname.str());
@@ -685,6 +806,1333 @@ namespace morph {
             }
         }
 
+        /*!
+         * Compute laplacian of scalar field F, with result placed in lapF, as for
+         * compute_laplace, but reading the neighbours from the packed neighbour table
+         * HexGrid::d_nbrs. Missing neighbours are ghosts which point to the hex itself,
+         * so the loop has no branches. The neighbours are summed in the same order as
+         * in compute_laplace.
+         */
+        void compute_laplace_packed (const std::vector<Flt>& F, std::vector<Flt>& lapF)
+        {
+            this->ensure_neighbour_table();
+            const Flt norm = Flt{2} / (Flt{3.0} * this->d * this->d);
+            const HexGrid::neighbour_row* nb = this->hg->d_nbrs.data();
+            const Flt* f = F.data();
+            Flt* lap = lapF.data();
+            const int n = static_cast<int>(this->nhex);
+
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                const HexGrid::neighbour_row& r = nb[hi];
+                Flt thesum = Flt{-6} * f[hi];
+                thesum += f[r[0]];
+                thesum += f[r[1]];
+                thesum += f[r[2]];
+                thesum += f[r[3]];
+                thesum += f[r[4]];
+                thesum += f[r[5]];
+                lap[hi] = norm * thesum;
+            }
+        }
+
+        /*!
+         * 2D spatial gradient of the function f, with result placed in gradf, as for
+         * spacegrad2D, but reading the neighbours from the packed neighbour table
+         * HexGrid::d_nbrs. The choice of which neighbours contribute to the gradient
+         * estimate is the same as in spacegrad2D. Hexes with all six neighbours take a
+         * fast path; at the edge of the domain, the pattern of neighbours present
+         * selects a row of stencil coefficients, rather than a chain of branches.
+         */
+        void spacegrad2D_packed (const std::vector<Flt>& f, std::array<std::vector<Flt>, 2>& gradf)
+        {
+            this->ensure_neighbour_table();
+
+            // x coefficients for [self, E, W], indexed by (has E) | (has W) << 1
+            std::array<std::array<Flt, 3>, 4> cx;
+            cx[0] = { Flt{0}, Flt{0}, Flt{0} };
+            cx[1] = { -this->oneoverd, this->oneoverd, Flt{0} };
+            cx[2] = { this->oneoverd, Flt{0}, -this->oneoverd };
+            cx[3] = { Flt{0}, this->oneover2d, -this->oneover2d };
+
+            // y coefficients for [self, NNE, NNW, NSW, NSE], indexed by (has NNE) | (has
+            // NNW) << 1 | (has NSW) << 2 | (has NSE) << 3. The cases are tested in the
+            // same order as in spacegrad2D.
+            std::array<std::array<Flt, 5>, 16> cy;
+            const Flt hov = Flt{0.5} * this->oneoverv;
+            for (unsigned int m = 0; m < 16; ++m) {
+                const bool nne = m & 1;
+                const bool nnw = m & 2;
+                const bool nsw = m & 4;
+                const bool nse = m & 8;
+                if (nnw && nne && nsw && nse) {
+                    cy[m] = { Flt{0}, this->oneover4v, this->oneover4v, -this->oneover4v, -this->oneover4v };
+                } else if (nnw && nne) {
+                    cy[m] = { -this->oneoverv, hov, hov, Flt{0}, Flt{0} };
+                } else if (nsw && nse) {
+                    cy[m] = { this->oneoverv, Flt{0}, Flt{0}, -hov, -hov };
+                } else if (nnw && nsw) {
+                    cy[m] = { Flt{0}, Flt{0}, this->oneover2v, -this->oneover2v, Flt{0} };
+                } else if (nne && nse) {
+                    cy[m] = { Flt{0}, this->oneover2v, Flt{0}, Flt{0}, -this->oneover2v };
+                } else {
+                    cy[m] = { Flt{0}, Flt{0}, Flt{0}, Flt{0}, Flt{0} };
+                }
+            }
+
+            const HexGrid::neighbour_row* nb = this->hg->d_nbrs.data();
+            const Flt* fp = f.data();
+            Flt* gx = gradf[0].data();
+            Flt* gy = gradf[1].data();
+            const Flt k2d = this->oneover2d;
+            const Flt k4v = this->oneover4v;
+            const int n = static_cast<int>(this->nhex);
+
+            // Note - East is positive x; North is positive y.
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                const HexGrid::neighbour_row& r = nb[hi];
+                if (r[0] != hi && r[1] != hi && r[2] != hi && r[3] != hi && r[4] != hi && r[5] != hi) {
+                    // All six neighbours present, as for most of the domain
+                    gx[hi] = (fp[r[0]] - fp[r[3]]) * k2d;
+                    gy[hi] = ((fp[r[1]] - fp[r[5]]) + (fp[r[2]] - fp[r[4]])) * k4v;
+                } else {
+                    const unsigned int mx = (r[0] != hi) | (r[3] != hi) << 1;
+                    const unsigned int my = (r[1] != hi) | (r[2] != hi) << 1 | (r[4] != hi) << 2 | (r[5] != hi) << 3;
+                    const Flt f0 = fp[hi];
+                    const Flt* ax = cx[mx].data();
+                    const Flt* ay = cy[my].data();
+                    gx[hi] = ax[0] * f0 + ax[1] * fp[r[0]] + ax[2] * fp[r[3]];
+                    gy[hi] = ay[0] * f0 + ay[1] * fp[r[1]] + ay[2] * fp[r[2]] + ay[3] * fp[r[4]] + ay[4] * fp[r[5]];
+                }
+            }
+        }
+
+        /*!
+         * The Laplacian of F at the single hex \a hi, as computed by compute_laplace.
+         * This is for use in the right hand side functions passed to fused_step, so that
+         * the diffusion and reaction terms are computed together. It reads the packed
+         * neighbour table, which fused_step makes sure is built. F may also hold
+         * float16 or bfloat16 values (see reduced_step), which are converted to Flt as
+         * they are loaded.
+         */
+        template <typename S>
+        Flt laplace_at (const S* F, const int hi) const
+        {
+            const HexGrid::neighbour_row& r = this->hg->d_nbrs[hi];
+            Flt thesum = Flt{-6} * static_cast<Flt>(F[hi]);
+            thesum += static_cast<Flt>(F[r[0]]);
+            thesum += static_cast<Flt>(F[r[1]]);
+            thesum += static_cast<Flt>(F[r[2]]);
+            thesum += static_cast<Flt>(F[r[3]]);
+            thesum += static_cast<Flt>(F[r[4]]);
+            thesum += static_cast<Flt>(F[r[5]]);
+            return this->twoover3dd * thesum;
+        }
+
+        //! The Laplacian at hex \a hi of a state variable of a partition (see partitioned_step)
+        Flt laplace_at (const RD_LocalField<Flt>& F, const int hi) const
+        {
+            const int li = hi - F.begin;
+            const HexGrid::neighbour_row& r = F.nbrs[li];
+            Flt thesum = Flt{-6} * F.f[li];
+            thesum += F.f[r[0]];
+            thesum += F.f[r[1]];
+            thesum += F.f[r[2]];
+            thesum += F.f[r[3]];
+            thesum += F.f[r[4]];
+            thesum += F.f[r[5]];
+            return this->twoover3dd * thesum;
+        }
+
+        /*!
+         * Make the right hand side, for fused_step, adaptive_step, reduced_step or
+         * partitioned_step, of a reaction diffusion system of N species, declared by the
+         * species' diffusion coefficients \a D and their reaction terms. \a reaction is
+         * called as reaction (u, r) or as reaction (hi, u, r), in which u is a
+         * std::array<Flt, N> of the species' values at hex hi and r is a
+         * std::array<Flt, N>& into which the reaction terms are written. The functor
+         * that is returned adds D[s] times the Laplacian (as in compute_laplace) of each
+         * species s, in the same pass.
+         *
+         * D may be a std::array<Flt, N> of values known at runtime. It may also be an
+         * object, holding no data, of a type whose operator[] (size_t) is constexpr; then
+         * the coefficients are compile time constants, and the Laplacian of a species
+         * which does not diffuse is not computed at all.
+         *
+         * For example, for the Schnakenberg system:
+         *
+         * this->template fused_step<2> ({ &A, &B }, this->template reaction_diffusion<2> (
+         *     std::array<Flt, 2>{ D_A, D_B },
+         *     [k](const std::array<Flt, 2>& u, std::array<Flt, 2>& r) {
+         *         const Flt a2b = k[2] * u[0] * u[0] * u[1];
+         *         r[0] = k[0] - k[1] * u[0] + a2b;
+         *         r[1] = k[3] - a2b; }));
+         */
+        template <size_t N, typename Dc, typename R>
+        auto reaction_diffusion (const Dc& D, R&& reaction)
+        {
+            return [this, D, reaction = std::forward<R>(reaction)]
+                (const int hi, const auto& x, std::array<Flt, N>& dxdt)
+            {
+                std::array<Flt, N> u;
+                for (size_t s = 0; s < N; ++s) { u[s] = static_cast<Flt>(x[s][hi]); }
+                if constexpr (std::is_invocable_v<const std::decay_t<R>&, const int, const std::array<Flt, N>&, std::array<Flt, N>&>) {
+                    reaction (hi, u, dxdt);
+                } else {
+                    reaction (u, dxdt);
+                }
+                for (size_t s = 0; s < N; ++s) {
+                    if (D[s] != Flt{0}) { dxdt[s] += D[s] * this->laplace_at (x[s], hi); }
+                }
+            };
+        }
+
+        /*!
+         * Advance the N state variables in \a x by one timestep, dt, with the explicit
+         * scheme \a method.
+         *
+         * \a rhs is called as rhs (hi, xs, dxdt) for each hex hi, in which xs is a
+         * std::array<const Flt*, N> holding the state variables at the current stage
+         * and dxdt is a std::array<Flt, N>& into which rhs writes the time derivatives
+         * of the variables at hex hi. rhs may read the state at neighbouring hexes (with
+         * laplace_at, for example). It is called from OpenMP threads, so it must not
+         * write to anything except dxdt.
+         *
+         * Each stage is one pass over the hexes, which evaluates rhs and accumulates the
+         * update. The stage buffers are members, allocated on the first call (or when
+         * nhex or N change), so that no memory is allocated in a step. On return, the
+         * vectors in x hold the new state. Their storage is swapped with that of a stage
+         * buffer, rather than copied, so pointers to their data do not stay valid.
+         */
+        template <size_t N, typename F>
+        void fused_step (const std::array<std::vector<Flt>*, N>& x, F&& rhs,
+                         const RD_Integrator method = RD_Integrator::RK4)
+        {
+            this->ensure_neighbour_table();
+            if (this->stage_buf.size() != 3 * N) { this->stage_buf.resize (3 * N); }
+            for (auto& sb : this->stage_buf) {
+                if (sb.size() != this->nhex) { sb.assign (this->nhex, Flt{0}); }
+            }
+
+            // y: the state at the start of the step; acc: the new state, accumulated
+            // over the stages; s1 and s2: the state at the intermediate stages
+            std::array<const Flt*, N> y;
+            std::array<Flt*, N> acc;
+            std::array<Flt*, N> s1;
+            std::array<Flt*, N> s2;
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != this->nhex) {
+                    throw std::runtime_error ("RD_Base::fused_step: A state variable is not of size nhex");
+                }
+                y[s] = x[s]->data();
+                acc[s] = this->stage_buf[s].data();
+                s1[s] = this->stage_buf[N + s].data();
+                s2[s] = this->stage_buf[2 * N + s].data();
+            }
+
+            this->run_stages<N> (method, y, acc, s1, s2,
+                                 [this, &rhs, &y](const std::array<const Flt*, N>& in, const std::array<Flt*, N>& a,
+                                                  const bool first, const Flt ca, const std::array<Flt*, N>& out, const Flt co) {
+                                     this->fused_stage (rhs, in, y, a, first, ca, out, co);
+                                 });
+
+            for (size_t s = 0; s < N; ++s) { x[s]->swap (this->stage_buf[s]); }
+        }
+
+        /*!
+         * As fused_step, but for state variables \a x which are stored in 16 bits, as
+         * morph::float16 or morph::bfloat16 (S). This halves the memory (and the memory
+         * bandwidth) needed for the state. Values are converted to Flt as they are loaded
+         * (rhs sees a std::array<const S*, N> and can use laplace_at, which converts),
+         * and the arithmetic is done in Flt; RK4 accumulates its update in Flt, too. Only
+         * the stored states are rounded to S, as set by the member rounding.
+         *
+         * A float16 holds about 3 significant figures, so if the change in a step is
+         * smaller than about 1/2000 of the value, rounding to nearest loses it entirely.
+         * Stochastic rounding does not, because on average it rounds to the exact value.
+         *
+         * The new state is written into x, in place, except for Euler, for which the
+         * storage of x is swapped with that of a stage buffer.
+         */
+        template <size_t N, typename S, typename F>
+        void reduced_step (const std::array<std::vector<S>*, N>& x, F&& rhs,
+                           const RD_Integrator method = RD_Integrator::RK4)
+        {
+            static_assert (morph::is_float16<S>::value, "reduced_step stores state as float16 or bfloat16");
+            this->ensure_neighbour_table();
+            std::array<RD_Stage, 4> st;
+            const unsigned int nst = this->stage_schedule (method, st);
+            // Only the last stage rounds its result into the state, so a full precision
+            // accumulator is needed only if an earlier stage accumulates
+            bool need_acc = false;
+            for (unsigned int j = 0; j + 1 < nst; ++j) { need_acc = need_acc || st[j].acc >= 0; }
+
+            std::vector<std::vector<S>>& rbuf = this->reduced_buf<S>();
+            if (rbuf.size() != 2 * N) { rbuf.resize (2 * N); }
+            for (auto& rb : rbuf) {
+                if (rb.size() != this->nhex) { rb.assign (this->nhex, S{}); }
+            }
+            if (need_acc) {
+                if (this->stage_buf.size() < N) { this->stage_buf.resize (N); }
+                for (size_t s = 0; s < N; ++s) {
+                    if (this->stage_buf[s].size() != this->nhex) { this->stage_buf[s].assign (this->nhex, Flt{0}); }
+                }
+            }
+
+            std::array<const S*, N> y;
+            std::array<S*, N> xw;
+            std::array<Flt*, N> acc;
+            std::array<S*, N> s1;
+            std::array<S*, N> s2;
+            std::array<Flt*, N> nacc;
+            std::array<S*, N> none;
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != this->nhex) {
+                    throw std::runtime_error ("RD_Base::reduced_step: A state variable is not of size nhex");
+                }
+                y[s] = x[s]->data();
+                xw[s] = x[s]->data();
+                acc[s] = need_acc ? this->stage_buf[s].data() : nullptr;
+                s1[s] = rbuf[s].data();
+                s2[s] = rbuf[N + s].data();
+                nacc[s] = nullptr;
+                none[s] = nullptr;
+            }
+
+            // The last stage writes the new state, rounded. Each hex of x is read only by
+            // its own iteration, so x is overwritten in place, unless the last stage also
+            // reads the neighbours in x (as Euler's does); then it writes s1, which is
+            // swapped into x.
+            const bool in_place = st[nst - 1].in != 0;
+            auto sbuf = [&s1, &s2, &none](const int b) -> const std::array<S*, N>& {
+                return b == 1 ? s1 : (b == 2 ? s2 : none);
+            };
+            for (unsigned int j = 0; j < nst; ++j) {
+                const std::array<const S*, N> in = st[j].in == 0 ? y : RD_Base<Flt>::as_const (sbuf (st[j].in));
+                const std::array<S*, N>& fin = j + 1 < nst ? none : (in_place ? xw : s1);
+                this->reduced_stage (rhs, in, y, st[j].acc >= 0 ? acc : nacc, st[j].first, st[j].ca,
+                                     sbuf (st[j].out), st[j].co, fin);
+            }
+            if (!in_place) {
+                for (size_t s = 0; s < N; ++s) { x[s]->swap (rbuf[s]); }
+            }
+        }
+
+        /*!
+         * Advance the N state variables in \a x by one accepted timestep of the embedded
+         * Runge-Kutta method of Dormand and Prince (RK5(4)7M, as in Matlab's ode45),
+         * with control of the error. \a rhs is as for fused_step. The timestep tried
+         * first is dt. If the error estimate is too large, the step is tried again with
+         * a smaller dt. After a step is accepted, dt is set to the step size predicted
+         * for the next step, within [dt_min, dt_max]. The step size taken is returned
+         * and simTime is advanced by it.
+         *
+         * The error is the root mean square, over all hexes and state variables, of the
+         * difference between the 5th and 4th order solutions, scaled by atol + rtol *
+         * |x|. Steps are accepted if it is no more than 1 (or if dt is already dt_min).
+         *
+         * The last stage of an accepted step evaluates rhs at the new state, so it is
+         * reused as the first stage of the next step (a step then costs six rhs passes,
+         * rather than seven). If the model changes its state between steps, other than
+         * by calling adaptive_step, it must call adaptive_reset.
+         */
+        template <size_t N, typename F>
+        Flt adaptive_step (const std::array<std::vector<Flt>*, N>& x, F&& rhs)
+        {
+            // The Dormand-Prince tableau. a[i] are the coefficients of the state at stage
+            // i+1 (with a[5] the 5th order solution) and e = b - b* gives the error.
+            static constexpr double a[6][6] = {
+                { 1.0/5.0 },
+                { 3.0/40.0, 9.0/40.0 },
+                { 44.0/45.0, -56.0/15.0, 32.0/9.0 },
+                { 19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0 },
+                { 9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0 },
+                { 35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0 }
+            };
+            static constexpr double e[7] = { 71.0/57600.0, 0.0, -71.0/16695.0, 71.0/1920.0,
+                                             -17253.0/339200.0, 22.0/525.0, -1.0/40.0 };
+
+            this->ensure_neighbour_table();
+            if (this->atol.empty() || (this->atol.size() != 1 && this->atol.size() != N)
+                || this->rtol.empty() || (this->rtol.size() != 1 && this->rtol.size() != N)) {
+                throw std::runtime_error ("RD_Base::adaptive_step: atol and rtol must have 1 or N elements");
+            }
+            // Buffers: k1 to k7 then two for the stage states
+            if (this->dp_buf.size() != 9 * N) {
+                this->dp_buf.resize (9 * N);
+                this->dp_fsal = nullptr;
+            }
+            for (auto& b : this->dp_buf) {
+                if (b.size() != this->nhex) {
+                    b.assign (this->nhex, Flt{0});
+                    this->dp_fsal = nullptr;
+                }
+            }
+
+            std::array<const Flt*, N> y;
+            std::array<Flt, N> at;
+            std::array<Flt, N> rt;
+            std::array<std::array<Flt*, N>, 7> k;
+            std::array<std::array<Flt*, N>, 2> st;
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != this->nhex) {
+                    throw std::runtime_error ("RD_Base::adaptive_step: A state variable is not of size nhex");
+                }
+                y[s] = x[s]->data();
+                at[s] = this->atol.size() == 1 ? this->atol[0] : this->atol[s];
+                rt[s] = this->rtol.size() == 1 ? this->rtol[0] : this->rtol[s];
+                for (size_t j = 0; j < 7; ++j) { k[j][s] = this->dp_buf[j * N + s].data(); }
+                st[0][s] = this->dp_buf[7 * N + s].data();
+                st[1][s] = this->dp_buf[8 * N + s].data();
+            }
+            const int n = static_cast<int>(this->nhex);
+
+            // k1 = rhs (y), unless it is left over from the last step
+            if (this->dp_fsal != y[0]) {
+                this->dp_pass (rhs, y, k[0], y, k, 0, nullptr, false, k[0]);
+                ++this->rhsCount;
+            }
+
+            while (true) {
+                const Flt h = std::min (this->dt, this->dt_max);
+                // The state for stage 2
+                const Flt h21 = h * static_cast<Flt>(a[0][0]);
+#pragma omp parallel for schedule(static)
+                for (int hi = 0; hi < n; ++hi) {
+                    for (size_t s = 0; s < N; ++s) { st[0][s][hi] = y[s][hi] + h21 * k[0][s][hi]; }
+                }
+                // Stages 2 to 6, each of which also makes the state for the next stage
+                // (after stage 6, the 5th order solution) in the other stage buffer
+                unsigned int cur = 0;
+                for (unsigned int i = 1; i < 6; ++i) {
+                    Flt ha[6];
+                    for (unsigned int j = 0; j <= i; ++j) { ha[j] = h * static_cast<Flt>(a[i][j]); }
+                    this->dp_pass (rhs, RD_Base<Flt>::as_const (st[cur]), k[i], y, k, i + 1, ha, false, st[1-cur]);
+                    cur = 1 - cur;
+                }
+                // Stage 7 at the 5th order solution, and the scaled error
+                Flt he[7];
+                for (unsigned int j = 0; j < 7; ++j) { he[j] = h * static_cast<Flt>(e[j]); }
+                const Flt errsum = this->dp_pass (rhs, RD_Base<Flt>::as_const (st[cur]), k[6], y, k, 7, he, true, st[cur], at, rt);
+                this->rhsCount += 6;
+                const Flt err = std::sqrt (errsum / static_cast<Flt>(N * this->nhex));
+
+                // Step size control, with safety factor 0.9 and the change limited to
+                // between 0.2 and 5 times
+                Flt fac = err > Flt{0} ? Flt{0.9} * std::pow (err, Flt{-0.2}) : Flt{5};
+                fac = std::min (Flt{5}, std::max (Flt{0.2}, fac));
+
+                if (err <= Flt{1} || h <= this->dt_min) {
+                    // Accept. The new state and k7 (as the next k1) are swapped in.
+                    for (size_t s = 0; s < N; ++s) {
+                        x[s]->swap (this->dp_buf[(7 + cur) * N + s]);
+                        this->dp_buf[s].swap (this->dp_buf[6 * N + s]);
+                    }
+                    this->dp_fsal = x[0]->data();
+                    this->simTime += h;
+                    this->set_dt (std::max (this->dt_min, std::min (this->dt_max, h * fac)));
+                    return h;
+                }
+                ++this->rejectCount;
+                this->set_dt (std::max (this->dt_min, h * std::min (fac, Flt{1})));
+            }
+        }
+
+        //! Discard the rhs evaluation that adaptive_step would reuse in its next step
+        void adaptive_reset() { this->dp_fsal = nullptr; }
+
+        /*!
+         * Advance the N state variables in \a x by one timestep, dt, treating diffusion
+         * implicitly and reaction explicitly. Variable s diffuses with coefficient D[s]
+         * (with the Laplacian of compute_laplace) and \a reaction, called as for the rhs
+         * of fused_step, gives the reaction terms only.
+         *
+         * With order 1, this is IMEX Euler: (1 - dt D Del^2) x' = x + dt R(x). With order
+         * 2, it is the second order semi-implicit backward difference formula (SBDF2):
+         * (3/2 - dt D Del^2) x' = 2x - x_prev/2 + dt (2R(x) - R(x_prev)). SBDF2 needs the
+         * previous step, so it takes an IMEX Euler step first, and again whenever dt
+         * changes or after imex_reset. The model must call imex_reset if it changes
+         * its state between steps other than by calling imex_step.
+         *
+         * The diffusion step is unconditionally stable, so dt is limited only by the
+         * reaction terms and by accuracy. The linear systems, which are symmetric and
+         * positive definite, are solved with the conjugate gradient method, preconditioned
+         * with their diagonal, in OpenMP parallel loops. They start from x (order 1) or
+         * from 2x - x_prev (order 2), and stop when the residual is less than cg_tol times
+         * the right hand side, or after cg_maxiter iterations.
+         */
+        template <size_t N, typename F>
+        void imex_step (const std::array<std::vector<Flt>*, N>& x, const std::array<Flt, N>& D,
+                        F&& reaction, const unsigned int order = 2)
+        {
+            if (order != 1 && order != 2) { throw std::runtime_error ("RD_Base::imex_step: order must be 1 or 2"); }
+            this->ensure_neighbour_table();
+            // Buffers: the reaction terms, then the previous state and reaction terms, for
+            // each variable; then the right hand side and the four CG vectors
+            if (this->imex_buf.size() != 3 * N + 5) {
+                this->imex_buf.resize (3 * N + 5);
+                this->imex_prev = nullptr;
+            }
+            for (auto& b : this->imex_buf) {
+                if (b.size() != this->nhex) {
+                    b.assign (this->nhex, Flt{0});
+                    this->imex_prev = nullptr;
+                }
+            }
+            if (this->imex_nreal.size() != this->nhex || this->imex_nbrs_generation != this->hg->d_nbrs_generation) {
+                this->imex_nbrs_generation = this->hg->d_nbrs_generation;
+                this->imex_nreal.resize (this->nhex);
+                for (unsigned int hi = 0; hi < this->nhex; ++hi) {
+                    unsigned int m = 0;
+                    for (unsigned int j = 0; j < 6; ++j) { m += this->hg->d_nbrs[hi][j] != static_cast<int>(hi) ? 1 : 0; }
+                    this->imex_nreal[hi] = static_cast<Flt>(m);
+                }
+            }
+
+            std::array<const Flt*, N> y;
+            std::array<Flt*, N> R;
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != this->nhex) {
+                    throw std::runtime_error ("RD_Base::imex_step: A state variable is not of size nhex");
+                }
+                y[s] = x[s]->data();
+                R[s] = this->imex_buf[s].data();
+            }
+            const bool second = order == 2 && this->imex_prev == y[0] && this->imex_dt == this->dt;
+            const int n = static_cast<int>(this->nhex);
+
+            // The reaction terms, for all the variables in one pass
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                std::array<Flt, N> rh;
+                reaction (hi, y, rh);
+                for (size_t s = 0; s < N; ++s) { R[s][hi] = rh[s]; }
+            }
+
+            this->cgIterations = 0;
+            Flt* b = this->imex_buf[3 * N].data();
+            const Flt h = this->dt;
+            for (size_t s = 0; s < N; ++s) {
+                Flt* u = x[s]->data();
+                Flt* up = this->imex_buf[N + s].data();
+                Flt* Rp = this->imex_buf[2 * N + s].data();
+                const Flt* Rs = R[s];
+                // The right hand side and the initial guess, which replaces u. The current
+                // state and reaction terms become the previous ones.
+                if (second) {
+#pragma omp parallel for schedule(static)
+                    for (int hi = 0; hi < n; ++hi) {
+                        b[hi] = Flt{2} * u[hi] - Flt{0.5} * up[hi] + h * (Flt{2} * Rs[hi] - Rp[hi]);
+                        const Flt guess = Flt{2} * u[hi] - up[hi];
+                        up[hi] = u[hi];
+                        u[hi] = guess;
+                        Rp[hi] = Rs[hi];
+                    }
+                } else {
+#pragma omp parallel for schedule(static)
+                    for (int hi = 0; hi < n; ++hi) {
+                        b[hi] = u[hi] + h * Rs[hi];
+                        up[hi] = u[hi];
+                        Rp[hi] = Rs[hi];
+                    }
+                }
+                const Flt c = second ? Flt{1.5} : Flt{1};
+                if (D[s] == Flt{0}) {
+#pragma omp parallel for schedule(static)
+                    for (int hi = 0; hi < n; ++hi) { u[hi] = b[hi] / c; }
+                } else {
+                    this->cgIterations += this->imex_cg (c, h * D[s] * this->twoover3dd, b, u);
+                }
+            }
+            this->imex_prev = y[0];
+            this->imex_dt = this->dt;
+        }
+
+        //! Make the next imex_step a first order step, which does not use the previous state
+        void imex_reset() { this->imex_prev = nullptr; }
+
+        /*
+         * Ensemble mode. M members of one model, which differ in their parameters or
+         * initial conditions, are run together on the one HexGrid. Each state variable
+         * is a single vector of size nhex * M, stored [hex][member], so that element h * M
+         * + m is hex h of member m. Parameters that differ between the members are held
+         * in vectors of size M. A pass over the hexes reads the neighbour indices of each
+         * hex just once for all of the members, and the loops over the members are
+         * contiguous in memory, so that they vectorise.
+         */
+
+        //! Resize (and zero) the ensemble variable v for M members
+        void resize_ensemble_variable (std::vector<Flt>& v, const unsigned int M) { v.assign (this->nhex * M, Flt{0}); }
+
+        //! Copy member m of the ensemble variable F, which has M members, into out
+        void ensemble_member (const std::vector<Flt>& F, const unsigned int M, const unsigned int m, std::vector<Flt>& out) const
+        {
+            out.resize (this->nhex);
+            for (unsigned int hi = 0; hi < this->nhex; ++hi) { out[hi] = F[hi * M + m]; }
+        }
+
+        //! Set member m of the ensemble variable F, which has M members, from in
+        void set_ensemble_member (std::vector<Flt>& F, const unsigned int M, const unsigned int m, const std::vector<Flt>& in) const
+        {
+            for (unsigned int hi = 0; hi < this->nhex; ++hi) { F[hi * M + m] = in[hi]; }
+        }
+
+        /*!
+         * Save each of the M members of the ensemble variable F to \a data, at the path
+         * /memberNNN/name (with NNN the member number, zero padded to three digits).
+         */
+        void saveEnsemble (HdfData& data, const std::string& name, const std::vector<Flt>& F, const unsigned int M) const
+        {
+            std::vector<Flt> fm;
+            for (unsigned int m = 0; m < M; ++m) {
+                this->ensemble_member (F, M, m, fm);
+                std::stringstream path;
+                path << "/member" << std::setw(3) << std::setfill('0') << m << "/" << name;
+                data.add_contained_vals (path.str().c_str(), fm);
+            }
+        }
+
+        /*!
+         * The Laplacians at hex \a hi of all M members of the ensemble variable F,
+         * written to lap[0] to lap[M-1]. Reads the packed neighbour table, which
+         * ensemble_step makes sure is built.
+         */
+        void laplace_at (const Flt* F, const int hi, const unsigned int M, Flt* lap) const
+        {
+            const HexGrid::neighbour_row& r = this->hg->d_nbrs[hi];
+            const Flt* f0 = F + static_cast<size_t>(hi) * M;
+            const Flt* f1 = F + static_cast<size_t>(r[0]) * M;
+            const Flt* f2 = F + static_cast<size_t>(r[1]) * M;
+            const Flt* f3 = F + static_cast<size_t>(r[2]) * M;
+            const Flt* f4 = F + static_cast<size_t>(r[3]) * M;
+            const Flt* f5 = F + static_cast<size_t>(r[4]) * M;
+            const Flt* f6 = F + static_cast<size_t>(r[5]) * M;
+            const Flt norm = this->twoover3dd;
+#pragma omp simd
+            for (unsigned int m = 0; m < M; ++m) {
+                Flt thesum = Flt{-6} * f0[m];
+                thesum += f1[m];
+                thesum += f2[m];
+                thesum += f3[m];
+                thesum += f4[m];
+                thesum += f5[m];
+                thesum += f6[m];
+                lap[m] = norm * thesum;
+            }
+        }
+
+        //! Compute the Laplacian of each of the M members of the ensemble variable F
+        void compute_laplace_ensemble (const std::vector<Flt>& F, std::vector<Flt>& lapF, const unsigned int M)
+        {
+            this->ensure_neighbour_table();
+            lapF.resize (F.size());
+            const int n = static_cast<int>(this->nhex);
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                this->laplace_at (F.data(), hi, M, lapF.data() + static_cast<size_t>(hi) * M);
+            }
+        }
+
+        /*!
+         * As fused_step, but for the ensemble variables \a x, each of which has M
+         * members. \a rhs is called as rhs (hi, xs, dxdt) for each hex hi, in which xs is
+         * a std::array<const Flt*, N> holding the ensemble state variables at the
+         * current stage and dxdt is a std::array<Flt*, N>&, each element of which
+         * points to M values, into which rhs writes the time derivatives of the
+         * variables of each member at hex hi.
+         */
+        template <size_t N, typename F>
+        void ensemble_step (const std::array<std::vector<Flt>*, N>& x, const unsigned int M, F&& rhs,
+                            const RD_Integrator method = RD_Integrator::RK4)
+        {
+            this->ensure_neighbour_table();
+            const size_t len = static_cast<size_t>(this->nhex) * M;
+            if (this->ensemble_buf.size() != 3 * N) { this->ensemble_buf.resize (3 * N); }
+            for (auto& eb : this->ensemble_buf) {
+                if (eb.size() != len) { eb.assign (len, Flt{0}); }
+            }
+
+            std::array<const Flt*, N> y;
+            std::array<Flt*, N> acc;
+            std::array<Flt*, N> s1;
+            std::array<Flt*, N> s2;
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != len) {
+                    throw std::runtime_error ("RD_Base::ensemble_step: A state variable is not of size nhex * M");
+                }
+                y[s] = x[s]->data();
+                acc[s] = this->ensemble_buf[s].data();
+                s1[s] = this->ensemble_buf[N + s].data();
+                s2[s] = this->ensemble_buf[2 * N + s].data();
+            }
+
+            this->run_stages<N> (method, y, acc, s1, s2,
+                                 [this, &rhs, &y, M](const std::array<const Flt*, N>& in, const std::array<Flt*, N>& a,
+                                                     const bool first, const Flt ca, const std::array<Flt*, N>& out, const Flt co) {
+                                     this->ensemble_stage (rhs, M, in, y, a, first, ca, out, co);
+                                 });
+
+            for (size_t s = 0; s < N; ++s) { x[s]->swap (this->ensemble_buf[s]); }
+        }
+
+        /*
+         * Partitioned mode. The hexes are divided into partitions, each a contiguous
+         * range of the d_ order of the HexGrid, and each owned by one OpenMP thread.
+         * Each partition holds the state of its own hexes, and a halo of copies of the
+         * neighbouring hexes of other partitions, in storage that its own thread
+         * allocates and first touches. On a multi-socket (NUMA) machine, the operating
+         * system then places each partition's memory on the node of the thread that
+         * works on it, whereas the state vectors that RD_Base allocates are placed on the
+         * node of the thread that calls allocate(). Before each stage of a step, the halos
+         * are copied from the partitions that own them, as listed in the partitions'
+         * halo index lists.
+         *
+         * The partitions are compact, with small halos, if hexes which are near to each
+         * other are near in the d_ order; call hg->renumber (HexDomainOrder::Hilbert)
+         * before partition() (and before allocating the state vectors). For the threads
+         * to stay on their nodes, bind them, with OMP_PROC_BIND=spread or close (and
+         * OMP_PLACES=cores, for example). partitionReport() gives the thread, CPU and
+         * NUMA node which allocated each partition, so the placement can be checked.
+         *
+         * A run is: partition (np); scatter_partitions<N> (x); partitioned_step<N> (rhs)
+         * for each step; gather_partitions<N> (x) whenever the state is needed in x.
+         */
+
+        //! The partitions, set up by partition()
+        std::vector<RD_Partition<Flt>> partitions;
+
+        /*!
+         * Divide the hexes into \a np partitions of (nearly) equal size, and find their
+         * halos. If np is 0, there is one partition for each OpenMP thread. The state of
+         * the partitions is allocated by scatter_partitions.
+         */
+        void partition (unsigned int np = 0)
+        {
+            this->ensure_neighbour_table();
+            if (np == 0) {
+#ifdef _OPENMP
+                np = static_cast<unsigned int>(omp_get_max_threads());
+#else
+                np = 1;
+#endif
+            }
+            np = std::max (1u, std::min (np, this->nhex));
+            this->partitions.assign (np, RD_Partition<Flt>{});
+            this->partition_nvars = 0;
+
+            std::vector<unsigned int> owner (this->nhex);
+            for (unsigned int p = 0; p < np; ++p) {
+                RD_Partition<Flt>& pt = this->partitions[p];
+                pt.begin = static_cast<unsigned int>(static_cast<unsigned long long>(this->nhex) * p / np);
+                pt.end = static_cast<unsigned int>(static_cast<unsigned long long>(this->nhex) * (p + 1) / np);
+                for (unsigned int hi = pt.begin; hi < pt.end; ++hi) { owner[hi] = p; }
+            }
+
+            // The local index of each halo hex of the partition being set up
+            std::vector<int> local (this->nhex, -1);
+            for (RD_Partition<Flt>& pt : this->partitions) {
+                const int b = static_cast<int>(pt.begin);
+                const int e = static_cast<int>(pt.end);
+                for (int hi = b; hi < e; ++hi) {
+                    for (const std::int32_t nb : this->hg->d_nbrs[hi]) {
+                        if (nb < b || nb >= e) { pt.halo.push_back (static_cast<unsigned int>(nb)); }
+                    }
+                }
+                std::sort (pt.halo.begin(), pt.halo.end(), [&owner](unsigned int a, unsigned int c) {
+                    return owner[a] < owner[c] || (owner[a] == owner[c] && a < c);
+                });
+                pt.halo.erase (std::unique (pt.halo.begin(), pt.halo.end()), pt.halo.end());
+
+                const int nown = static_cast<int>(pt.num_own());
+                pt.halo_part.resize (pt.halo.size());
+                pt.halo_src.resize (pt.halo.size());
+                for (size_t k = 0; k < pt.halo.size(); ++k) {
+                    const unsigned int g = pt.halo[k];
+                    pt.halo_part[k] = owner[g];
+                    pt.halo_src[k] = g - this->partitions[owner[g]].begin;
+                    local[g] = nown + static_cast<int>(k);
+                }
+                pt.nbrs.resize (pt.num_own());
+                for (int hi = b; hi < e; ++hi) {
+                    for (unsigned int j = 0; j < 6; ++j) {
+                        const std::int32_t nb = this->hg->d_nbrs[hi][j];
+                        pt.nbrs[hi - b][j] = (nb >= b && nb < e) ? nb - b : local[nb];
+                    }
+                }
+                for (const unsigned int g : pt.halo) { local[g] = -1; }
+            }
+        }
+
+        /*!
+         * Allocate the state of the partitions, for N state variables, and copy the
+         * state from \a x into it. Each partition's storage is allocated and first
+         * touched by the thread that owns it, which records where it ran.
+         */
+        template <size_t N>
+        void scatter_partitions (const std::array<std::vector<Flt>*, N>& x)
+        {
+            if (this->partitions.empty()) {
+                throw std::runtime_error ("RD_Base::scatter_partitions: Call partition() first");
+            }
+            for (size_t s = 0; s < N; ++s) {
+                if (x[s]->size() != this->nhex) {
+                    throw std::runtime_error ("RD_Base::scatter_partitions: A state variable is not of size nhex");
+                }
+            }
+            this->partition_nvars = N;
+            const int np = static_cast<int>(this->partitions.size());
+#pragma omp parallel
+            {
+                const int t = RD_Base<Flt>::thread_num();
+                const int nt = RD_Base<Flt>::num_threads();
+                for (int p = t; p < np; p += nt) {
+                    RD_Partition<Flt>& pt = this->partitions[p];
+                    const size_t nloc = pt.num_local();
+                    for (auto& b : pt.buf) {
+                        b.clear();
+                        b.shrink_to_fit();
+                        b.assign (N * nloc, Flt{0});
+                    }
+                    pt.thread = t;
+                    RD_Base<Flt>::where_am_i (pt.cpu, pt.node);
+                    for (size_t s = 0; s < N; ++s) {
+                        std::copy (x[s]->begin() + pt.begin, x[s]->begin() + pt.end, pt.buf[0].begin() + s * nloc);
+                        for (size_t k = 0; k < pt.halo.size(); ++k) {
+                            pt.buf[0][s * nloc + pt.num_own() + k] = (*x[s])[pt.halo[k]];
+                        }
+                    }
+                }
+            }
+        }
+
+        //! Copy the state of the partitions into \a x, which is resized if necessary
+        template <size_t N>
+        void gather_partitions (const std::array<std::vector<Flt>*, N>& x) const
+        {
+            if (this->partition_nvars != N) {
+                throw std::runtime_error ("RD_Base::gather_partitions: The partitions do not hold N state variables");
+            }
+            for (size_t s = 0; s < N; ++s) { x[s]->resize (this->nhex); }
+            const int np = static_cast<int>(this->partitions.size());
+#pragma omp parallel for schedule(static)
+            for (int p = 0; p < np; ++p) {
+                const RD_Partition<Flt>& pt = this->partitions[p];
+                const size_t nloc = pt.num_local();
+                for (size_t s = 0; s < N; ++s) {
+                    const Flt* ys = pt.buf[0].data() + s * nloc;
+                    std::copy (ys, ys + pt.num_own(), x[s]->begin() + pt.begin);
+                }
+            }
+        }
+
+        /*!
+         * Advance the state of the partitions by one timestep, dt, with the explicit
+         * scheme \a method, as fused_step does for state vectors. \a rhs is called as
+         * rhs (hi, xs, dxdt), as for fused_step, with the global index hi of the hex,
+         * but xs is a std::array<RD_LocalField<Flt>, N>. So rhs must read the state at
+         * hi as xs[s][hi], and the state of the neighbours only through laplace_at (xs[s],
+         * hi). The functors made by reaction_diffusion do this. The results are the
+         * same as those of fused_step.
+         *
+         * All of the stages are computed in one parallel region, in which each thread
+         * works on the partitions it owns: it copies their halos from the other
+         * partitions, then computes the stage, then waits at a barrier.
+         */
+        template <size_t N, typename F>
+        void partitioned_step (F&& rhs, const RD_Integrator method = RD_Integrator::RK4)
+        {
+            if (this->partitions.empty() || this->partition_nvars != N) {
+                throw std::runtime_error ("RD_Base::partitioned_step: Call partition() and scatter_partitions<N>() first");
+            }
+            // The stages as for fused_step
+            std::array<RD_Stage, 4> st;
+            const unsigned int nst = this->stage_schedule (method, st);
+
+            const int np = static_cast<int>(this->partitions.size());
+#pragma omp parallel
+            {
+                const int t = RD_Base<Flt>::thread_num();
+                const int nt = RD_Base<Flt>::num_threads();
+                for (unsigned int j = 0; j < nst; ++j) {
+                    // Each stage reads the own hexes of other partitions' input buffers,
+                    // which no stage writes, and writes only its own partitions' buffers
+                    for (int p = t; p < np; p += nt) {
+                        this->exchange_halo (this->partitions[p], st[j].in, N);
+                        this->partition_stage<N> (rhs, this->partitions[p], st[j]);
+                    }
+#pragma omp barrier
+                }
+                for (int p = t; p < np; p += nt) { this->partitions[p].buf[0].swap (this->partitions[p].buf[3]); }
+            }
+        }
+
+        /*!
+         * A description of the partitions: their hexes, their halos, and the thread,
+         * CPU and NUMA node that allocated their storage in scatter_partitions.
+         */
+        std::string partitionReport() const
+        {
+            std::stringstream ss;
+            for (size_t p = 0; p < this->partitions.size(); ++p) {
+                const RD_Partition<Flt>& pt = this->partitions[p];
+                std::vector<unsigned int> srcs = pt.halo_part;
+                srcs.erase (std::unique (srcs.begin(), srcs.end()), srcs.end());
+                ss << "partition " << p << ": hexes [" << pt.begin << ", " << pt.end << "), halo of "
+                   << pt.halo.size() << " hexes from " << srcs.size() << " partitions; ";
+                if (pt.thread < 0) {
+                    ss << "not allocated\n";
+                } else {
+                    ss << "thread " << pt.thread << ", cpu " << pt.cpu << ", node " << pt.node << "\n";
+                }
+            }
+            return ss.str();
+        }
+
+    protected:
+        //! Working storage for imex_step
+        std::vector<std::vector<Flt>> imex_buf;
+
+        //! The number of real (not ghost) neighbours of each hex
+        std::vector<Flt> imex_nreal;
+
+        //! The HexGrid::d_nbrs_generation from which imex_nreal was computed
+        unsigned int imex_nbrs_generation = 0;
+
+        //! The state (data of the first variable) at which imex_buf holds the previous step, if any
+        const Flt* imex_prev = nullptr;
+
+        //! The dt of the previous imex_step
+        Flt imex_dt = Flt{0};
+
+        /*!
+         * Solve (c - k L) u = b, in which L is the sum of the neighbours (with ghosts)
+         * minus 6 times the hex itself, with the Jacobi preconditioned conjugate gradient
+         * method, starting from the guess in u. Return the number of iterations.
+         */
+        unsigned int imex_cg (const Flt c, const Flt k, const Flt* b, Flt* u)
+        {
+            const size_t nb = this->imex_buf.size();
+            Flt* r = this->imex_buf[nb - 4].data();
+            Flt* z = this->imex_buf[nb - 3].data();
+            Flt* p = this->imex_buf[nb - 2].data();
+            Flt* q = this->imex_buf[nb - 1].data();
+            const HexGrid::neighbour_row* nbr = this->hg->d_nbrs.data();
+            const Flt* m = this->imex_nreal.data();
+            const int n = static_cast<int>(this->nhex);
+
+            // The operator at hex hi. Ghost neighbours cancel, leaving the real ones.
+            auto A = [c, k, nbr](const Flt* v, const int hi) {
+                const HexGrid::neighbour_row& rw = nbr[hi];
+                Flt thesum = Flt{-6} * v[hi];
+                thesum += v[rw[0]];
+                thesum += v[rw[1]];
+                thesum += v[rw[2]];
+                thesum += v[rw[3]];
+                thesum += v[rw[4]];
+                thesum += v[rw[5]];
+                return c * v[hi] - k * thesum;
+            };
+
+            Flt rz = Flt{0};
+            Flt rr = Flt{0};
+            Flt bb = Flt{0};
+#pragma omp parallel for schedule(static) reduction(+:rz,rr,bb)
+            for (int hi = 0; hi < n; ++hi) {
+                r[hi] = b[hi] - A (u, hi);
+                z[hi] = r[hi] / (c + k * m[hi]);
+                p[hi] = z[hi];
+                rz += r[hi] * z[hi];
+                rr += r[hi] * r[hi];
+                bb += b[hi] * b[hi];
+            }
+            const Flt tol2 = this->cg_tol * this->cg_tol * bb;
+            unsigned int it = 0;
+            while (rr > tol2 && it < this->cg_maxiter) {
+                Flt pq = Flt{0};
+#pragma omp parallel for schedule(static) reduction(+:pq)
+                for (int hi = 0; hi < n; ++hi) {
+                    q[hi] = A (p, hi);
+                    pq += p[hi] * q[hi];
+                }
+                const Flt alpha = rz / pq;
+                Flt rz_new = Flt{0};
+                rr = Flt{0};
+#pragma omp parallel for schedule(static) reduction(+:rz_new,rr)
+                for (int hi = 0; hi < n; ++hi) {
+                    u[hi] += alpha * p[hi];
+                    r[hi] -= alpha * q[hi];
+                    z[hi] = r[hi] / (c + k * m[hi]);
+                    rz_new += r[hi] * z[hi];
+                    rr += r[hi] * r[hi];
+                }
+                const Flt beta = rz_new / rz;
+                rz = rz_new;
+#pragma omp parallel for schedule(static)
+                for (int hi = 0; hi < n; ++hi) { p[hi] = z[hi] + beta * p[hi]; }
+                ++it;
+            }
+            return it;
+        }
+
+        //! Stage buffers for fused_step; 3 per state variable
+        std::vector<std::vector<Flt>> stage_buf;
+
+        //! Stage buffers for ensemble_step; 3 per state variable, each of nhex * M
+        std::vector<std::vector<Flt>> ensemble_buf;
+
+        //! 16 bit stage buffers for reduced_step; 2 per state variable
+        std::vector<std::vector<morph::float16>> f16_buf;
+        std::vector<std::vector<morph::bfloat16>> bf16_buf;
+
+        //! Counts the stages of reduced_step, to seed stochastic rounding
+        std::uint32_t roundingSeed = 0;
+
+        //! The reduced_step stage buffers of type S
+        template <typename S>
+        std::vector<std::vector<S>>& reduced_buf()
+        {
+            if constexpr (std::is_same<S, morph::float16>::value) {
+                return this->f16_buf;
+            } else {
+                return this->bf16_buf;
+            }
+        }
+
+        //! A random number for stochastic rounding of element i in the stage seeded with seed
+        static std::uint32_t rounding_hash (const std::uint32_t i, const std::uint32_t seed)
+        {
+            // The finalising mix of MurmurHash3
+            std::uint32_t u = i * 0x9e3779b1u ^ seed * 0x85ebca77u;
+            u ^= u >> 16;
+            u *= 0x85ebca6bu;
+            u ^= u >> 13;
+            u *= 0xc2b2ae35u;
+            u ^= u >> 16;
+            return u;
+        }
+
+        //! Stage buffers for adaptive_step; 9 per state variable
+        std::vector<std::vector<Flt>> dp_buf;
+
+        //! The state (data of the first variable) at which dp_buf holds rhs, if any
+        const Flt* dp_fsal = nullptr;
+
+        /*!
+         * One stage of adaptive_step: for each hex, evaluate kout = rhs (in), then
+         * compute, from y and the first nk of the k, either out = y + sum_j c[j] k_j or
+         * (if errmode) the sum of the squares of (sum_j c[j] k_j) / (at + rt *
+         * max(|y|, |out|)), which is returned.
+         */
+        template <size_t N, typename F>
+        Flt dp_pass (F& rhs, const std::array<const Flt*, N>& in, const std::array<Flt*, N>& kout,
+                     const std::array<const Flt*, N>& y, const std::array<std::array<Flt*, N>, 7>& k,
+                     const unsigned int nk, const Flt* c, const bool errmode, const std::array<Flt*, N>& out,
+                     const std::array<Flt, N>& at = {}, const std::array<Flt, N>& rt = {})
+        {
+            const int n = static_cast<int>(this->nhex);
+            Flt errsum = Flt{0};
+#pragma omp parallel for schedule(static) reduction(+:errsum)
+            for (int hi = 0; hi < n; ++hi) {
+                std::array<Flt, N> kh;
+                rhs (hi, in, kh);
+                for (size_t s = 0; s < N; ++s) {
+                    kout[s][hi] = kh[s];
+                    if (nk == 0) { continue; }
+                    Flt sum = Flt{0};
+                    for (unsigned int j = 0; j < nk; ++j) { sum += c[j] * k[j][s][hi]; }
+                    if (!errmode) {
+                        out[s][hi] = y[s][hi] + sum;
+                    } else {
+                        const Flt sc = at[s] + rt[s] * std::max (std::abs (y[s][hi]), std::abs (out[s][hi]));
+                        const Flt r = sum / sc;
+                        errsum += r * r;
+                    }
+                }
+            }
+            return errsum;
+        }
+
+        /*!
+         * A stage of an explicit step: the input, accumulator and output buffers and
+         * coefficients. Buffer 0 is the state y at the start of the step, 1 and 2 are
+         * the intermediate states s1 and s2, and 3 is the accumulator; -1 means none.
+         */
+        struct RD_Stage
+        {
+            unsigned int in;
+            int acc;
+            bool first;
+            Flt ca;
+            int out;
+            Flt co;
+        };
+
+        //! Write the stages of the scheme \a method into \a st and return their number
+        unsigned int stage_schedule (const RD_Integrator method, std::array<RD_Stage, 4>& st) const
+        {
+            const Flt h = this->dt;
+            const Flt h2 = this->dt / Flt{2};
+            const Flt h3 = this->dt / Flt{3};
+            const Flt h6 = this->dt / Flt{6};
+            unsigned int nst = 0;
+            switch (method) {
+            case RD_Integrator::Euler:
+            {
+                st[nst++] = { 0, 3, true, h, -1, Flt{0} };
+                break;
+            }
+            case RD_Integrator::RK2:
+            {
+                st[nst++] = { 0, -1, true, Flt{0}, 1, h2 };
+                st[nst++] = { 1, 3, true, h, -1, Flt{0} };
+                break;
+            }
+            case RD_Integrator::RK4:
+            default:
+            {
+                st[nst++] = { 0, 3, true, h6, 1, h2 };
+                st[nst++] = { 1, 3, false, h3, 2, h2 };
+                st[nst++] = { 2, 3, false, h3, 1, h };
+                st[nst++] = { 1, 3, false, h6, -1, Flt{0} };
+                break;
+            }
+            }
+            return nst;
+        }
+
+        /*!
+         * Run the stages of the scheme \a method on the state vectors y, s1, s2 and acc
+         * by calling stage (in, acc, first, ca, out, co) for each, in which in is a
+         * std::array<const Flt*, N> and acc and out are std::array<Flt*, N>, of null
+         * pointers where the stage has no accumulator or output.
+         */
+        template <size_t N, typename G>
+        void run_stages (const RD_Integrator method, const std::array<const Flt*, N>& y, const std::array<Flt*, N>& acc,
+                         const std::array<Flt*, N>& s1, const std::array<Flt*, N>& s2, G&& stage)
+        {
+            std::array<RD_Stage, 4> st;
+            const unsigned int nst = this->stage_schedule (method, st);
+            std::array<Flt*, N> none;
+            none.fill (nullptr);
+            auto buf = [&acc, &s1, &s2, &none](const int b) -> const std::array<Flt*, N>& {
+                return b == 1 ? s1 : (b == 2 ? s2 : (b == 3 ? acc : none));
+            };
+            for (unsigned int j = 0; j < nst; ++j) {
+                const std::array<const Flt*, N> in = st[j].in == 0 ? y : RD_Base<Flt>::as_const (buf (st[j].in));
+                stage (in, buf (st[j].acc), st[j].first, st[j].ca, buf (st[j].out), st[j].co);
+            }
+        }
+
+        /*!
+         * One stage of fused_step. For each hex, evaluate k = rhs (in). If acc is
+         * non-null, set acc = (first ? y : acc) + ca * k. If out is non-null, set out =
+         * y + co * k.
+         */
+        template <size_t N, typename F>
+        void fused_stage (F& rhs, const std::array<const Flt*, N>& in, const std::array<const Flt*, N>& y,
+                          const std::array<Flt*, N>& acc, const bool first, const Flt ca,
+                          const std::array<Flt*, N>& out, const Flt co)
+        {
+            const bool do_acc = acc[0] != nullptr;
+            const bool do_out = out[0] != nullptr;
+            const int n = static_cast<int>(this->nhex);
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                std::array<Flt, N> k;
+                rhs (hi, in, k);
+                for (size_t s = 0; s < N; ++s) {
+                    if (do_acc) { acc[s][hi] = (first ? y[s][hi] : acc[s][hi]) + ca * k[s]; }
+                    if (do_out) { out[s][hi] = y[s][hi] + co * k[s]; }
+                }
+            }
+        }
+
+        /*!
+         * One stage of reduced_step. For each hex, evaluate k = rhs (in). If acc is
+         * non-null, set acc = (first ? y : acc) + ca * k. If out is non-null, set out =
+         * y + co * k, rounded. If fin is non-null, set fin = (first ? y : acc) + ca * k,
+         * rounded, instead of acc.
+         */
+        template <size_t N, typename S, typename F>
+        void reduced_stage (F& rhs, const std::array<const S*, N>& in, const std::array<const S*, N>& y,
+                            const std::array<Flt*, N>& acc, const bool first, const Flt ca,
+                            const std::array<S*, N>& out, const Flt co, const std::array<S*, N>& fin)
+        {
+            const bool do_acc = acc[0] != nullptr;
+            const bool do_out = out[0] != nullptr;
+            const bool do_fin = fin[0] != nullptr;
+            const bool stochastic = this->rounding == RD_Rounding::Stochastic;
+            const std::uint32_t seed = this->roundingSeed++;
+            const int n = static_cast<int>(this->nhex);
+#pragma omp parallel for schedule(static)
+            for (int hi = 0; hi < n; ++hi) {
+                std::array<Flt, N> k;
+                rhs (hi, in, k);
+                for (size_t s = 0; s < N; ++s) {
+                    const Flt ys = static_cast<Flt>(y[s][hi]);
+                    const std::uint32_t ri = static_cast<std::uint32_t>(hi) * static_cast<std::uint32_t>(N) + static_cast<std::uint32_t>(s);
+                    if (do_out) {
+                        const float v = static_cast<float>(ys + co * k[s]);
+                        out[s][hi] = stochastic ? morph::stochastic_round<S> (v, RD_Base<Flt>::rounding_hash (ri, 2 * seed)) : S (v);
+                    }
+                    const Flt a = (first || !do_acc ? ys : acc[s][hi]) + ca * k[s];
+                    if (do_fin) {
+                        const float v = static_cast<float>(a);
+                        fin[s][hi] = stochastic ? morph::stochastic_round<S> (v, RD_Base<Flt>::rounding_hash (ri, 2 * seed + 1)) : S (v);
+                    } else if (do_acc) {
+                        acc[s][hi] = a;
+                    }
+                }
+            }
+        }
+
+        //! One stage of ensemble_step; as fused_stage, for M members per hex
+        template <size_t N, typename F>
+        void ensemble_stage (F& rhs, const unsigned int M, const std::array<const Flt*, N>& in,
+                             const std::array<const Flt*, N>& y, const std::array<Flt*, N>& acc, const bool first,
+                             const Flt ca, const std::array<Flt*, N>& out, const Flt co)
+        {
+            const bool do_acc = acc[0] != nullptr;
+            const bool do_out = out[0] != nullptr;
+            const int n = static_cast<int>(this->nhex);
+#pragma omp parallel
+            {
+                // The derivatives of the M members at one hex
+                std::vector<Flt> kbuf (N * M);
+                std::array<Flt*, N> k;
+                for (size_t s = 0; s < N; ++s) { k[s] = kbuf.data() + s * M; }
+#pragma omp for schedule(static)
+                for (int hi = 0; hi < n; ++hi) {
+                    rhs (hi, in, k);
+                    const size_t o = static_cast<size_t>(hi) * M;
+                    for (size_t s = 0; s < N; ++s) {
+                        const Flt* ks = k[s];
+                        const Flt* ys = y[s] + o;
+                        if (do_acc) {
+                            Flt* as = acc[s] + o;
+                            if (first) {
+#pragma omp simd
+                                for (unsigned int m = 0; m < M; ++m) { as[m] = ys[m] + ca * ks[m]; }
+                            } else {
+#pragma omp simd
+                                for (unsigned int m = 0; m < M; ++m) { as[m] += ca * ks[m]; }
+                            }
+                        }
+                        if (do_out) {
+                            Flt* os = out[s] + o;
+#pragma omp simd
+                            for (unsigned int m = 0; m < M; ++m) { os[m] = ys[m] + co * ks[m]; }
+                        }
+                    }
+                }
+            }
+        }
+
+        //! The number of state variables held by the partitions; 0 until scatter_partitions
+        size_t partition_nvars = 0;
+
+
+        //! Copy the halo of buffer \a b of \a pt, for nv state variables, from the partitions that own it
+        void exchange_halo (RD_Partition<Flt>& pt, const unsigned int b, const size_t nv)
+        {
+            const size_t nloc = pt.num_local();
+            const size_t nown = pt.num_own();
+            for (size_t s = 0; s < nv; ++s) {
+                Flt* dst = pt.buf[b].data() + s * nloc + nown;
+                for (size_t k = 0; k < pt.halo.size(); ++k) {
+                    const RD_Partition<Flt>& src = this->partitions[pt.halo_part[k]];
+                    dst[k] = src.buf[b][s * src.num_local() + pt.halo_src[k]];
+                }
+            }
+        }
+
+        //! One stage of partitioned_step on the partition \a pt; as fused_stage
+        template <size_t N, typename F>
+        void partition_stage (F& rhs, RD_Partition<Flt>& pt, const RD_Stage& st)
+        {
+            const size_t nloc = pt.num_local();
+            const int nown = static_cast<int>(pt.num_own());
+            const int b = static_cast<int>(pt.begin);
+            std::array<RD_LocalField<Flt>, N> in;
+            std::array<const Flt*, N> y;
+            std::array<Flt*, N> acc;
+            std::array<Flt*, N> out;
+            for (size_t s = 0; s < N; ++s) {
+                in[s] = { pt.buf[st.in].data() + s * nloc, b, pt.nbrs.data() };
+                y[s] = pt.buf[0].data() + s * nloc;
+                acc[s] = st.acc < 0 ? nullptr : pt.buf[st.acc].data() + s * nloc;
+                out[s] = st.out < 0 ? nullptr : pt.buf[st.out].data() + s * nloc;
+            }
+            const bool do_acc = st.acc >= 0;
+            const bool do_out = st.out >= 0;
+            for (int li = 0; li < nown; ++li) {
+                std::array<Flt, N> k;
+                rhs (b + li, in, k);
+                for (size_t s = 0; s < N; ++s) {
+                    if (do_acc) { acc[s][li] = (st.first ? y[s][li] : acc[s][li]) + st.ca * k[s]; }
+                    if (do_out) { out[s][li] = y[s][li] + st.co * k[s]; }
+                }
+            }
+        }
+
+        //! The number of the calling OpenMP thread, and the number of threads in the team
+        static int thread_num()
+        {
+#ifdef _OPENMP
+            return omp_get_thread_num();
+#else
+            return 0;
+#endif
+        }
+        static int num_threads()
+        {
+#ifdef _OPENMP
+            return omp_get_num_threads();
+#else
+            return 1;
+#endif
+        }
+
+        //! The CPU and NUMA node on which the calling thread is running, or -1 where unknown
+        static void where_am_i (int& cpu, int& node)
+        {
+            cpu = -1;
+            node = -1;
+#if defined(__linux__) && defined(SYS_getcpu)
+            unsigned int c = 0;
+            unsigned int n = 0;
+            if (syscall (SYS_getcpu, &c, &n, nullptr) == 0) {
+                cpu = static_cast<int>(c);
+                node = static_cast<int>(n);
+            }
+#endif
+        }
+
+        //! The const pointer version of an array of pointers to the stage buffers
+        template <typename T, size_t N>
+        static std::array<const T*, N> as_const (const std::array<T*, N>& p)
+        {
+            std::array<const T*, N> cp;
+            for (size_t s = 0; s < N; ++s) { cp[s] = p[s]; }
+            return cp;
+        }
+
+        /*!
+         * Make sure that hg's packed neighbour table is built, with ghost neighbours. The
+         * RD stencils have no sentinel slot in their data, so a table that client code
+         * has built with a sentinel for missing neighbours is not overwritten; instead,
+         * this throws.
+         */
+        void ensure_neighbour_table()
+        {
+            if (this->hg->d_nbrs_missing != -1) {
+                throw std::runtime_error ("RD_Base: The HexGrid's neighbour table has a sentinel for missing neighbours, "
+                                          "but the RD stencils need ghost neighbours (build_neighbour_table(-1))");
+            }
+            if (this->hg->d_nbrs.size() != this->nhex) { this->hg->build_neighbour_table(); }
+        }
+
     }; // RD_Base
 
 } // namespace morph
@@ -0,0 +1,322 @@
+/*!
+ * \file ResampleOperator.h
+ *
+ * A sparse matrix which resamples images of a fixed size onto a grid, built once and
+ * then applied to each image (such as each frame of a video).
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/ImageSampler.h>
+#include <morph/Grid.h>
+#include <morph/HexGrid.h>
+#include <morph/CartGrid.h>
+#include <morph/BinaryCache.h>
+#include <morph/Scale.h>
+#include <morph/vec.h>
+#include <morph/vvec.h>
+#include <list>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+namespace morph {
+
+    /*!
+     * HexGrid::resampleImage, Grid::resample_image and CartGrid::resampleToPolar
+     * compute the weight of each image pixel for each element of the grid every time
+     * that they are called. For a sequence of images of the same size, placed in the
+     * same way, the weights do not change. ResampleOperator computes them once, into a
+     * compressed sparse row (CSR) matrix with one row per grid element and one column
+     * per image pixel. apply() is then a sparse matrix-vector product, carried out in an
+     * OpenMP parallel loop, followed by the same renormalisation as the function that
+     * the operator replaces.
+     *
+     * Building the operator for a large grid is the expensive part, so it can be saved
+     * to (and loaded from) a binary file. Each build function takes an optional cache
+     * path: if the file there holds an operator built for the same geometry (which is
+     * identified by a hash of the build parameters and of the grid coordinates), it is
+     * loaded; otherwise the operator is built and saved there.
+     */
+    class ResampleOperator
+    {
+    public:
+        ResampleOperator() {}
+
+        /*!
+         * Build the operator that samples an image placed as in \a sampler at each of
+         * the points (x[i], y[i]), with the given \a mode, and renormalises the result
+         * to a maximum of 1 (as does HexGrid::resampleImage). Returns true if the
+         * operator was loaded from \a cachepath.
+         */
+        bool build (const ImageSampler& sampler, const std::vector<float>& x, const std::vector<float>& y,
+                    const ResampleMode mode = ResampleMode::Gaussian, const std::string& cachepath = "")
+        {
+            if (x.size() != y.size()) { throw std::runtime_error ("ResampleOperator::build: x and y differ in size"); }
+            CacheKey key;
+            const std::uint32_t kind = 1;
+            const std::uint32_t m = static_cast<std::uint32_t>(mode);
+            key.add (&kind, sizeof kind);
+            key.add (&m, sizeof m);
+            key.add (&sampler.w, sizeof sampler.w);
+            key.add (&sampler.h, sizeof sampler.h);
+            key.add (sampler.dist_per_pix.data(), sizeof (float) * 2);
+            key.add (sampler.origin.data(), sizeof (float) * 2);
+            key.add (x.data(), x.size() * sizeof (float));
+            key.add (y.data(), y.size() * sizeof (float));
+            if (!cachepath.empty() && this->load (cachepath, key.h)) { return true; }
+
+            this->nrows = x.size();
+            this->ncols = static_cast<size_t>(sampler.w) * sampler.h;
+            this->renormalise = true;
+            this->geometry_key = key.h;
+            this->compile ([&sampler, &x, &y, mode](const int i, auto&& emit) {
+                if (mode == ResampleMode::Bilinear) {
+                    sampler.bilinear_window (x[i], y[i], emit);
+                } else {
+                    sampler.gaussian_window (x[i], y[i], emit);
+                }
+            });
+            if (!cachepath.empty()) { this->save (cachepath); }
+            return false;
+        }
+
+        //! Build the operator for HexGrid::resampleImage (image_w by image_h pixels) on \a hg
+        bool build (const HexGrid& hg, const unsigned int image_w, const unsigned int image_h,
+                    const morph::vec<float, 2>& image_scale, const morph::vec<float, 2>& image_offset,
+                    const ResampleMode mode = ResampleMode::Gaussian, const std::string& cachepath = "")
+        {
+            return this->build (hg.imageSampler (image_w, image_h, image_scale, image_offset), hg.d_x, hg.d_y, mode, cachepath);
+        }
+
+        //! Build the operator for Grid::resample_image (image_w by image_h pixels) on \a g
+        template <typename I, typename C>
+        bool build (const morph::Grid<I, C>& g, const unsigned int image_w, const unsigned int image_h,
+                    const morph::vec<float, 2>& image_scale, const morph::vec<float, 2>& image_offset,
+                    const ResampleMode mode = ResampleMode::Gaussian, const std::string& cachepath = "")
+        {
+            std::vector<float> x (g.v_c.size());
+            std::vector<float> y (g.v_c.size());
+            for (size_t i = 0; i < g.v_c.size(); ++i) {
+                x[i] = static_cast<float>(g.v_c[i][0]);
+                y[i] = static_cast<float>(g.v_c[i][1]);
+            }
+            return this->build (g.image_sampler (image_w, image_h, image_scale, image_offset), x, y, mode, cachepath);
+        }
+
+        /*!
+         * Build the operator for image_grid.resampleToPolar (image_data, cg_polar,
+         * polar_data, view_pos, view_angle, radscale), for data on the rectangular
+         * CartGrid \a image_grid, with the weights of CartGrid::polarWeights. There is no
+         * renormalisation.
+         */
+        bool build_polar (CartGrid& image_grid, CartGrid& cg_polar, const morph::vec<float, 2>& view_pos,
+                          const float view_angle, const morph::ScaleFn radscale = morph::ScaleFn::Linear,
+                          const std::string& cachepath = "")
+        {
+            CacheKey key;
+            const std::uint32_t kind = 2;
+            const std::uint32_t rs = static_cast<std::uint32_t>(radscale);
+            key.add (&kind, sizeof kind);
+            key.add (&rs, sizeof rs);
+            key.add (view_pos.data(), sizeof (float) * 2);
+            key.add (&view_angle, sizeof view_angle);
+            const morph::vec<float, 4> spacing = { image_grid.getd(), image_grid.getv(), cg_polar.getd(), cg_polar.getv() };
+            key.add (spacing.data(), sizeof (float) * 4);
+            key.add (image_grid.d_x.data(), image_grid.d_x.size() * sizeof (float));
+            key.add (image_grid.d_y.data(), image_grid.d_y.size() * sizeof (float));
+            key.add (cg_polar.d_x.data(), cg_polar.d_x.size() * sizeof (float));
+            key.add (cg_polar.d_y.data(), cg_polar.d_y.size() * sizeof (float));
+            if (!cachepath.empty() && this->load (cachepath, key.h)) { return true; }
+
+            // polarWeights visits the output pixels in order, so the rows are filled in turn
+            this->nrows = cg_polar.num();
+            this->ncols = image_grid.num();
+            this->renormalise = false;
+            this->geometry_key = key.h;
+            this->row_start.assign (this->nrows + 1, 0);
+            this->col.clear();
+            this->weight.clear();
+            image_grid.polarWeights (cg_polar, view_pos, view_angle, radscale,
+                                     [this](const unsigned int xi, const unsigned int vi, const float wt) {
+                                         this->row_start[xi + 1] += 1;
+                                         this->col.push_back (vi);
+                                         this->weight.push_back (wt);
+                                     });
+            for (size_t i = 0; i < this->nrows; ++i) { this->row_start[i + 1] += this->row_start[i]; }
+            if (!cachepath.empty()) { this->save (cachepath); }
+            return false;
+        }
+
+        /*!
+         * Resample \a image (which must have cols() pixels) into \a out (which is resized
+         * to rows()). As for HexGrid::resampleImage, if all the image values are the
+         * same, out is set to that value; otherwise it is renormalised so that its
+         * maximum is 1, unless the operator was built by build_polar.
+         */
+        void apply (const morph::vvec<float>& image, morph::vvec<float>& out) const
+        {
+            if (image.size() != this->ncols) {
+                throw std::runtime_error ("ResampleOperator::apply: The image is not the size for which the operator was built");
+            }
+            out.resize (this->nrows);
+            if (this->renormalise && !image.empty()) {
+                const float i0 = image[0];
+                bool all_same = true;
+                for (auto id : image) {
+                    if (id != i0) {
+                        all_same = false;
+                        break;
+                    }
+                }
+                if (all_same) {
+                    out.set_from (i0);
+                    return;
+                }
+            }
+            const int nr = static_cast<int>(this->nrows);
+            const std::uint64_t* rs = this->row_start.data();
+            const std::uint32_t* cp = this->col.data();
+            const float* wp = this->weight.data();
+            const float* ip = image.data();
+#pragma omp parallel for schedule(static)
+            for (int i = 0; i < nr; ++i) {
+                float sum = 0.0f;
+                for (std::uint64_t j = rs[i]; j < rs[i + 1]; ++j) { sum += wp[j] * ip[cp[j]]; }
+                out[i] = sum;
+            }
+            if (this->renormalise) { out /= out.max(); }
+        }
+
+        //! The number of grid elements (rows of the matrix)
+        size_t rows() const { return this->nrows; }
+        //! The number of image pixels (columns of the matrix)
+        size_t cols() const { return this->ncols; }
+        //! The number of (pixel, weight) entries
+        size_t nnz() const { return this->col.size(); }
+        //! The hash of the build parameters which identifies the geometry of the operator
+        std::uint64_t key() const { return this->geometry_key; }
+
+        /*!
+         * The version of the binary file format written by save(). Increment if the
+         * layout changes; load() rejects files of any other version.
+         */
+        static constexpr std::uint32_t file_version = 1;
+
+        //! Save the operator to a binary file at \a path
+        void save (const std::string& path) const
+        {
+            std::ofstream f (path, std::ios::binary | std::ios::trunc);
+            if (!f.is_open()) { throw std::runtime_error ("ResampleOperator::save: Failed to open " + path); }
+            FileHeader hdr;
+            hdr.pre.key = this->geometry_key;
+            hdr.rows = this->nrows;
+            hdr.cols = this->ncols;
+            hdr.nnz = this->col.size();
+            hdr.renormalise = this->renormalise ? 1 : 0;
+            f.write (reinterpret_cast<const char*>(&hdr), sizeof hdr);
+            f.write (reinterpret_cast<const char*>(this->row_start.data()), this->row_start.size() * sizeof (std::uint64_t));
+            f.write (reinterpret_cast<const char*>(this->col.data()), this->col.size() * sizeof (std::uint32_t));
+            f.write (reinterpret_cast<const char*>(this->weight.data()), this->weight.size() * sizeof (float));
+            if (!f.good()) { throw std::runtime_error ("ResampleOperator::save: Failed to write " + path); }
+        }
+
+        /*!
+         * Load an operator saved by save(). Returns false, leaving this operator
+         * unchanged, if the file does not exist, is not a valid operator file of this
+         * version or does not match \a key. If \a key is 0, the key is not checked.
+         */
+        bool load (const std::string& path, const std::uint64_t key = 0)
+        {
+            std::ifstream f (path, std::ios::binary | std::ios::ate);
+            if (!f.is_open()) { return false; }
+            const size_t len = static_cast<size_t>(f.tellg());
+            f.seekg (0);
+            FileHeader hdr;
+            const FileHeader ref;
+            if (len < sizeof hdr) { return false; }
+            f.read (reinterpret_cast<char*>(&hdr), sizeof hdr);
+            if (!hdr.pre.matches (ref.pre, key)) { return false; }
+            if (len != sizeof hdr + (hdr.rows + 1) * sizeof (std::uint64_t) + hdr.nnz * (sizeof (std::uint32_t) + sizeof (float))) {
+                return false;
+            }
+            std::vector<std::uint64_t> rs (hdr.rows + 1);
+            std::vector<std::uint32_t> c (hdr.nnz);
+            std::vector<float> w (hdr.nnz);
+            f.read (reinterpret_cast<char*>(rs.data()), rs.size() * sizeof (std::uint64_t));
+            f.read (reinterpret_cast<char*>(c.data()), c.size() * sizeof (std::uint32_t));
+            f.read (reinterpret_cast<char*>(w.data()), w.size() * sizeof (float));
+            if (!f.good() || rs.back() != hdr.nnz) { return false; }
+
+            this->nrows = hdr.rows;
+            this->ncols = hdr.cols;
+            this->renormalise = hdr.renormalise != 0;
+            this->geometry_key = hdr.pre.key;
+            this->row_start.swap (rs);
+            this->col.swap (c);
+            this->weight.swap (w);
+            return true;
+        }
+
+    private:
+        /*!
+         * Fill the CSR table. rowfn (i, emit) calls emit (pixel, weight) for each entry
+         * of row i. It is called twice for each row: once to count the entries, then to
+         * store them.
+         */
+        template <typename F>
+        void compile (F&& rowfn)
+        {
+            const int nr = static_cast<int>(this->nrows);
+            std::vector<std::uint64_t> counts (this->nrows, 0);
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int i = 0; i < nr; ++i) {
+                std::uint64_t c = 0;
+                rowfn (i, [&c](const unsigned int, const float) { ++c; });
+                counts[i] = c;
+            }
+            this->row_start.resize (this->nrows + 1);
+            this->row_start[0] = 0;
+            for (size_t i = 0; i < this->nrows; ++i) { this->row_start[i + 1] = this->row_start[i] + counts[i]; }
+            this->col.resize (this->row_start[this->nrows]);
+            this->weight.resize (this->row_start[this->nrows]);
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int i = 0; i < nr; ++i) {
+                std::uint64_t j = this->row_start[i];
+                rowfn (i, [this, &j](const unsigned int p, const float wt) {
+                    this->col[j] = p;
+                    this->weight[j] = wt;
+                    ++j;
+                });
+            }
+        }
+
+        //! The fixed size header of a file written by save()
+        struct FileHeader
+        {
+            BinaryCachePreamble pre { "MORPHRSO", file_version };
+            std::uint64_t rows = 0;
+            std::uint64_t cols = 0;
+            std::uint64_t nnz = 0;
+            std::uint32_t renormalise = 0;
+            std::uint32_t pad = 0;
+        };
+
+        size_t nrows = 0;
+        size_t ncols = 0;
+        //! Whether apply() renormalises its result to a maximum of 1
+        bool renormalise = true;
+        std::uint64_t geometry_key = 0;
+        //! Index into col and weight of the first entry for each row (size rows + 1)
+        std::vector<std::uint64_t> row_start;
+        //! The image pixel index of each entry
+        std::vector<std::uint32_t> col;
+        //! The weight of each entry
+        std::vector<float> weight;
+    };
+
+} // namespace morph
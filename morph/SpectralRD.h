@@ -0,0 +1,304 @@
+/*!
+ * \file SpectralRD.h
+ *
+ * A pseudo-spectral solver for reaction diffusion systems on a doubly periodic
+ * morph::Grid, with exponential time differencing.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/FFT.h>
+#include <morph/Grid.h>
+#include <morph/vvec.h>
+#include <morph/mathconst.h>
+#include <array>
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace morph {
+
+    /*!
+     * Solve the reaction diffusion system of N species
+     *
+     *   du_s/dt = D_s Del^2 u_s + R_s (u)
+     *
+     * on a Grid with GridDomainWrap::Both. The diffusion terms are diagonal in Fourier
+     * space, where they are integrated exactly. The reaction terms are evaluated in
+     * real space at each grid element, and integrated with the fourth order exponential
+     * time differencing Runge-Kutta scheme ETDRK4 of Cox and Matthews (J. Comput. Phys.
+     * 176, 2002), with the coefficients computed by contour integrals, as proposed by
+     * Kassam and Trefethen (SIAM J. Sci. Comput. 26, 2005), where they would otherwise
+     * suffer from cancellation.
+     *
+     * The Laplacian is the exact (spectral) one, -(kx^2 + ky^2) in Fourier space, so
+     * the timestep is limited only by the accuracy with which the reaction is
+     * integrated, not by the stability of the diffusion. Each step costs 9N 2D FFTs
+     * and 4 evaluations of the reaction at every element.
+     *
+     * \tparam T The floating point type of the fields
+     * \tparam N The number of species
+     */
+    template <typename T, size_t N>
+    class SpectralRD
+    {
+    public:
+        using cplx = std::complex<T>;
+
+        /*!
+         * Set up for the fields on Grid \a g, which must wrap in both directions, with
+         * diffusion coefficients \a _D and timestep \a _dt.
+         */
+        template <typename I, typename C>
+        SpectralRD (const morph::Grid<I, C>& g, const std::array<T, N>& _D, const T _dt)
+            : nx (SpectralRD<T, N>::fast_n (g)), ny (SpectralRD<T, N>::slow_n (g)), fft (nx, ny), D(_D), dt(_dt)
+        {
+            if (g.get_wrap() != GridDomainWrap::Both) {
+                throw std::runtime_error ("SpectralRD: The Grid must wrap in both directions (GridDomainWrap::Both)");
+            }
+            // The element spacings in the fast (x for row major) and slow directions
+            const T dfast = static_cast<T>(g.rowmaj() ? g.get_dx()[0] : g.get_dx()[1]);
+            const T dslow = static_cast<T>(g.rowmaj() ? g.get_dx()[1] : g.get_dx()[0]);
+            const unsigned int nxh = this->nx / 2 + 1;
+            this->k2.resize (this->fft.spectrum_size());
+            const double twopi = 2.0 * morph::mathconst<double>::pi;
+            for (unsigned int j = 0; j < this->ny; ++j) {
+                const int mj = j <= this->ny / 2 ? static_cast<int>(j) : static_cast<int>(j) - static_cast<int>(this->ny);
+                const double ky = twopi * mj / (this->ny * static_cast<double>(dslow));
+                for (unsigned int i = 0; i < nxh; ++i) {
+                    const double kx = twopi * i / (this->nx * static_cast<double>(dfast));
+                    this->k2[static_cast<size_t>(j) * nxh + i] = kx * kx + ky * ky;
+                }
+            }
+            this->compute_coefficients();
+        }
+
+        //! Set the timestep. This recomputes the ETDRK4 coefficients.
+        void set_dt (const T _dt) { this->dt = _dt; this->compute_coefficients(); }
+        T get_dt() const { return this->dt; }
+
+        //! Set the diffusion coefficients. This recomputes the ETDRK4 coefficients.
+        void set_D (const std::array<T, N>& _D) { this->D = _D; this->compute_coefficients(); }
+        const std::array<T, N>& get_D() const { return this->D; }
+
+        /*!
+         * Advance the fields \a u by one timestep. \a reaction is called, at each grid
+         * element i, as reaction (u, r) or reaction (i, u, r), where u is a
+         * std::array<T, N> of the species' values at i and r is a std::array<T, N>&
+         * into which it writes the reaction terms; as for
+         * RD_Base::reaction_diffusion. It is called from OpenMP threads.
+         */
+        template <typename R>
+        void step (const std::array<morph::vvec<T>*, N>& u, R&& reaction)
+        {
+            const size_t nel = static_cast<size_t>(this->nx) * this->ny;
+            for (size_t s = 0; s < N; ++s) {
+                if (u[s]->size() != nel) {
+                    throw std::runtime_error ("SpectralRD::step: A field is not the size of the grid");
+                }
+            }
+            const size_t nsp = this->fft.spectrum_size();
+            for (auto* bufs : { &this->v, &this->nv, &this->na, &this->nb, &this->nc, &this->sa, &this->sb }) {
+                for (size_t s = 0; s < N; ++s) { (*bufs)[s].resize (nsp); }
+            }
+            const int nk = static_cast<int>(nsp);
+
+            for (size_t s = 0; s < N; ++s) { this->fft.forward (*u[s], this->v[s]); }
+            this->react (u, reaction, this->nv);
+
+            // a = E2 v + Q N(v)
+            for (size_t s = 0; s < N; ++s) {
+                const cplx* vs = this->v[s].data();
+                const cplx* nvs = this->nv[s].data();
+                const T* e2 = this->E2[s].data();
+                const T* q = this->Q[s].data();
+                cplx* as = this->sa[s].data();
+#pragma omp parallel for schedule(static)
+                for (int k = 0; k < nk; ++k) { as[k] = e2[k] * vs[k] + q[k] * nvs[k]; }
+            }
+            this->react_spectral (this->sa, reaction, this->na);
+
+            // b = E2 v + Q N(a)
+            for (size_t s = 0; s < N; ++s) {
+                const cplx* vs = this->v[s].data();
+                const cplx* nas = this->na[s].data();
+                const T* e2 = this->E2[s].data();
+                const T* q = this->Q[s].data();
+                cplx* bs = this->sb[s].data();
+#pragma omp parallel for schedule(static)
+                for (int k = 0; k < nk; ++k) { bs[k] = e2[k] * vs[k] + q[k] * nas[k]; }
+            }
+            this->react_spectral (this->sb, reaction, this->nb);
+
+            // c = E2 a + Q (2 N(b) - N(v)), which overwrites b
+            for (size_t s = 0; s < N; ++s) {
+                const cplx* as = this->sa[s].data();
+                const cplx* nbs = this->nb[s].data();
+                const cplx* nvs = this->nv[s].data();
+                const T* e2 = this->E2[s].data();
+                const T* q = this->Q[s].data();
+                cplx* cs = this->sb[s].data();
+#pragma omp parallel for schedule(static)
+                for (int k = 0; k < nk; ++k) { cs[k] = e2[k] * as[k] + q[k] * (T{2} * nbs[k] - nvs[k]); }
+            }
+            this->react_spectral (this->sb, reaction, this->nc);
+
+            // v = E v + f1 N(v) + 2 f2 (N(a) + N(b)) + f3 N(c)
+            for (size_t s = 0; s < N; ++s) {
+                cplx* vs = this->v[s].data();
+                const cplx* nvs = this->nv[s].data();
+                const cplx* nas = this->na[s].data();
+                const cplx* nbs = this->nb[s].data();
+                const cplx* ncs = this->nc[s].data();
+                const T* e = this->E[s].data();
+                const T* g1 = this->f1[s].data();
+                const T* g2 = this->f2[s].data();
+                const T* g3 = this->f3[s].data();
+#pragma omp parallel for schedule(static)
+                for (int k = 0; k < nk; ++k) {
+                    vs[k] = e[k] * vs[k] + g1[k] * nvs[k] + T{2} * g2[k] * (nas[k] + nbs[k]) + g3[k] * ncs[k];
+                }
+                this->fft.inverse (this->v[s], *u[s]);
+            }
+        }
+
+        //! The spectral Laplacian of u
+        void laplacian (const morph::vvec<T>& u, morph::vvec<T>& lap)
+        {
+            std::vector<cplx> spec;
+            this->fft.forward (u, spec);
+            for (size_t k = 0; k < spec.size(); ++k) { spec[k] *= -static_cast<T>(this->k2[k]); }
+            this->fft.inverse (spec, lap);
+        }
+
+        const FFT2<T>& get_fft() const { return this->fft; }
+
+    private:
+        //! The number of elements in the fast (contiguous) direction of g
+        template <typename I, typename C>
+        static unsigned int fast_n (const morph::Grid<I, C>& g)
+        {
+            return static_cast<unsigned int>(g.rowmaj() ? g.get_w() : g.get_h());
+        }
+        //! The number of elements in the slow direction of g
+        template <typename I, typename C>
+        static unsigned int slow_n (const morph::Grid<I, C>& g)
+        {
+            return static_cast<unsigned int>(g.rowmaj() ? g.get_h() : g.get_w());
+        }
+
+        //! Evaluate the reaction on the real fields x and transform it into ns
+        template <typename X, typename R>
+        void react (const std::array<X*, N>& x, R& reaction, std::array<std::vector<cplx>, N>& ns)
+        {
+            for (size_t s = 0; s < N; ++s) { this->rbuf[s].resize (x[s]->size()); }
+            const int nel = static_cast<int>(x[0]->size());
+#pragma omp parallel for schedule(static)
+            for (int i = 0; i < nel; ++i) {
+                std::array<T, N> uu;
+                std::array<T, N> rr;
+                for (size_t s = 0; s < N; ++s) { uu[s] = (*x[s])[i]; }
+                if constexpr (std::is_invocable_v<R&, const int, const std::array<T, N>&, std::array<T, N>&>) {
+                    reaction (i, uu, rr);
+                } else {
+                    reaction (uu, rr);
+                }
+                for (size_t s = 0; s < N; ++s) { this->rbuf[s][i] = rr[s]; }
+            }
+            for (size_t s = 0; s < N; ++s) { this->fft.forward (this->rbuf[s], ns[s]); }
+        }
+
+        //! Transform the spectra st to real space, then evaluate and transform the reaction
+        template <typename R>
+        void react_spectral (const std::array<std::vector<cplx>, N>& st, R& reaction, std::array<std::vector<cplx>, N>& ns)
+        {
+            std::array<morph::vvec<T>*, N> x;
+            for (size_t s = 0; s < N; ++s) {
+                this->tmp = st[s]; // inverse overwrites its input
+                this->fft.inverse (this->tmp, this->xbuf[s]);
+                x[s] = &this->xbuf[s];
+            }
+            this->react (x, reaction, ns);
+        }
+
+        /*!
+         * Compute E = exp (z), E2 = exp (z/2) and the ETDRK4 coefficients Q, f1, f2 and
+         * f3 for z = dt L, L = -D k^2, at each wavenumber. Where |z| < 1, the
+         * coefficients are the means of their values on a circle of radius 1 around z
+         * in the complex plane (they are analytic), which avoids the cancellation in
+         * their direct formulae.
+         */
+        void compute_coefficients()
+        {
+            const size_t nsp = this->k2.size();
+            const double h = static_cast<double>(this->dt);
+            constexpr int M = 32;
+            std::array<std::complex<double>, M> r;
+            for (int j = 0; j < M; ++j) {
+                r[j] = std::exp (std::complex<double>(0.0, morph::mathconst<double>::pi * (j + 0.5) / M));
+            }
+            for (size_t s = 0; s < N; ++s) {
+                for (auto* c : { &this->E[s], &this->E2[s], &this->Q[s], &this->f1[s], &this->f2[s], &this->f3[s] }) {
+                    c->resize (nsp);
+                }
+                const double Ds = static_cast<double>(this->D[s]);
+#pragma omp parallel for schedule(static)
+                for (int k = 0; k < static_cast<int>(nsp); ++k) {
+                    const double z = -h * Ds * this->k2[k];
+                    double q = 0.0, g1 = 0.0, g2 = 0.0, g3 = 0.0;
+                    if (std::abs (z) >= 1.0) {
+                        const double ez = std::exp (z);
+                        const double z3 = z * z * z;
+                        q = (std::exp (z / 2.0) - 1.0) / z;
+                        g1 = (-4.0 - z + ez * (4.0 - 3.0 * z + z * z)) / z3;
+                        g2 = (2.0 + z + ez * (z - 2.0)) / z3;
+                        g3 = (-4.0 - 3.0 * z - z * z + ez * (4.0 - z)) / z3;
+                    } else {
+                        // The points are in the upper half plane; the real parts of the
+                        // functions are symmetric about the real axis
+                        for (int j = 0; j < M; ++j) {
+                            const std::complex<double> zc = z + r[j];
+                            const std::complex<double> ez = std::exp (zc);
+                            const std::complex<double> z3 = zc * zc * zc;
+                            q += ((std::exp (zc / 2.0) - 1.0) / zc).real();
+                            g1 += ((-4.0 - zc + ez * (4.0 - 3.0 * zc + zc * zc)) / z3).real();
+                            g2 += ((2.0 + zc + ez * (zc - 2.0)) / z3).real();
+                            g3 += ((-4.0 - 3.0 * zc - zc * zc + ez * (4.0 - zc)) / z3).real();
+                        }
+                        q /= M;
+                        g1 /= M;
+                        g2 /= M;
+                        g3 /= M;
+                    }
+                    this->E[s][k] = static_cast<T>(std::exp (z));
+                    this->E2[s][k] = static_cast<T>(std::exp (z / 2.0));
+                    this->Q[s][k] = static_cast<T>(h * q);
+                    this->f1[s][k] = static_cast<T>(h * g1);
+                    this->f2[s][k] = static_cast<T>(h * g2);
+                    this->f3[s][k] = static_cast<T>(h * g3);
+                }
+            }
+        }
+
+        //! The grid dimensions: fast (contiguous) and slow directions
+        unsigned int nx = 1;
+        unsigned int ny = 1;
+        FFT2<T> fft;
+        std::array<T, N> D;
+        T dt;
+        //! kx^2 + ky^2 for each element of the half spectrum
+        std::vector<double> k2;
+        //! The ETDRK4 coefficients for each species, over the half spectrum
+        std::array<std::vector<T>, N> E, E2, Q, f1, f2, f3;
+        //! Spectra of the state (v), the stages (sa, sb) and the reaction at each stage
+        std::array<std::vector<cplx>, N> v, nv, na, nb, nc, sa, sb;
+        //! Real space buffers for the stage states and the reaction terms
+        std::array<morph::vvec<T>, N> xbuf, rbuf;
+        std::vector<cplx> tmp;
+    };
+
+} // namespace morph
@@ -0,0 +1,385 @@
+/*!
+ * \file SummedAreaTable.h
+ *
+ * A summed area table (integral image) of rectangular Grid or CartGrid data, which
+ * gives the sum, mean or variance of any rectangle of the data in constant time.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <morph/Grid.h>
+#include <morph/CartGrid.h>
+#include <vector>
+#include <array>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace morph {
+
+    /*!
+     * Entry (x, y) of a summed area table holds the sum of the data in the rectangle
+     * from (0, 0) to (x, y). The sum over any rectangle is then found from the four
+     * entries at its corners, so box filters of any size cost the same. The table may
+     * also hold the sums of the squared data, from which the variance over a rectangle
+     * is found in the same way.
+     *
+     * The data are a row-major raster of width w, with element (x, y) at index y * w +
+     * x (as for a Grid in bottomleft_to_topright or topleft_to_bottomright order, and a
+     * rectangular CartGrid). Rectangles are given as inclusive ranges of element
+     * indices. In a direction in which the data wrap, a range may extend beyond the
+     * edge and is wrapped around; otherwise the part of it beyond the edge is ignored.
+     *
+     * The table is built with a row-wise pass, then a column-wise pass, each in an
+     * OpenMP parallel loop.
+     *
+     * \tparam T The type of the data
+     *
+     * \tparam A The type of the table, and of the sums. Single precision floats lose
+     * precision in the large sums of the table, so this defaults to double.
+     */
+    template <typename T, typename A = double>
+    class SummedAreaTable
+    {
+    public:
+        SummedAreaTable() {}
+
+        //! Construct the table for \a data of width \a w (see compute)
+        SummedAreaTable (const std::vector<T>& data, const int w, const bool with_squares = false,
+                         const bool wrap_x = false, const bool wrap_y = false)
+        {
+            this->compute (data, w, with_squares, wrap_x, wrap_y);
+        }
+
+        //! Construct the table for \a data on the Grid \a g (see compute)
+        template <typename I, typename C>
+        SummedAreaTable (const morph::Grid<I, C>& g, const std::vector<T>& data, const bool with_squares = false)
+        {
+            this->compute (g, data, with_squares);
+        }
+
+        //! Construct the table for \a data on the CartGrid \a cg (see compute)
+        SummedAreaTable (const morph::CartGrid& cg, const std::vector<T>& data, const bool with_squares = false)
+        {
+            this->compute (cg, data, with_squares);
+        }
+
+        /*!
+         * Compute the table for \a data, a raster of width \a w. If \a with_squares,
+         * also compute the table of squared data, which variance() requires. \a wrap_x
+         * and \a wrap_y say whether the data wrap horizontally and vertically.
+         */
+        void compute (const std::vector<T>& data, const int w, const bool with_squares = false,
+                      const bool wrap_x = false, const bool wrap_y = false)
+        {
+            if (w < 1 || data.size() % w != 0) {
+                throw std::runtime_error ("SummedAreaTable: The data size is not a multiple of the width.");
+            }
+            this->w = w;
+            this->h = static_cast<int>(data.size() / w);
+            this->wrap_x = wrap_x;
+            this->wrap_y = wrap_y;
+            SummedAreaTable<T, A>::integrate (data, this->w, this->h, false, this->table);
+            if (with_squares) {
+                SummedAreaTable<T, A>::integrate (data, this->w, this->h, true, this->table_sq);
+            } else {
+                this->table_sq.clear();
+            }
+        }
+
+        //! Compute the table for \a data on the Grid \a g, which must be row-major. Wrapping is that of \a g.
+        template <typename I, typename C>
+        void compute (const morph::Grid<I, C>& g, const std::vector<T>& data, const bool with_squares = false)
+        {
+            if (!g.rowmaj()) {
+                throw std::runtime_error ("SummedAreaTable: The Grid must be row-major.");
+            }
+            if (data.size() != static_cast<size_t>(g.n)) {
+                throw std::runtime_error ("SummedAreaTable: The data vector is not the same size as the Grid.");
+            }
+            const GridDomainWrap wr = g.get_wrap();
+            this->compute (data, static_cast<int>(g.get_w()), with_squares,
+                           wr == GridDomainWrap::Horizontal || wr == GridDomainWrap::Both,
+                           wr == GridDomainWrap::Vertical || wr == GridDomainWrap::Both);
+        }
+
+        /*!
+         * Compute the table for \a data on the CartGrid \a cg, which must be
+         * rectangular. The table wraps horizontally if \a cg does (CartGrid does not
+         * implement vertical wrapping).
+         */
+        void compute (const morph::CartGrid& cg, const std::vector<T>& data, const bool with_squares = false)
+        {
+            if (cg.domainShape != GridDomainShape::Rectangle || cg.w_px < 1
+                || static_cast<size_t>(cg.w_px) * cg.h_px != cg.num()) {
+                throw std::runtime_error ("SummedAreaTable: This method requires a rectangular CartGrid.");
+            }
+            if (data.size() != cg.num()) {
+                throw std::runtime_error ("SummedAreaTable: The data vector is not the same size as the CartGrid.");
+            }
+            this->compute (data, cg.w_px, with_squares,
+                           cg.domainWrap == GridDomainWrap::Horizontal || cg.domainWrap == GridDomainWrap::Both, false);
+        }
+
+        //! The sum of the data in columns x0 to x1 and rows y0 to y1 (inclusive)
+        A sum (const int x0, const int y0, const int x1, const int y1) const
+        {
+            return this->rectsum (this->table, x0, y0, x1, y1);
+        }
+
+        //! The sum of the squared data in columns x0 to x1 and rows y0 to y1 (inclusive)
+        A sum_squares (const int x0, const int y0, const int x1, const int y1) const
+        {
+            if (this->table_sq.empty()) {
+                throw std::runtime_error ("SummedAreaTable: The table of squares was not computed.");
+            }
+            return this->rectsum (this->table_sq, x0, y0, x1, y1);
+        }
+
+        //! The number of elements of the data in columns x0 to x1 and rows y0 to y1
+        int count (const int x0, const int y0, const int x1, const int y1) const
+        {
+            std::array<int, 4> xr = {};
+            std::array<int, 4> yr = {};
+            const int nx = SummedAreaTable<T, A>::intervals (x0, x1, this->w, this->wrap_x, xr);
+            const int ny = SummedAreaTable<T, A>::intervals (y0, y1, this->h, this->wrap_y, yr);
+            int cx = 0;
+            int cy = 0;
+            for (int i = 0; i < nx; ++i) { cx += xr[2 * i + 1] - xr[2 * i] + 1; }
+            for (int j = 0; j < ny; ++j) { cy += yr[2 * j + 1] - yr[2 * j] + 1; }
+            return cx * cy;
+        }
+
+        //! The mean of the data in columns x0 to x1 and rows y0 to y1 (0 if there are none)
+        A mean (const int x0, const int y0, const int x1, const int y1) const
+        {
+            const int c = this->count (x0, y0, x1, y1);
+            return c > 0 ? this->sum (x0, y0, x1, y1) / static_cast<A>(c) : A{0};
+        }
+
+        //! The (population) variance of the data in columns x0 to x1 and rows y0 to y1
+        A variance (const int x0, const int y0, const int x1, const int y1) const
+        {
+            const int c = this->count (x0, y0, x1, y1);
+            if (c == 0) { return A{0}; }
+            const A m = this->sum (x0, y0, x1, y1) / static_cast<A>(c);
+            const A v = this->sum_squares (x0, y0, x1, y1) / static_cast<A>(c) - m * m;
+            return v > A{0} ? v : A{0}; // v can be a rounding error below 0
+        }
+
+        /*!
+         * Apply a box filter of side \a boxside, of any size, to the data. As in
+         * CartGrid::boxfilter, the box about an element extends (boxside-1)/2 elements
+         * on either side if boxside is odd, and one element further right and up than
+         * left and down if it is even. As in CartGrid::boxfilter and
+         * MathAlgo::boxfilter_2d, the sum is divided by the box area (boxside squared),
+         * not by the number of elements of the box within the data.
+         */
+        void boxfilter (std::vector<T>& result, const int boxside, const bool onlysum = false) const
+        {
+            const A oneover_boxa = A{1} / (static_cast<A>(boxside) * static_cast<A>(boxside));
+            result.resize (static_cast<size_t>(this->w) * this->h);
+            this->boxsums<false> (boxside, [&result, oneover_boxa, onlysum](const int i, const A s, const A, const int) {
+                result[i] = static_cast<T>(onlysum ? s : s * oneover_boxa);
+            });
+        }
+
+        /*!
+         * Local contrast normalisation. Each element of the data is replaced by its
+         * difference from the mean of the box of side \a boxside about it (placed as in
+         * boxfilter and clipped to the data), divided by sqrt(variance + epsilon) in the
+         * box. Where the denominator is 0, the result is 0. Requires the table of
+         * squares.
+         */
+        void contrast_normalise (std::vector<T>& result, const int boxside, const A epsilon = A{0}) const
+        {
+            if (this->table_sq.empty()) {
+                throw std::runtime_error ("SummedAreaTable: The table of squares was not computed.");
+            }
+            result.resize (static_cast<size_t>(this->w) * this->h);
+            this->boxsums<true> (boxside, [this, &result, epsilon](const int i, const A s, const A s2, const int c) {
+                const A m = s / static_cast<A>(c);
+                const A v = s2 / static_cast<A>(c) - m * m;
+                const A sd = std::sqrt ((v > A{0} ? v : A{0}) + epsilon);
+                const int x = i % this->w;
+                const int y = i / this->w;
+                const A d = this->rectsum (this->table, x, y, x, y) - m;
+                result[i] = sd > A{0} ? static_cast<T>(d / sd) : T{0};
+            });
+        }
+
+        //! The width of the data
+        int width() const { return this->w; }
+        //! The height of the data
+        int height() const { return this->h; }
+        //! Whether the table of squares was computed
+        bool has_squares() const { return !this->table_sq.empty(); }
+
+    private:
+        /*!
+         * Fill \a t, of size (w+1) * (h+1), with the summed area table of \a data (or of
+         * its squares). Row 0 and column 0 are zero, so that t[(y+1)*(w+1) + x+1] is the
+         * sum from (0, 0) to (x, y).
+         */
+        static void integrate (const std::vector<T>& data, const int w, const int h, const bool squares, std::vector<A>& t)
+        {
+            const int tw = w + 1;
+            t.assign (static_cast<size_t>(tw) * (h + 1), A{0});
+            // Cumulative sums along each row
+#pragma omp parallel for
+            for (int y = 0; y < h; ++y) {
+                const T* drow = data.data() + static_cast<size_t>(y) * w;
+                A* trow = t.data() + static_cast<size_t>(y + 1) * tw;
+                A run = A{0};
+                for (int x = 0; x < w; ++x) {
+                    const A d = static_cast<A>(drow[x]);
+                    run += squares ? d * d : d;
+                    trow[x + 1] = run;
+                }
+            }
+            // Cumulative sums down each column. Each thread takes a block of columns and
+            // works along the rows, so that memory is accessed contiguously.
+            constexpr int colblock = 256;
+            const int nblocks = (tw + colblock - 1) / colblock;
+#pragma omp parallel for
+            for (int b = 0; b < nblocks; ++b) {
+                const int c0 = b * colblock;
+                const int c1 = std::min (tw, c0 + colblock);
+                for (int y = 1; y <= h; ++y) {
+                    A* trow = t.data() + static_cast<size_t>(y) * tw;
+                    const A* prev = trow - tw;
+                    for (int c = c0; c < c1; ++c) { trow[c] += prev[c]; }
+                }
+            }
+        }
+
+        /*!
+         * For each element i of the data, call f (i, s, s2, c) with the sum s, the sum
+         * of squares s2 (if \a squares) and the number c of the elements of the data in
+         * the box of side \a boxside about it. The box is placed as in boxfilter.
+         */
+        template <bool squares, typename F>
+        void boxsums (const int boxside, F&& f) const
+        {
+            if (boxside < 1) { throw std::runtime_error ("SummedAreaTable: boxside must be at least 1."); }
+            const int neg = boxside % 2 == 0 ? boxside / 2 - 1 : (boxside - 1) / 2;
+            const int pos = boxside % 2 == 0 ? boxside / 2 : (boxside - 1) / 2;
+            const int tw = this->w + 1;
+#pragma omp parallel for
+            for (int y = 0; y < this->h; ++y) {
+                // The interior elements, whose boxes need neither wrapping nor clipping in
+                // x, are found from the table directly
+                int xa = this->w;
+                int xb = this->w;
+                int ya = 0;
+                int yb = 0;
+                if (this->rowspan (y - neg, y + pos, ya, yb)) {
+                    xa = std::min (neg, this->w);
+                    xb = std::max (xa, this->w - pos);
+                    const int c = (yb - ya + 1) * boxside;
+                    const size_t top = static_cast<size_t>(yb + 1) * tw;
+                    const size_t bot = static_cast<size_t>(ya) * tw;
+                    const A* t = this->table.data();
+                    const A* tsq = this->table_sq.data();
+                    for (int x = xa; x < xb; ++x) {
+                        const size_t r = x + pos + 1;
+                        const size_t l = x - neg;
+                        const A s = t[top + r] - t[top + l] - t[bot + r] + t[bot + l];
+                        A s2 = A{0};
+                        if constexpr (squares) { s2 = tsq[top + r] - tsq[top + l] - tsq[bot + r] + tsq[bot + l]; }
+                        f (y * this->w + x, s, s2, c);
+                    }
+                }
+                for (int x = 0; x < this->w; ++x) {
+                    if (x == xa) { x = xb; }
+                    if (x >= this->w) { break; }
+                    const A s = this->rectsum (this->table, x - neg, y - neg, x + pos, y + pos);
+                    A s2 = A{0};
+                    if constexpr (squares) { s2 = this->rectsum (this->table_sq, x - neg, y - neg, x + pos, y + pos); }
+                    f (y * this->w + x, s, s2, this->count (x - neg, y - neg, x + pos, y + pos));
+                }
+            }
+        }
+
+        /*!
+         * Clip the inclusive range of rows y0 to y1 into ya to yb and return true, or
+         * return false if the range wraps.
+         */
+        bool rowspan (const int y0, const int y1, int& ya, int& yb) const
+        {
+            if (this->wrap_y && (y0 < 0 || y1 >= this->h)) { return false; }
+            ya = std::max (y0, 0);
+            yb = std::min (y1, this->h - 1);
+            return ya <= yb;
+        }
+
+        /*!
+         * Split the inclusive range a0 to a1 into (up to 2) inclusive intervals within 0
+         * to n-1, wrapping if \a wrap and clipping otherwise. The intervals are written
+         * as pairs into \a r and their number is returned.
+         */
+        static int intervals (int a0, int a1, const int n, const bool wrap, std::array<int, 4>& r)
+        {
+            if (a1 < a0) { return 0; }
+            if (!wrap) {
+                a0 = std::max (a0, 0);
+                a1 = std::min (a1, n - 1);
+                if (a1 < a0) { return 0; }
+                r[0] = a0;
+                r[1] = a1;
+                return 1;
+            }
+            if (a1 - a0 + 1 >= n) {
+                r[0] = 0;
+                r[1] = n - 1;
+                return 1;
+            }
+            a0 = ((a0 % n) + n) % n;
+            a1 = ((a1 % n) + n) % n;
+            if (a0 <= a1) {
+                r[0] = a0;
+                r[1] = a1;
+                return 1;
+            }
+            r[0] = a0;
+            r[1] = n - 1;
+            r[2] = 0;
+            r[3] = a1;
+            return 2;
+        }
+
+        //! The sum, from table \a t, over the (wrapped or clipped) rectangle
+        A rectsum (const std::vector<A>& t, const int x0, const int y0, const int x1, const int y1) const
+        {
+            std::array<int, 4> xr = {};
+            std::array<int, 4> yr = {};
+            const int nx = SummedAreaTable<T, A>::intervals (x0, x1, this->w, this->wrap_x, xr);
+            const int ny = SummedAreaTable<T, A>::intervals (y0, y1, this->h, this->wrap_y, yr);
+            const int tw = this->w + 1;
+            A s = A{0};
+            for (int j = 0; j < ny; ++j) {
+                const A* top = t.data() + static_cast<size_t>(yr[2 * j + 1] + 1) * tw;
+                const A* bot = t.data() + static_cast<size_t>(yr[2 * j]) * tw;
+                for (int i = 0; i < nx; ++i) {
+                    const int l = xr[2 * i];
+                    const int r = xr[2 * i + 1] + 1;
+                    s += top[r] - top[l] - bot[r] + bot[l];
+                }
+            }
+            return s;
+        }
+
+        //! The width and height of the data
+        int w = 0;
+        int h = 0;
+        //! Whether the data wrap horizontally and vertically
+        bool wrap_x = false;
+        bool wrap_y = false;
+        //! The summed area table, of size (w+1) * (h+1)
+        std::vector<A> table;
+        //! The summed area table of the squared data (empty unless computed)
+        std::vector<A> table_sq;
+    };
+
+} // namespace morph
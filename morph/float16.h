@@ -0,0 +1,236 @@
+/*!
+ * \file float16.h
+ *
+ * 16 bit floating point storage types: morph::float16 (IEEE 754 binary16) and
+ * morph::bfloat16 (the top half of an IEEE 754 binary32). These are for storing large
+ * arrays in half the memory; arithmetic is carried out in float.
+ *
+ * \date 2024
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#ifdef __F16C__
+# include <immintrin.h>
+#endif
+
+namespace morph {
+
+    namespace fp16 {
+        //! The bits of the float f
+        inline std::uint32_t bits_of (const float f)
+        {
+            std::uint32_t u;
+            std::memcpy (&u, &f, sizeof (u));
+            return u;
+        }
+        //! The float with bits u
+        inline float float_of (const std::uint32_t u)
+        {
+            float f;
+            std::memcpy (&f, &u, sizeof (f));
+            return f;
+        }
+    }
+
+    /*!
+     * An IEEE 754 half precision (binary16) number: 1 sign bit, 5 exponent bits and 10
+     * mantissa bits. It holds about 3 significant figures, with a range of about 6e-8
+     * (subnormal) to 65504.
+     *
+     * Conversion to float is implicit, because it is exact. Conversion from float
+     * rounds, so it is explicit; it rounds to nearest, ties to even. Where the F16C
+     * instructions are available (compile with -mf16c or -march=native on x86) they are
+     * used; otherwise the conversion is done with integer operations.
+     */
+    struct float16
+    {
+        std::uint16_t bits = 0;
+
+        float16() = default;
+        //! Round f to the nearest float16
+        explicit float16 (const float f) : bits (float16::encode (f)) {}
+        //! The float16 with the bit pattern b
+        static float16 from_bits (const std::uint16_t b) { float16 h; h.bits = b; return h; }
+
+        operator float() const { return float16::decode (this->bits); }
+
+        //! The float16 bits nearest to f
+        static std::uint16_t encode (const float f)
+        {
+#ifdef __F16C__
+            return static_cast<std::uint16_t>(_cvtss_sh (f, _MM_FROUND_TO_NEAREST_INT));
+#else
+            return float16::encode_portable (f);
+#endif
+        }
+
+        //! The float with the value of the float16 bits b
+        static float decode (const std::uint16_t b)
+        {
+#ifdef __F16C__
+            return _cvtsh_ss (b);
+#else
+            return float16::decode_portable (b);
+#endif
+        }
+
+        //! encode, without the F16C instructions
+        static std::uint16_t encode_portable (const float f)
+        {
+            const std::uint32_t x = fp16::bits_of (f);
+            const std::uint32_t sign = (x >> 16) & 0x8000u;
+            const std::uint32_t ax = x & 0x7fffffffu;
+            if (ax >= 0x7f800000u) {
+                // Infinity, or NaN (which stays a quiet NaN)
+                return static_cast<std::uint16_t>(sign | 0x7c00u | (ax > 0x7f800000u ? 0x200u | ((ax >> 13) & 0x3ffu) : 0u));
+            }
+            // 65520 and above round to infinity
+            if (ax >= 0x477ff000u) { return static_cast<std::uint16_t>(sign | 0x7c00u); }
+            if (ax >= 0x38800000u) {
+                // A normal float16. Rebias the exponent from 127 to 15 and round off 13
+                // mantissa bits; a carry out of the mantissa correctly increments the
+                // exponent.
+                const std::uint32_t v = ax - (112u << 23);
+                return static_cast<std::uint16_t>(sign | ((v + 0xfffu + ((v >> 13) & 1u)) >> 13));
+            }
+            // Zero, or a subnormal float16, in units of 2^-24. 2^-25 and below (a tie, to
+            // the even 0) round to 0.
+            if (ax <= 0x33000000u) { return static_cast<std::uint16_t>(sign); }
+            const std::uint32_t shift = 126u - (ax >> 23);
+            const std::uint32_t m = (ax & 0x7fffffu) | 0x800000u;
+            std::uint32_t q = m >> shift;
+            const std::uint32_t rem = m & ((1u << shift) - 1u);
+            const std::uint32_t halfway = 1u << (shift - 1u);
+            if (rem > halfway || (rem == halfway && (q & 1u))) { ++q; }
+            return static_cast<std::uint16_t>(sign | q);
+        }
+
+        //! decode, without the F16C instructions
+        static float decode_portable (const std::uint16_t b)
+        {
+            const std::uint32_t sign = static_cast<std::uint32_t>(b & 0x8000u) << 16;
+            const std::uint32_t e = (b >> 10) & 0x1fu;
+            const std::uint32_t m = b & 0x3ffu;
+            if (e == 0x1fu) { return fp16::float_of (sign | 0x7f800000u | (m << 13)); }
+            if (e == 0u) {
+                // Zero or subnormal: m * 2^-24, which is exact in float
+                const float v = static_cast<float>(m) * fp16::float_of (0x33800000u);
+                return fp16::float_of (sign | fp16::bits_of (v));
+            }
+            return fp16::float_of (sign | ((e + 112u) << 23) | (m << 13));
+        }
+    };
+
+    /*!
+     * A bfloat16 ("brain float") number: the top 16 bits of a float, so 1 sign bit, 8
+     * exponent bits and 7 mantissa bits. It has the range of a float, but only 2 to 3
+     * significant figures. As for float16, conversion from float is explicit and rounds
+     * to nearest, ties to even.
+     */
+    struct bfloat16
+    {
+        std::uint16_t bits = 0;
+
+        bfloat16() = default;
+        //! Round f to the nearest bfloat16
+        explicit bfloat16 (const float f) : bits (bfloat16::encode (f)) {}
+        //! The bfloat16 with the bit pattern b
+        static bfloat16 from_bits (const std::uint16_t b) { bfloat16 h; h.bits = b; return h; }
+
+        operator float() const { return bfloat16::decode (this->bits); }
+
+        //! The bfloat16 bits nearest to f
+        static std::uint16_t encode (const float f)
+        {
+            const std::uint32_t x = fp16::bits_of (f);
+            // A NaN must not round to infinity; keep it a quiet NaN
+            if ((x & 0x7fffffffu) > 0x7f800000u) { return static_cast<std::uint16_t>((x >> 16) | 0x40u); }
+            return static_cast<std::uint16_t>((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+        }
+
+        //! The float with the value of the bfloat16 bits b
+        static float decode (const std::uint16_t b)
+        {
+            return fp16::float_of (static_cast<std::uint32_t>(b) << 16);
+        }
+    };
+
+    //! True for the 16 bit floating point types, float16 and bfloat16
+    template <typename T>
+    struct is_float16 : std::integral_constant<bool, std::is_same<std::decay_t<T>, float16>::value
+                                               || std::is_same<std::decay_t<T>, bfloat16>::value> {};
+
+    /*!
+     * Round f to H (float16 or bfloat16) stochastically: f lies between two adjacent
+     * values of H, and it is rounded to each of them with a probability in proportion to
+     * its nearness. The result is then equal to f on average, so that small increments,
+     * which would be lost by rounding to nearest, accumulate correctly over many
+     * roundings. \a r is a uniformly distributed random number, of which the top 24 bits
+     * are used.
+     */
+    template <typename H>
+    H stochastic_round (const float f, const std::uint32_t r)
+    {
+        static_assert (is_float16<H>::value, "stochastic_round is for float16 or bfloat16");
+        const H near (f);
+        const float fn = static_cast<float>(near);
+        const std::uint16_t inf_bits = std::is_same<H, float16>::value ? 0x7c00u : 0x7f80u;
+        // Exact, infinite or NaN
+        if (fn == f || (near.bits & 0x7fffu) >= inf_bits) { return near; }
+        // The value of H next to near, on the far side of f
+        std::uint16_t ob = 0;
+        if ((near.bits & 0x7fffu) == 0u) {
+            ob = f > fn ? 0x0001u : 0x8001u;
+        } else {
+            const bool neg = (near.bits & 0x8000u) != 0u;
+            ob = static_cast<std::uint16_t>((f > fn) != neg ? near.bits + 1u : near.bits - 1u);
+        }
+        const H other = H::from_bits (ob);
+        const float fo = static_cast<float>(other);
+        // The probability of rounding to other is |f - fn| / |fo - fn|, which is < 1/2
+        const float p = (f - fn) / (fo - fn);
+        return static_cast<float>(r >> 8) * fp16::float_of (0x33800000u) < p ? other : near;
+    }
+
+    /*!
+     * Convert n values of a 16 bit float type to float. For float16 with the F16C
+     * instructions, this converts 8 values per instruction.
+     */
+    template <typename H>
+    void convert (const H* src, float* dst, const std::size_t n)
+    {
+        static_assert (is_float16<H>::value, "convert is for float16 or bfloat16");
+        std::size_t i = 0;
+#ifdef __F16C__
+        if constexpr (std::is_same<H, float16>::value) {
+            for (; i + 8 <= n; i += 8) {
+                const __m128i h = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(src + i));
+                _mm256_storeu_ps (dst + i, _mm256_cvtph_ps (h));
+            }
+        }
+#endif
+        for (; i < n; ++i) { dst[i] = static_cast<float>(src[i]); }
+    }
+
+    //! Convert n floats to a 16 bit float type, rounding to nearest
+    template <typename H>
+    void convert (const float* src, H* dst, const std::size_t n)
+    {
+        static_assert (is_float16<H>::value, "convert is for float16 or bfloat16");
+        std::size_t i = 0;
+#ifdef __F16C__
+        if constexpr (std::is_same<H, float16>::value) {
+            for (; i + 8 <= n; i += 8) {
+                const __m128i h = _mm256_cvtps_ph (_mm256_loadu_ps (src + i), _MM_FROUND_TO_NEAREST_INT);
+                _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst + i), h);
+            }
+        }
+#endif
+        for (; i < n; ++i) { dst[i] = H (src[i]); }
+    }
+
+} // namespace morph
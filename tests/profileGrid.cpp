@@ -41,12 +41,20 @@ int main()
 
     sc::time_point t4 = sc::now();
 
-    std::cout << "Grid sizes: " << grid_ct.n << " and " << grid_rt.n << " and " << cgrid.num() << std::endl;
+    // A CartGrid without its list of Rects (the d_ vectors are computed directly)
+    morph::CartGrid cgrid_nr(grid_spacing[0], grid_spacing[1],
+                             grid_zero[0], grid_zero[1], (Nside-1)*grid_spacing[0], (Nside-1)*grid_spacing[1], 0.0f,
+                             morph::GridDomainShape::Rectangle, d_wrap, false);
+    cgrid_nr.setBoundaryOnOuterEdge();
+    sc::time_point t5 = sc::now();
+
+    std::cout << "Grid sizes: " << grid_ct.n << " and " << grid_rt.n << " and " << cgrid.num() << " and " << cgrid_nr.num() << std::endl;
 
     std::cout << "Gridct instantiation (without memory vecs): " << duration_cast<milliseconds>(t1-t0).count() << " ms\n";
     std::cout << "Gridct instantiation (WITH memory vecs):    " << duration_cast<milliseconds>(t2-t1).count() << " ms\n";
     std::cout << "CartGrid instantiation:                     " << duration_cast<milliseconds>(t3-t2).count() << " ms\n";
     std::cout << "Grid instantiation:                         " << duration_cast<milliseconds>(t4-t3).count() << " ms\n";
+    std::cout << "CartGrid instantiation (without Rects):     " << duration_cast<milliseconds>(t5-t4).count() << " ms\n";
 
     std::cout << "\nGridct without memory\n------------------------------\n";
 
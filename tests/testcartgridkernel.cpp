@@ -0,0 +1,62 @@
+/*
+ * Test that CartGridKernel gives the same convolution as CartGrid::convolve, for
+ * separable and general kernels, with and without horizontal wrapping.
+ */
+
+#include "morph/CartGridKernel.h"
+#include "morph/CartGrid.h"
+#include "morph/vvec.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    // A Gaussian kernel (separable) and a kernel with an off-axis feature (not separable)
+    CartGrid kernel (0.01f, 0.01f, -0.05f, -0.04f, 0.05f, 0.04f);
+    vvec<float> gauss (kernel.num());
+    vvec<float> general (kernel.num());
+    for (auto kr : kernel.rects) {
+        gauss[kr.vi] = std::exp (-(kr.x * kr.x) / 0.001f) * std::exp (-(kr.y * kr.y) / 0.0005f);
+        general[kr.vi] = std::exp (-(kr.x * kr.x + kr.y * kr.y) / 0.001f) + (kr.xi == 2 && kr.yi == -1 ? 0.5f : 0.0f);
+    }
+
+    for (auto wrap : { GridDomainWrap::None, GridDomainWrap::Horizontal }) {
+        CartGrid cg (0.01f, 0.01f, -0.3f, -0.2f, 0.3f, 0.2f, 0.0f, GridDomainShape::Rectangle, wrap);
+        vvec<float> data (cg.num());
+        for (auto r : cg.rects) { data[r.vi] = std::sin (20.0f * r.x) * std::cos (13.0f * r.y) + (r.vi % 11 == 0 ? 1.0f : 0.0f); }
+
+        for (const vvec<float>* kd : { &gauss, &general }) {
+            vvec<float> ref (cg.num(), 0.0f);
+            cg.convolve (kernel, *kd, data, ref);
+            CartGridKernel<float> gk (cg, kernel, *kd);
+            if (gk.isSeparable() != (kd == &gauss)) { cerr << "Wrong separability for a kernel\n"; rtn = -1; }
+            vvec<float> result (cg.num(), 0.0f);
+            gk.convolve (data, result);
+            const float md = (result - ref).abs().max();
+            if (md > 1e-5f * ref.abs().max()) {
+                cerr << "CartGridKernel differs from CartGrid::convolve by " << md
+                     << (wrap == GridDomainWrap::None ? "" : " (wrapped)") << endl;
+                rtn = -1;
+            }
+        }
+    }
+
+    // The result and data must be separate
+    {
+        CartGrid cg (0.01f, 0.01f, -0.1f, -0.1f, 0.1f, 0.1f);
+        CartGridKernel<float> gk (cg, kernel, gauss);
+        vvec<float> data (cg.num(), 1.0f);
+        try {
+            gk.convolve (data, data);
+            cerr << "No exception for convolution in place\n"; rtn = -1;
+        } catch (const std::runtime_error&) {}
+    }
+
+    cout << "testcartgridkernel " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
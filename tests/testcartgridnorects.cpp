@@ -0,0 +1,101 @@
+/*
+ * Test that a rectangular CartGrid constructed without its list of Rects has the same d_
+ * vectors (coordinates, indices, flags and neighbours) as one constructed with them.
+ */
+
+#include "morph/CartGrid.h"
+#include "morph/CartGridKernel.h"
+#include "morph/vvec.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    for (auto wrap : { GridDomainWrap::None, GridDomainWrap::Horizontal }) {
+        CartGrid cg (0.1f, 0.2f, -1.0f, -0.6f, 1.5f, 1.2f, 0.0f, GridDomainShape::Rectangle, wrap);
+        cg.setBoundaryOnOuterEdge();
+        CartGrid cgv (0.1f, 0.2f, -1.0f, -0.6f, 1.5f, 1.2f, 0.0f, GridDomainShape::Rectangle, wrap, false);
+        cgv.setBoundaryOnOuterEdge();
+
+        const std::string ws = wrap == GridDomainWrap::None ? "" : " (wrapped)";
+        if (!cgv.rects.empty() || cgv.withRects || !cg.withRects) { cerr << "Unexpected Rects" << ws << endl; rtn = -1; }
+        if (cgv.num() != cg.num() || cgv.w_px != cg.w_px || cgv.h_px != cg.h_px || cgv.lastVectorIndex() != cg.lastVectorIndex()) {
+            cerr << "Size differs" << ws << ": " << cgv.num() << " vs " << cg.num() << endl;
+            rtn = -1;
+            continue;
+        }
+        if (cgv.d_x != cg.d_x || cgv.d_y != cg.d_y) { cerr << "Coordinates differ" << ws << endl; rtn = -1; }
+        if (cgv.d_xi != cg.d_xi || cgv.d_yi != cg.d_yi) { cerr << "Indices differ" << ws << endl; rtn = -1; }
+        if (cgv.d_flags != cg.d_flags) { cerr << "Flags differ" << ws << endl; rtn = -1; }
+        if (cgv.d_distToBoundary != cg.d_distToBoundary) { cerr << "distToBoundary differs" << ws << endl; rtn = -1; }
+        if (cgv.d_ne != cg.d_ne || cgv.d_nne != cg.d_nne || cgv.d_nn != cg.d_nn || cgv.d_nnw != cg.d_nnw
+            || cgv.d_nw != cg.d_nw || cgv.d_nsw != cg.d_nsw || cgv.d_ns != cg.d_ns || cgv.d_nse != cg.d_nse) {
+            cerr << "Neighbours differ" << ws << endl;
+            rtn = -1;
+        }
+        if (cgv.xi_minmax.min != cg.xi_minmax.min || cgv.xi_minmax.max != cg.xi_minmax.max
+            || cgv.yi_minmax.min != cg.yi_minmax.min || cgv.yi_minmax.max != cg.yi_minmax.max) {
+            cerr << "Index ranges differ" << ws << endl;
+            rtn = -1;
+        }
+
+        // computeDistanceToBoundary works from the d_ vectors
+        for (auto metric : { DistanceMetric::Euclidean, DistanceMetric::HopCount }) {
+            cg.computeDistanceToBoundary (metric);
+            cgv.computeDistanceToBoundary (metric);
+            if (cgv.d_distToBoundary != cg.d_distToBoundary) { cerr << "Computed distToBoundary differs" << ws << endl; rtn = -1; }
+        }
+
+        // Methods which need the Rects throw, rather than walking an empty list
+        vvec<float> in (cgv.num(), 1.0f), out (cgv.num(), 0.0f);
+        int nthrown = 0;
+        try { cgv.boxfilter (in, out, 3); } catch (const std::runtime_error&) { ++nthrown; }
+        try { cgv.convolve (cgv, in, in, out); } catch (const std::runtime_error&) { ++nthrown; }
+        try { cgv.oncentre_offsurround (in, out); } catch (const std::runtime_error&) { ++nthrown; }
+        try {
+            CartGrid cgp (0.1f, 0.1f, 0.0f, 0.0f, 0.5f, 0.5f);
+            vvec<float> polar_data (cgp.num());
+            cgv.resampleToPolar (in, cgp, polar_data, { 0.0f, 0.0f }, 0.0f);
+        } catch (const std::runtime_error&) { ++nthrown; }
+        try { cgv.setBoundary (cg.rects); } catch (const std::runtime_error&) { ++nthrown; }
+        try { cgv.output(); } catch (const std::runtime_error&) { ++nthrown; }
+        if (nthrown != 6) { cerr << "Only " << nthrown << " of 6 Rect-walking methods threw" << ws << endl; rtn = -1; }
+
+        // A CartGridKernel works on the CartGrid without Rects
+        CartGrid kernel (0.1f, 0.2f, -0.3f, -0.4f, 0.3f, 0.4f);
+        vvec<float> kd (kernel.num());
+        for (auto kr : kernel.rects) { kd[kr.vi] = std::exp (-(kr.x * kr.x + kr.y * kr.y) / 0.1f) + (kr.xi == 1 ? 0.2f : 0.0f); }
+        vvec<float> data (cg.num());
+        for (unsigned int i = 0; i < cg.num(); ++i) { data[i] = std::sin (3.0f * cg.d_x[i]) + cg.d_y[i]; }
+        vvec<float> r1 (cg.num()), r2 (cg.num());
+        CartGridKernel<float> (cg, kernel, kd).convolve (data, r1);
+        CartGridKernel<float> (cgv, kernel, kd).convolve (data, r2);
+        if (r1 != r2) { cerr << "CartGridKernel results differ" << ws << endl; rtn = -1; }
+
+        // ...as it does with a kernel CartGrid without Rects
+        CartGrid kernelv (0.1f, 0.2f, -0.3f, -0.4f, 0.3f, 0.4f, 0.0f, GridDomainShape::Rectangle, GridDomainWrap::None, false);
+        vvec<float> kdv (kernelv.num());
+        for (unsigned int i = 0; i < kernelv.num(); ++i) {
+            const float kx = kernelv.d_x[i];
+            const float ky = kernelv.d_y[i];
+            kdv[i] = std::exp (-(kx * kx + ky * ky) / 0.1f) + (kernelv.d_xi[i] == 1 ? 0.2f : 0.0f);
+        }
+        vvec<float> r3 (cg.num());
+        CartGridKernel<float> (cgv, kernelv, kdv).convolve (data, r3);
+        if (r3 != r1) { cerr << "CartGridKernel result with a Rect-less kernel differs" << ws << endl; rtn = -1; }
+    }
+
+    // Only a rectangle can be made without Rects
+    try {
+        CartGrid cgb (0.1f, 0.1f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, GridDomainShape::Boundary, GridDomainWrap::None, false);
+        cerr << "No exception for a Boundary shaped CartGrid without Rects\n"; rtn = -1;
+    } catch (const std::runtime_error&) {}
+
+    cout << "testcartgridnorects " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
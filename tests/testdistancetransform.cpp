@@ -0,0 +1,88 @@
+/*
+ * Test the distance transform used by HexGrid::computeDistanceToBoundary and
+ * CartGrid::computeDistanceToBoundary against brute force computations.
+ */
+
+#include "morph/HexGrid.h"
+#include "morph/CartGrid.h"
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    // Euclidean distances on an elliptical HexGrid, compared with a search over all boundary hexes
+    HexGrid hg (0.02f, 3.0f, 0.0f);
+    hg.setEllipticalBoundary (1.2f, 0.7f);
+    hg.computeDistanceToBoundary();
+    std::vector<float> serial = hg.d_distToBoundary;
+    hg.computeDistanceToBoundary (DistanceMetric::Euclidean, true);
+    if (hg.d_distToBoundary != serial) {
+        cerr << "Parallel distance transform differs from serial\n";
+        rtn = -1;
+    }
+
+    unsigned int nwrong = 0;
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        float mind = std::numeric_limits<float>::max();
+        for (unsigned int j = 0; j < hg.num(); ++j) {
+            if (hg.d_flags[j] & HEX_IS_BOUNDARY) {
+                float dx = hg.d_x[i] - hg.d_x[j];
+                float dy = hg.d_y[i] - hg.d_y[j];
+                mind = std::min (mind, std::sqrt (dx*dx + dy*dy));
+            }
+        }
+        if (std::abs (serial[i] - mind) > 1e-5f) { ++nwrong; }
+    }
+    // Check the Hex list also got the distances
+    for (auto h : hg.hexen) {
+        if (h.distToBoundary != serial[h.di] || h.distToBoundary < 0.0f) { ++nwrong; }
+    }
+    if (nwrong > 0) {
+        cerr << nwrong << " hexes have the wrong Euclidean distance to boundary\n";
+        rtn = -1;
+    }
+
+    // Hop count distances on the whole hexagonal grid are (maxRing - ring) * d
+    HexGrid hg2 (0.1f, 2.0f, 0.0f, false);
+    hg2.setBoundaryOnOuterEdge();
+    hg2.computeDistanceToBoundary (DistanceMetric::HopCount);
+    int maxRing = 10;
+    for (unsigned int i = 0; i < hg2.num(); ++i) {
+        int ring = std::max (std::abs (hg2.d_ri[i]), std::max (std::abs (hg2.d_gi[i]), std::abs (hg2.d_ri[i] + hg2.d_gi[i])));
+        if (std::abs (hg2.d_distToBoundary[i] - (maxRing - ring) * hg2.getd()) > 1e-5f) {
+            cerr << "Hop count distance wrong for hex " << i << ": " << hg2.d_distToBoundary[i] << endl;
+            rtn = -1;
+            break;
+        }
+    }
+
+    // On a CartGrid with its outer edge as the boundary, the distance to the nearest
+    // edge is the same for both metrics
+    CartGrid cg (0.25f, 0.25f, 4.0f, 2.0f, 0.0f, GridDomainShape::Boundary);
+    cg.setBoundaryOnOuterEdge();
+    for (auto metric : {DistanceMetric::Euclidean, DistanceMetric::HopCount}) {
+        cg.computeDistanceToBoundary (metric, true);
+        for (unsigned int i = 0; i < cg.num(); ++i) {
+            int xi = cg.d_xi[i] - cg.xi_minmax.min;
+            int yi = cg.d_yi[i] - cg.yi_minmax.min;
+            int xw = cg.xi_minmax.max - cg.xi_minmax.min;
+            int yh = cg.yi_minmax.max - cg.yi_minmax.min;
+            int steps = std::min (std::min (xi, xw - xi), std::min (yi, yh - yi));
+            if (std::abs (cg.d_distToBoundary[i] - steps * 0.25f) > 1e-5f) {
+                cerr << "CartGrid distance wrong at (" << xi << "," << yi << "): " << cg.d_distToBoundary[i] << endl;
+                rtn = -1;
+                break;
+            }
+        }
+    }
+
+    cout << "testdistancetransform " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,107 @@
+/*
+ * Test morph::FFT and morph::FFT2 against directly computed discrete Fourier
+ * transforms.
+ */
+
+#include "morph/FFT.h"
+#include "morph/vvec.h"
+#include "morph/mathconst.h"
+#include <iostream>
+#include <vector>
+#include <complex>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+using cplx = std::complex<double>;
+
+// The DFT, computed directly
+static std::vector<cplx> dft (const std::vector<cplx>& x)
+{
+    const size_t n = x.size();
+    std::vector<cplx> X (n, cplx (0, 0));
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t j = 0; j < n; ++j) {
+            const double a = -2.0 * mathconst<double>::pi * static_cast<double>((j * k) % n) / n;
+            X[k] += x[j] * cplx (std::cos (a), std::sin (a));
+        }
+    }
+    return X;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // 1D, powers of 2 and other lengths (by Bluestein's algorithm)
+    for (unsigned int n : { 1u, 2u, 3u, 8u, 12u, 17u, 64u, 100u, 243u, 1024u }) {
+        std::vector<cplx> x (n);
+        for (unsigned int j = 0; j < n; ++j) { x[j] = cplx (std::sin (0.37 * j * j + 1.0), std::cos (1.3 * j)); }
+        const std::vector<cplx> X = dft (x);
+        FFT<double> f (n);
+        std::vector<cplx> y = x;
+        f.transform (y, false);
+        double err = 0.0;
+        for (unsigned int k = 0; k < n; ++k) { err = std::max (err, std::abs (y[k] - X[k])); }
+        f.transform (y, true);
+        double rterr = 0.0;
+        for (unsigned int k = 0; k < n; ++k) { rterr = std::max (rterr, std::abs (y[k] - x[k])); }
+        if (err > 1e-9 * n || rterr > 1e-12 * n) {
+            cerr << "n = " << n << ": FFT error " << err << ", round trip error " << rterr << endl;
+            rtn = -1;
+        }
+    }
+
+    // 2D real transforms, including odd sizes
+    for (auto dims : { std::array<unsigned int, 2>{ 8, 4 }, std::array<unsigned int, 2>{ 6, 5 },
+                       std::array<unsigned int, 2>{ 9, 7 }, std::array<unsigned int, 2>{ 16, 1 } }) {
+        const unsigned int nx = dims[0];
+        const unsigned int ny = dims[1];
+        vvec<double> u (nx * ny);
+        for (unsigned int i = 0; i < nx * ny; ++i) { u[i] = std::sin (0.7 * i) + 0.1 * (i % 5); }
+        FFT2<double> f2 (nx, ny);
+        std::vector<cplx> spec;
+        f2.forward (u, spec);
+        // The direct 2D DFT
+        double err = 0.0;
+        const unsigned int nxh = nx / 2 + 1;
+        for (unsigned int ky = 0; ky < ny; ++ky) {
+            for (unsigned int kx = 0; kx < nxh; ++kx) {
+                cplx X (0, 0);
+                for (unsigned int y = 0; y < ny; ++y) {
+                    for (unsigned int x = 0; x < nx; ++x) {
+                        const double a = -2.0 * mathconst<double>::pi * (static_cast<double>(kx * x) / nx + static_cast<double>(ky * y) / ny);
+                        X += u[y * nx + x] * cplx (std::cos (a), std::sin (a));
+                    }
+                }
+                err = std::max (err, std::abs (X - spec[ky * nxh + kx]));
+            }
+        }
+        vvec<double> v;
+        f2.inverse (spec, v);
+        const double rterr = (v - u).abs().max();
+        if (err > 1e-10 || rterr > 1e-13) {
+            cerr << nx << " x " << ny << ": FFT2 error " << err << ", round trip error " << rterr << endl;
+            rtn = -1;
+        }
+    }
+
+    // Single precision
+    {
+        vvec<float> u (128 * 96);
+        for (unsigned int i = 0; i < u.size(); ++i) { u[i] = std::cos (0.01f * i) + 0.5f * std::sin (0.3f * i); }
+        FFT2<float> f2 (128, 96);
+        std::vector<std::complex<float>> spec;
+        f2.forward (u, spec);
+        vvec<float> v;
+        f2.inverse (spec, v);
+        if ((v - u).abs().max() > 1e-5f) {
+            cerr << "float FFT2 round trip error " << (v - u).abs().max() << endl;
+            rtn = -1;
+        }
+    }
+
+    cout << "testfft " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,160 @@
+/*
+ * Test the 16 bit float types morph::float16 and morph::bfloat16, and their storage with
+ * HdfData.
+ */
+
+#include "morph/float16.h"
+#include "morph/HdfData.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+using namespace morph;
+using namespace std;
+
+// Bitwise equality of two floats, except that any two NaNs are equal
+static bool same (const float a, const float b)
+{
+    if (std::isnan (a) || std::isnan (b)) { return std::isnan (a) && std::isnan (b); }
+    return fp16::bits_of (a) == fp16::bits_of (b);
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // Every float16 converts to float exactly, and back again
+    for (unsigned int b = 0; b < 0x10000u; ++b) {
+        const std::uint16_t hb = static_cast<std::uint16_t>(b);
+        const float f = float16::decode_portable (hb);
+        if (!same (f, float16::decode (hb))) {
+            cerr << "decode differs from decode_portable for bits " << b << endl;
+            rtn = -1;
+            break;
+        }
+        if (!std::isnan (f) && float16::encode_portable (f) != hb) {
+            cerr << "float16 bits " << b << " did not survive the round trip\n";
+            rtn = -1;
+            break;
+        }
+    }
+
+    // Some known values
+    if (static_cast<float>(float16 (1.0f)) != 1.0f || float16 (1.0f).bits != 0x3c00u
+        || float16 (-2.0f).bits != 0xc000u || float16 (65504.0f).bits != 0x7bffu
+        || float16 (65520.0f).bits != 0x7c00u || float16 (5.9604645e-8f).bits != 0x0001u) {
+        cerr << "float16 known values are wrong\n";
+        rtn = -1;
+    }
+    // Ties round to even: 1 + 2^-11 is half way between 1 and 1 + 2^-10
+    if (float16 (1.0f + 1.0f / 2048.0f).bits != 0x3c00u || float16 (1.0f + 3.0f / 2048.0f).bits != 0x3c02u) {
+        cerr << "float16 does not round ties to even\n";
+        rtn = -1;
+    }
+
+    // encode agrees with encode_portable for arbitrary floats
+    std::uint32_t lcg = 12345u;
+    for (unsigned int i = 0; i < 2000000u; ++i) {
+        lcg = lcg * 1664525u + 1013904223u;
+        // Bias the exponents towards the range of float16
+        std::uint32_t u = lcg;
+        if (i % 2 == 0) { u = (u & 0x807fffffu) | ((100u + (u >> 23) % 50u) << 23); }
+        const float f = fp16::float_of (u);
+        const float a = float16::decode (float16::encode (f));
+        const float b = float16::decode (float16::encode_portable (f));
+        if (!same (a, b)) {
+            cerr << "encode differs from encode_portable for " << f << endl;
+            rtn = -1;
+            break;
+        }
+    }
+
+    // bfloat16
+    if (bfloat16 (1.0f).bits != 0x3f80u || static_cast<float>(bfloat16 (-3.0f)) != -3.0f
+        || bfloat16 (fp16::float_of (0x3f808000u)).bits != 0x3f80u
+        || bfloat16 (fp16::float_of (0x3f818000u)).bits != 0x3f82u
+        || !std::isnan (static_cast<float>(bfloat16 (std::nanf ("")))) ) {
+        cerr << "bfloat16 conversions are wrong\n";
+        rtn = -1;
+    }
+
+    // Stochastic rounding is unbiased. 1 + 2^-12 is a quarter of the way from 1 to the
+    // next float16, so rounds to nearest 1.
+    {
+        const float f = 1.0f + 1.0f / 4096.0f;
+        double sum = 0.0;
+        const unsigned int n = 1000000;
+        for (unsigned int i = 0; i < n; ++i) {
+            lcg = lcg * 1664525u + 1013904223u;
+            sum += static_cast<float>(stochastic_round<float16> (f, lcg));
+        }
+        double mean = sum / n;
+        cout << "float16: mean of stochastic roundings of " << f << " is " << mean << endl;
+        if (std::abs (mean - f) > 5e-6) { cerr << "Stochastic rounding is biased\n"; rtn = -1; }
+
+        const float g = -1.0e-3f + 1.0e-7f;
+        sum = 0.0;
+        for (unsigned int i = 0; i < n; ++i) {
+            lcg = lcg * 1664525u + 1013904223u;
+            sum += static_cast<float>(stochastic_round<bfloat16> (g, lcg));
+        }
+        mean = sum / n;
+        cout << "bfloat16: mean of stochastic roundings of " << g << " is " << mean << endl;
+        if (std::abs (mean - g) > 1e-8) { cerr << "bfloat16 stochastic rounding is biased\n"; rtn = -1; }
+    }
+
+    // Bulk conversion, and storage in HDF5
+    const unsigned int n = 1003;
+    std::vector<float> v (n);
+    for (unsigned int i = 0; i < n; ++i) { v[i] = std::sin (0.01f * i) * 100.0f; }
+    std::vector<float16> h (n);
+    std::vector<bfloat16> bh (n);
+    convert (v.data(), h.data(), n);
+    convert (v.data(), bh.data(), n);
+    std::vector<float> hv (n);
+    convert (h.data(), hv.data(), n);
+    for (unsigned int i = 0; i < n; ++i) {
+        if (h[i].bits != float16 (v[i]).bits || hv[i] != static_cast<float>(h[i]) || bh[i].bits != bfloat16 (v[i]).bits) {
+            cerr << "Bulk conversion differs from scalar conversion at " << i << endl;
+            rtn = -1;
+            break;
+        }
+    }
+
+    {
+        HdfData data ("testfloat16.h5");
+        data.add_contained_vals ("/h", h);
+        data.add_contained_vals ("/bh", bh);
+    }
+    {
+        HdfData data ("testfloat16.h5", true); // true for read data
+        std::vector<float16> h_in;
+        std::vector<bfloat16> bh_in;
+        std::vector<float> hf_in;
+        std::vector<double> bhd_in;
+        data.read_contained_vals ("/h", h_in);
+        data.read_contained_vals ("/bh", bh_in);
+        // HDF5 converts the 16 bit types to the native floating point types
+        data.read_contained_vals ("/h", hf_in);
+        data.read_contained_vals ("/bh", bhd_in);
+        if (h_in.size() != n || bh_in.size() != n || hf_in.size() != n || bhd_in.size() != n) {
+            cerr << "Read back the wrong number of 16 bit floats\n";
+            rtn = -1;
+        } else {
+            for (unsigned int i = 0; i < n; ++i) {
+                if (h_in[i].bits != h[i].bits || bh_in[i].bits != bh[i].bits
+                    || hf_in[i] != static_cast<float>(h[i]) || bhd_in[i] != static_cast<double>(static_cast<float>(bh[i]))) {
+                    cerr << "16 bit floats read from HDF5 differ at " << i << endl;
+                    rtn = -1;
+                    break;
+                }
+            }
+        }
+    }
+    std::remove ("testfloat16.h5");
+
+    cout << "testfloat16 " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,100 @@
+/*
+ * Test HexGrid::setBoundary (const std::list<Hex>&) and CartGrid::setBoundary (const
+ * std::list<Rect>&), which look up the boundary elements by their integer
+ * coordinates, and the getRegion overloads that take a vector of integer coordinates.
+ */
+
+#include "morph/HexGrid.h"
+#include "morph/CartGrid.h"
+#include "morph/vec.h"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    // Set a boundary on one HexGrid from the boundary Hexes of another
+    HexGrid hg1 (0.02f, 3.0f, 0.0f);
+    hg1.setEllipticalBoundary (1.2f, 0.7f);
+    std::list<Hex> bhexes = hg1.getBoundary();
+
+    HexGrid hg2 (0.02f, 3.0f, 0.0f);
+    hg2.setBoundary (bhexes);
+    if (hg2.num() != hg1.num()) {
+        cerr << "HexGrid from boundary list has " << hg2.num() << " hexes, not " << hg1.num() << endl;
+        rtn = -1;
+    }
+    if (hg2.d_ri != hg1.d_ri || hg2.d_gi != hg1.d_gi || hg2.d_flags != hg1.d_flags) {
+        cerr << "HexGrid from boundary list differs\n";
+        rtn = -1;
+    }
+
+    // A hexagonal region of radius 3 hexes about (2,-1), given by its axial coordinates
+    std::vector<morph::vec<int, 2>> rg;
+    for (int dr = -3; dr <= 3; ++dr) {
+        for (int dg = -3; dg <= 3; ++dg) {
+            if (std::abs (dr + dg) <= 3) { rg.push_back ({ 2 + dr, -1 + dg }); }
+        }
+    }
+    // A coordinate far outside the grid is ignored
+    rg.push_back ({ 10000, 10000 });
+    auto region = hg2.getRegion (rg);
+    unsigned int nbound = 0;
+    for (auto h : region) {
+        if (!h->testFlags (HEX_INSIDE_REGION)) { rtn = -1; }
+        int ring = std::max (std::abs (h->ri - 2), std::max (std::abs (h->gi + 1), std::abs (h->ri - 2 + h->gi + 1)));
+        if (h->testFlags (HEX_IS_REGION_BOUNDARY) != (ring == 3)) { rtn = -1; }
+        if (ring == 3) { ++nbound; }
+    }
+    if (region.size() != 37 || nbound != 18) {
+        cerr << "Hex region has " << region.size() << " hexes and " << nbound << " on its boundary\n";
+        rtn = -1;
+    }
+
+    // The same for CartGrid, with the edge of an 11 by 7 block of rects as the boundary
+    CartGrid cg1 (0.1f, 0.1f, 3.0f, 2.0f, 0.0f, GridDomainShape::Boundary);
+    std::list<Rect> brects;
+    for (auto r : cg1.rects) {
+        if ((std::abs (r.xi) == 5 && std::abs (r.yi) <= 3) || (std::abs (r.yi) == 3 && std::abs (r.xi) <= 5)) {
+            brects.push_back (r);
+        }
+    }
+    CartGrid cg2 (0.1f, 0.1f, 3.0f, 2.0f, 0.0f, GridDomainShape::Boundary);
+    cg2.setBoundary (brects);
+    unsigned int ncb = 0;
+    for (auto r : cg2.rects) {
+        if (r.testFlags (RECT_IS_BOUNDARY)) {
+            ++ncb;
+            if (std::abs (r.xi) != 5 && std::abs (r.yi) != 3) { rtn = -1; }
+        }
+        if (std::abs (r.xi) > 5 || std::abs (r.yi) > 3) { rtn = -1; }
+    }
+    if (brects.size() != 32 || ncb != 32) {
+        cerr << "CartGrid from boundary list has " << ncb << " rects on the boundary\n";
+        rtn = -1;
+    }
+
+    std::vector<morph::vec<int, 2>> xy;
+    for (int xi = -2; xi <= 2; ++xi) {
+        for (int yi = 0; yi <= 3; ++yi) { xy.push_back ({ xi, yi }); }
+    }
+    auto cregion = cg1.getRegion (xy);
+    unsigned int ncbound = 0;
+    for (auto r : cregion) {
+        if (r->testFlags (RECT_IS_REGION_BOUNDARY)) { ++ncbound; }
+    }
+    // A 5 by 4 block has 14 rects on its edge
+    if (cregion.size() != 20 || ncbound != 14) {
+        cerr << "Rect region has " << cregion.size() << " rects and " << ncbound << " on its boundary\n";
+        rtn = -1;
+    }
+
+    cout << "testgridsetboundarylist " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
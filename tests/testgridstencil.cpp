@@ -0,0 +1,145 @@
+/*
+ * Test GridStencil, the temporal blocking stencil executor, against a step by step
+ * computation using the neighbour functions of morph::Grid.
+ */
+
+#include "morph/GridStencil.h"
+#include "morph/Grid.h"
+#include "morph/CartGrid.h"
+#include "morph/vec.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+// A 9 point stencil with unequal weights, so that mixing up directions shows
+template <typename T>
+static T stencil (const GridNbhd<T>& nb)
+{
+    return nb.c * 0.5f + nb.ne * 0.11f + nb.nne * 0.02f + nb.nn * 0.09f + nb.nnw * 0.03f
+        + nb.nw * 0.08f + nb.nsw * 0.04f + nb.ns * 0.07f + nb.nse * 0.06f;
+}
+
+// The value of u at j, or at i if j is not a neighbour
+template <typename T>
+static T nbr (const std::vector<T>& u, const int i, const int j) { return j < 0 || j == std::numeric_limits<int>::max() ? u[i] : u[j]; }
+
+// One step, using Grid's neighbour relations; a missing neighbour takes the value of
+// the nearest element in the domain.
+template <typename T>
+static void reference_step (const Grid<int, float>& g, const std::vector<T>& u, std::vector<T>& v)
+{
+    const int imax = std::numeric_limits<int>::max();
+    for (int i = 0; i < g.n; ++i) {
+        const int n = g.index_nn (i) == imax ? i : g.index_nn (i);
+        const int s = g.index_ns (i) == imax ? i : g.index_ns (i);
+        GridNbhd<T> nb;
+        nb.c = u[i];
+        nb.ne = nbr (u, i, g.index_ne (i));
+        nb.nw = nbr (u, i, g.index_nw (i));
+        nb.nn = u[n];
+        nb.ns = u[s];
+        nb.nne = nbr (u, n, g.index_ne (n));
+        nb.nnw = nbr (u, n, g.index_nw (n));
+        nb.nse = nbr (u, s, g.index_ne (s));
+        nb.nsw = nbr (u, s, g.index_nw (s));
+        v[i] = stencil (nb);
+    }
+}
+
+template <typename T>
+static float maxdiff (const std::vector<T>& a, const std::vector<T>& b)
+{
+    float md = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if constexpr (std::is_same<T, float>::value) {
+            md = std::max (md, std::abs (a[i] - b[i]));
+        } else {
+            md = std::max (md, (a[i] - b[i]).abs().max());
+        }
+    }
+    return md;
+}
+
+int main()
+{
+    int rtn = 0;
+    const int W = 45;
+    const int H = 29;
+    const unsigned int nsteps = 11;
+
+    for (GridDomainWrap wrap : { GridDomainWrap::None, GridDomainWrap::Horizontal, GridDomainWrap::Vertical, GridDomainWrap::Both }) {
+        for (GridOrder order : { GridOrder::bottomleft_to_topright, GridOrder::topleft_to_bottomright }) {
+            Grid<int, float> g (W, H, { 1.0f, 1.0f }, { 0.0f, 0.0f }, wrap, order);
+            std::vector<float> u0 (g.n);
+            std::vector<vec<float, 2>> v0 (g.n);
+            for (int i = 0; i < g.n; ++i) {
+                u0[i] = std::sin (0.3f * g.v_c[i][0]) * std::cos (0.7f * g.v_c[i][1]) + (i % 7 == 0 ? 1.0f : 0.0f);
+                v0[i] = { u0[i], 2.0f * std::cos (0.2f * g.v_c[i][0] * g.v_c[i][1]) };
+            }
+            std::vector<float> ref = u0;
+            std::vector<float> tmp (g.n);
+            std::vector<vec<float, 2>> vref = v0;
+            std::vector<vec<float, 2>> vtmp (g.n);
+            for (unsigned int s = 0; s < nsteps; ++s) {
+                reference_step (g, ref, tmp);
+                ref.swap (tmp);
+                reference_step (g, vref, vtmp);
+                vref.swap (vtmp);
+            }
+
+            // Tile sizes that do and do not divide the grid, and halos deeper than the tiles
+            for (unsigned int depth : { 1u, 3u, 5u, 11u }) {
+                for (unsigned int tw : { 8u, 16u, 64u }) {
+                    GridStencil<float> gs (g);
+                    gs.depth = depth;
+                    gs.tile_w = tw;
+                    gs.tile_h = tw / 2;
+                    std::vector<float> u = u0;
+                    gs.run (u, nsteps, stencil<float>);
+                    GridStencil<vec<float, 2>> vgs (g);
+                    vgs.depth = depth;
+                    vgs.tile_w = tw;
+                    vgs.tile_h = 7;
+                    std::vector<vec<float, 2>> v = v0;
+                    vgs.run (v, nsteps, stencil<vec<float, 2>>);
+                    const float md = std::max (maxdiff (u, ref), maxdiff (v, vref));
+                    if (md > 1e-5f) {
+                        cerr << "wrap " << static_cast<int>(wrap) << ", order " << static_cast<int>(order) << ", depth " << depth
+                             << ", tile_w " << tw << ": differs from the reference by " << md << endl;
+                        rtn = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    // A rectangular CartGrid
+    {
+        CartGrid cg (0.1f, 0.1f, 0.0f, 0.0f, 2.0f, 1.0f, 0.0f, GridDomainShape::Rectangle, GridDomainWrap::Horizontal);
+        cg.setBoundaryOnOuterEdge();
+        GridStencil<float> gs (cg);
+        if (gs.get_w() != 21 || gs.get_h() != 11) {
+            cerr << "Wrong dimensions for the CartGrid: " << gs.get_w() << " x " << gs.get_h() << endl;
+            rtn = -1;
+        }
+        Grid<int, float> g (21, 11, { 0.1f, 0.1f }, { 0.0f, 0.0f }, GridDomainWrap::Horizontal);
+        std::vector<float> u (cg.num());
+        for (unsigned int i = 0; i < cg.num(); ++i) { u[i] = std::sin (3.0f * cg.d_x[i]) + cg.d_y[i]; }
+        std::vector<float> ref = u;
+        std::vector<float> tmp (u.size());
+        for (unsigned int s = 0; s < 6; ++s) { reference_step (g, ref, tmp); ref.swap (tmp); }
+        gs.tile_w = 8;
+        gs.tile_h = 4;
+        gs.run (u, 6, stencil<float>);
+        if (maxdiff (u, ref) > 1e-5f) {
+            cerr << "CartGrid: differs from the reference by " << maxdiff (u, ref) << endl;
+            rtn = -1;
+        }
+    }
+
+    cout << "testgridstencil " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
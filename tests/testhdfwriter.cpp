@@ -0,0 +1,92 @@
+/*
+ * Test HdfWriter, the background writer of HDF5 snapshots.
+ */
+
+#include "morph/HdfWriter.h"
+#include "morph/HdfData.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+    const unsigned int nsnaps = 12;
+    const size_t n = 50000;
+
+    {
+        HdfWriter<float> writer (2);
+        std::vector<float> a (n);
+        std::vector<float> b (n);
+        for (unsigned int s = 0; s < nsnaps; ++s) {
+            // The data changes after each save; the snapshot must hold the values at the time of the save
+            for (size_t i = 0; i < n; ++i) {
+                a[i] = static_cast<float>(s * n + i);
+                b[i] = -a[i];
+            }
+            std::stringstream fname;
+            fname << "testhdfwriter_" << s << ".h5";
+            writer.save (fname.str(), { { "/a", &a }, { "/grp/b", &b } });
+        }
+        writer.flush();
+        if (writer.written() != nsnaps) {
+            cerr << "Expected " << nsnaps << " snapshots written, got " << writer.written() << endl;
+            rtn = -1;
+        }
+        // Queue more and let the destructor write them
+        for (unsigned int s = nsnaps; s < nsnaps + 3; ++s) {
+            for (size_t i = 0; i < n; ++i) { a[i] = static_cast<float>(s * n + i); b[i] = -a[i]; }
+            std::stringstream fname;
+            fname << "testhdfwriter_" << s << ".h5";
+            writer.save (fname.str(), { { "/a", &a }, { "/grp/b", &b } });
+        }
+    }
+
+    for (unsigned int s = 0; s < nsnaps + 3; ++s) {
+        std::stringstream fname;
+        fname << "testhdfwriter_" << s << ".h5";
+        HdfData data (fname.str(), true); // true for read data
+        std::vector<float> a, b;
+        data.read_contained_vals ("/a", a);
+        data.read_contained_vals ("/grp/b", b);
+        bool ok = a.size() == n && b.size() == n;
+        for (size_t i = 0; ok && i < n; ++i) {
+            ok = a[i] == static_cast<float>(s * n + i) && b[i] == -a[i];
+        }
+        if (!ok) {
+            cerr << "Snapshot " << s << " was not written correctly\n";
+            rtn = -1;
+        }
+        std::remove (fname.str().c_str());
+    }
+
+    // A failure in the writer thread is reported by the next call
+    {
+        HdfWriter<double> writer;
+        std::vector<double> v (10, 1.0);
+        writer.save ("./no_such_directory/testhdfwriter.h5", { { "/v", &v } });
+        bool thrown = false;
+        try {
+            writer.flush();
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            cerr << "Expected an exception from the writer thread\n";
+            rtn = -1;
+        }
+        // And the writer carries on
+        writer.save ("testhdfwriter_ok.h5", { { "/v", &v } });
+        writer.flush();
+        if (writer.written() != 1) { rtn = -1; }
+        std::remove ("testhdfwriter_ok.h5");
+    }
+
+    cout << "testhdfwriter " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,86 @@
+/*
+ * Test the binary cache of a HexGrid (HexGrid::saveBinary, loadBinary and
+ * setBoundaryCached).
+ */
+
+#include "morph/HexGrid.h"
+#include "morph/BezCurve.h"
+#include "morph/BezCurvePath.h"
+#include <iostream>
+#include <cstdio>
+
+using namespace morph;
+using namespace std;
+
+// Return 0 if all the d_ vectors of hg1 and hg2 match
+int compare_d (const HexGrid& hg1, const HexGrid& hg2)
+{
+    int rtn = 0;
+    if (hg1.d_x != hg2.d_x) { cerr << "d_x differs\n"; rtn = -1; }
+    if (hg1.d_y != hg2.d_y) { cerr << "d_y differs\n"; rtn = -1; }
+    if (hg1.d_ri != hg2.d_ri) { cerr << "d_ri differs\n"; rtn = -1; }
+    if (hg1.d_gi != hg2.d_gi) { cerr << "d_gi differs\n"; rtn = -1; }
+    if (hg1.d_bi != hg2.d_bi) { cerr << "d_bi differs\n"; rtn = -1; }
+    if (hg1.d_ne != hg2.d_ne) { cerr << "d_ne differs\n"; rtn = -1; }
+    if (hg1.d_nne != hg2.d_nne) { cerr << "d_nne differs\n"; rtn = -1; }
+    if (hg1.d_nnw != hg2.d_nnw) { cerr << "d_nnw differs\n"; rtn = -1; }
+    if (hg1.d_nw != hg2.d_nw) { cerr << "d_nw differs\n"; rtn = -1; }
+    if (hg1.d_nsw != hg2.d_nsw) { cerr << "d_nsw differs\n"; rtn = -1; }
+    if (hg1.d_nse != hg2.d_nse) { cerr << "d_nse differs\n"; rtn = -1; }
+    if (hg1.d_flags != hg2.d_flags) { cerr << "d_flags differs\n"; rtn = -1; }
+    if (hg1.d_distToBoundary != hg2.d_distToBoundary) { cerr << "d_distToBoundary differs\n"; rtn = -1; }
+    return rtn;
+}
+
+int main()
+{
+    int rtn = 0;
+    const std::string cachefile = "./testhexgridcache.bin";
+    std::remove (cachefile.c_str());
+
+    // A boundary made of a single Bezier curve
+    BezCurvePath<float> bound;
+    BezCurve<float> c1 ({-0.5f, -0.5f}, {0.5f, 0.5f}, {0.5f, -0.5f}, {-0.5f, 0.5f});
+    bound.addCurve (c1);
+    BezCurve<float> c2 ({0.5f, 0.5f}, {-0.5f, -0.5f}, {-0.5f, 0.5f}, {0.5f, -0.5f});
+    bound.addCurve (c2);
+
+    // First time round, there's no cache, so the boundary is computed and saved
+    HexGrid hg1 (0.02f, 3.0f, 0.0f, false);
+    if (hg1.setBoundaryCached (bound, cachefile) != false) {
+        cerr << "setBoundaryCached should not have found a cache file\n";
+        rtn = -1;
+    }
+
+    // Second time, the grid is loaded from the cache
+    HexGrid hg2 (0.02f, 3.0f, 0.0f, false);
+    if (hg2.setBoundaryCached (bound, cachefile) != true) {
+        cerr << "setBoundaryCached should have loaded the cache file\n";
+        rtn = -1;
+    }
+    if (compare_d (hg1, hg2) != 0) { rtn = -1; }
+    if (hg2.num() != hg1.num()) { rtn = -1; }
+    if (hg2.getd() != hg1.getd() || hg2.getv() != hg1.getv()) { rtn = -1; }
+    if (hg2.boundaryCentroid != hg1.boundaryCentroid) { rtn = -1; }
+
+    // The Hexes can be rebuilt from the loaded grid
+    hg2.build_hexen();
+    if (hg2.hexen.size() != hg1.num()) { rtn = -1; }
+
+    // A different grid spacing has a different key, so the cache must be rejected
+    HexGrid hg3 (0.03f, 3.0f, 0.0f, false);
+    if (hg3.loadBinary (cachefile, HexGrid::cacheKey (0.03f, 3.0f, bound)) != false) {
+        cerr << "loadBinary accepted a cache with the wrong key\n";
+        rtn = -1;
+    }
+    // but is accepted if the key is not checked
+    if (hg3.loadBinary (cachefile) != true || compare_d (hg1, hg3) != 0) { rtn = -1; }
+
+    // A missing file
+    if (hg3.loadBinary ("./no_such_hexgrid_cache.bin") != false) { rtn = -1; }
+
+    std::remove (cachefile.c_str());
+
+    cout << "testhexgridcache " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,79 @@
+/*
+ * Test HexGrid::findHexIndex against a brute force search for the nearest hex.
+ */
+
+#include "morph/HexGrid.h"
+#include "morph/Random.h"
+#include "morph/vvec.h"
+#include "morph/vec.h"
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    HexGrid hg (0.03f, 3.0f, 0.0f);
+    hg.setEllipticalBoundary (1.0f, 0.6f);
+
+    morph::RandUniform<float> rng (-1.2f, 1.2f, 7);
+    morph::vvec<morph::vec<float, 2>> points (20000);
+    for (auto& p : points) { p = { rng.get(), rng.get() }; }
+
+    morph::vvec<int> indices = hg.findHexIndex (points);
+
+    unsigned int found = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        // Brute force nearest hex
+        float mind = std::numeric_limits<float>::max();
+        for (size_t j = 0; j < hg.d_x.size(); ++j) {
+            float dx = points[i][0] - hg.d_x[j];
+            float dy = points[i][1] - hg.d_y[j];
+            mind = std::min (mind, std::sqrt (dx*dx + dy*dy));
+        }
+
+        int idx = hg.findHexIndex (points[i]);
+        if (idx != indices[i]) {
+            cerr << "Batch and single lookups differ for point " << points[i] << endl;
+            rtn = -1;
+        }
+
+        if (idx > -1) {
+            ++found;
+            float dx = points[i][0] - hg.d_x[idx];
+            float dy = points[i][1] - hg.d_y[idx];
+            float dl = std::sqrt (dx*dx + dy*dy);
+            if (std::abs (dl - mind) > 1e-5f) {
+                cerr << "Point " << points[i] << ": found hex at distance " << dl
+                     << " but nearest is at " << mind << endl;
+                rtn = -1;
+            }
+        } else if (mind < hg.getSR()) {
+            // Within the inner radius of a hex, so the point is certainly inside the grid
+            cerr << "Point " << points[i] << " is inside a hex but was not found\n";
+            rtn = -1;
+        }
+    }
+
+    // Some points must have landed inside the ellipse
+    if (found == 0) { rtn = -1; }
+
+    // A point far outside the grid
+    if (hg.findHexIndex (morph::vec<float, 2>{100.0f, 100.0f}) != -1) { rtn = -1; }
+
+    // Each hex centre should map to its own index
+    for (size_t j = 0; j < hg.d_x.size(); ++j) {
+        if (hg.findHexIndex (morph::vec<float, 2>{hg.d_x[j], hg.d_y[j]}) != static_cast<int>(j)) {
+            cerr << "Hex centre " << j << " not found\n";
+            rtn = -1;
+            break;
+        }
+    }
+
+    cout << "testhexgridfind " << (rtn == 0 ? "passed" : "failed") << " (" << found << " points in grid)" << endl;
+    return rtn;
+}
@@ -0,0 +1,106 @@
+/*
+ * Test that a HexGrid built directly into its d_ vectors (init_flat) matches one built
+ * from the std::list<Hex>.
+ */
+
+#include "morph/HexGrid.h"
+#include <iostream>
+
+using namespace morph;
+using namespace std;
+
+// Return 0 if all the d_ vectors of hg1 and hg2 match
+int compare_d (const HexGrid& hg1, const HexGrid& hg2)
+{
+    int rtn = 0;
+    if (hg1.d_x != hg2.d_x) { cerr << "d_x differs\n"; rtn = -1; }
+    if (hg1.d_y != hg2.d_y) { cerr << "d_y differs\n"; rtn = -1; }
+    if (hg1.d_ri != hg2.d_ri) { cerr << "d_ri differs\n"; rtn = -1; }
+    if (hg1.d_gi != hg2.d_gi) { cerr << "d_gi differs\n"; rtn = -1; }
+    if (hg1.d_bi != hg2.d_bi) { cerr << "d_bi differs\n"; rtn = -1; }
+    if (hg1.d_ne != hg2.d_ne) { cerr << "d_ne differs\n"; rtn = -1; }
+    if (hg1.d_nne != hg2.d_nne) { cerr << "d_nne differs\n"; rtn = -1; }
+    if (hg1.d_nnw != hg2.d_nnw) { cerr << "d_nnw differs\n"; rtn = -1; }
+    if (hg1.d_nw != hg2.d_nw) { cerr << "d_nw differs\n"; rtn = -1; }
+    if (hg1.d_nsw != hg2.d_nsw) { cerr << "d_nsw differs\n"; rtn = -1; }
+    if (hg1.d_nse != hg2.d_nse) { cerr << "d_nse differs\n"; rtn = -1; }
+    if (hg1.d_flags != hg2.d_flags) { cerr << "d_flags differs\n"; rtn = -1; }
+    if (hg1.d_distToBoundary != hg2.d_distToBoundary) { cerr << "d_distToBoundary differs\n"; rtn = -1; }
+    return rtn;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // Compare the unbounded grids
+    for (float x_span : {0.01f, 0.1f, 1.0f, 3.0f}) {
+        HexGrid hg_list (0.01f, x_span, 0.0f);
+        hg_list.populate_d_vectors();
+        HexGrid hg_flat (0.01f, x_span, 0.0f, false);
+        if (!hg_flat.hexen.empty()) { cerr << "hexen should be empty\n"; rtn = -1; }
+        if (hg_flat.num() != hg_list.num()) {
+            cerr << "num() differs: " << hg_flat.num() << " vs " << hg_list.num() << endl;
+            rtn = -1;
+        }
+        if (compare_d (hg_list, hg_flat) != 0) { rtn = -1; }
+
+        // Build the list on request and check it matches the original list
+        hg_flat.build_hexen();
+        if (hg_flat.hexen.size() != hg_list.hexen.size()) { rtn = -1; }
+        auto hl = hg_list.hexen.begin();
+        auto hf = hg_flat.hexen.begin();
+        while (hl != hg_list.hexen.end() && hf != hg_flat.hexen.end()) {
+            if (hl->vi != hf->vi || hl->ri != hf->ri || hl->gi != hf->gi
+                || hl->x != hf->x || hl->y != hf->y || hl->getFlags() != hf->getFlags()) {
+                cerr << "Hex mismatch: " << hl->output() << " vs " << hf->output() << endl;
+                rtn = -1;
+                break;
+            }
+            for (unsigned short i = 0; i < 6; ++i) {
+                if (hl->has_neighbour(i) && hl->get_neighbour(i)->vi != hf->get_neighbour(i)->vi) {
+                    cerr << "Hex neighbour mismatch for " << hl->output() << endl;
+                    rtn = -1;
+                }
+            }
+            ++hl; ++hf;
+        }
+        if (hg_list.extent() != hg_flat.extent()) { cerr << "extent differs\n"; rtn = -1; }
+    }
+
+    // Apply a boundary to each and compare. The flat grid applies the boundary on its d_
+    // vectors, so hexen must stay empty.
+    for (int b = 0; b < 6; ++b) {
+        HexGrid hg_list (0.02f, 3.0f, 0.0f);
+        HexGrid hg_flat (0.02f, 3.0f, 0.0f, false);
+        for (HexGrid* hg : { &hg_list, &hg_flat }) {
+            switch (b) {
+            case 0: { hg->setEllipticalBoundary (1.2f, 0.7f); break; }
+            case 1: { hg->setCircularBoundary (0.6f, { 0.3f, -0.2f }, false); break; }
+            case 2: { hg->setRectangularBoundary (1.6f, 0.9f); break; }
+            case 3: { hg->setParallelogramBoundary (20, 12); break; }
+            case 4: { hg->setBoundaryOnOuterEdge(); break; }
+            default: {
+                // A boundary given as a list of Hexes, taken from another grid
+                HexGrid hg_b (0.02f, 3.0f, 0.0f);
+                hg_b.setEllipticalBoundary (0.9f, 0.5f);
+                hg->setBoundary (hg_b.getBoundary());
+                break;
+            }
+            }
+        }
+        if (!hg_flat.hexen.empty()) { cerr << "hexen should be empty after boundary " << b << endl; rtn = -1; }
+        if (hg_flat.num() != hg_list.num()) {
+            cerr << "num() differs after boundary " << b << ": " << hg_flat.num() << " vs " << hg_list.num() << endl;
+            rtn = -1;
+            continue;
+        }
+        if (compare_d (hg_list, hg_flat) != 0) { cerr << " (boundary " << b << ")\n"; rtn = -1; }
+        hg_list.computeDistanceToBoundary();
+        hg_flat.computeDistanceToBoundary();
+        if (hg_list.d_distToBoundary != hg_flat.d_distToBoundary) { cerr << "distance to boundary differs\n"; rtn = -1; }
+    }
+
+    cout << "testhexgridflat " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,64 @@
+/*
+ * Test that a compiled HexGridKernel gives the same result as HexGrid::convolve
+ */
+
+#include "morph/HexGrid.h"
+#include "morph/HexGridKernel.h"
+#include "morph/Random.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    // An elliptical domain
+    HexGrid hg (0.01f, 3.0f, 0.0f);
+    hg.setEllipticalBoundary (0.45f, 0.3f);
+
+    std::vector<float> data (hg.num(), 0.0f);
+    morph::RandUniform<float> rng (0.0f, 1.0f, 42);
+    for (float& d : data) { d = rng.get(); }
+
+    // A circular Gaussian kernel
+    float sigma = 0.025f;
+    HexGrid kernel (0.01f, 20.0f*sigma, 0.0f);
+    kernel.setCircularBoundary (6.0f*sigma);
+    std::vector<float> kerneldata (kernel.num(), 0.0f);
+    float sum = 0.0f;
+    for (auto& k : kernel.hexen) {
+        kerneldata[k.vi] = std::exp (-(k.r*k.r) / (2.0f * sigma * sigma));
+        sum += kerneldata[k.vi];
+    }
+    for (float& k : kerneldata) { k /= sum; }
+
+    std::vector<float> expected (hg.num(), 0.0f);
+    hg.convolve (kernel, kerneldata, data, expected);
+
+    HexGridKernel<float> hk (hg, kernel, kerneldata);
+    std::vector<float> convolved (hg.num(), 0.0f);
+    // Repeated calls should give the same answer
+    for (int i = 0; i < 3; ++i) { hk.convolve (data, convolved); }
+
+    float maxerr = 0.0f;
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        maxerr = std::max (maxerr, std::abs (convolved[i] - expected[i]));
+    }
+    cout << "Compiled kernel with " << hk.nnz() << " entries; max difference from HexGrid::convolve: " << maxerr << endl;
+    if (maxerr > 1e-5f) { rtn = -1; }
+    if (hk.size() != hg.num()) { rtn = -1; }
+
+    // The result vector must be separate memory
+    try {
+        hk.convolve (data, data);
+        rtn = -1;
+    } catch (const std::exception&) {
+        // expected
+    }
+
+    return rtn;
+}
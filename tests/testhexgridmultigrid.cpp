@@ -0,0 +1,83 @@
+/*
+ * Test HexGridMultigrid, the multigrid solver for (a - b Del^2) u = f on a HexGrid.
+ */
+
+#include "morph/HexGridMultigrid.h"
+#include "morph/HexGridPyramid.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    HexGridPyramid pyr (0.01f, 3.0f, 5, [](HexGrid& g) { g.setEllipticalBoundary (1.0f, 0.7f); });
+    const HexGrid& hg = pyr.grid(0);
+    const unsigned int n = hg.num();
+
+    // A smooth manufactured solution, from which f is computed
+    std::vector<double> u_true (n);
+    for (unsigned int i = 0; i < n; ++i) {
+        u_true[i] = std::sin (3.0 * hg.d_x[i]) * std::cos (2.0 * hg.d_y[i]) + 0.1 * hg.d_x[i] * hg.d_y[i];
+    }
+
+    for (double b : {0.001, 1.0}) {
+        HexGridMultigrid<double> mg (pyr, 1.0, b);
+        std::vector<double> f;
+        mg.apply (0, u_true, f);
+
+        std::vector<double> u (n, 0.0);
+        unsigned int cycles = mg.solve (f, u, 1e-10, 30);
+        double maxerr = 0.0;
+        for (unsigned int i = 0; i < n; ++i) { maxerr = std::max (maxerr, std::abs (u[i] - u_true[i])); }
+        cout << "b = " << b << ": " << cycles << " V-cycles, max error " << maxerr << endl;
+        // Multigrid convergence is independent of grid size; a few cycles per decade
+        if (cycles > 15 || maxerr > 1e-6) {
+            cerr << "Multigrid failed to converge quickly for b = " << b << endl;
+            rtn = -1;
+        }
+    }
+
+    // The Neumann Poisson problem (a = 0) with zero-mean data
+    {
+        HexGridMultigrid<double> mg (pyr, 0.0, 1.0);
+        std::vector<double> f;
+        mg.apply (0, u_true, f);
+        std::vector<double> u (n, 0.0);
+        unsigned int cycles = mg.solve (f, u, 1e-8, 40);
+        // u is found only up to a constant
+        double mean_diff = 0.0;
+        for (unsigned int i = 0; i < n; ++i) { mean_diff += u_true[i] - u[i]; }
+        mean_diff /= n;
+        double maxerr = 0.0;
+        for (unsigned int i = 0; i < n; ++i) { maxerr = std::max (maxerr, std::abs (u[i] + mean_diff - u_true[i])); }
+        cout << "Poisson: " << cycles << " V-cycles, max error " << maxerr << endl;
+        if (cycles >= 40 || maxerr > 1e-5) {
+            cerr << "Multigrid failed to solve the Neumann Poisson problem\n";
+            rtn = -1;
+        }
+    }
+
+    // Single precision
+    {
+        HexGridMultigrid<float> mg (pyr, 1.0f, 0.1f);
+        std::vector<float> uf (n);
+        for (unsigned int i = 0; i < n; ++i) { uf[i] = static_cast<float>(u_true[i]); }
+        std::vector<float> f;
+        mg.apply (0, uf, f);
+        std::vector<float> u (n, 0.0f);
+        // Rounding limits the relative residual to about 1e-4 in single precision
+        unsigned int cycles = mg.solve (f, u, 1e-3f, 20);
+        float maxerr = 0.0f;
+        for (unsigned int i = 0; i < n; ++i) { maxerr = std::max (maxerr, std::abs (u[i] - uf[i])); }
+        cout << "float: " << cycles << " V-cycles, max error " << maxerr << endl;
+        if (cycles > 5 || maxerr > 1e-2f) { cerr << "Single precision solve failed\n"; rtn = -1; }
+    }
+
+    cout << "testhexgridmultigrid " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
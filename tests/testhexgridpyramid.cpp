@@ -0,0 +1,75 @@
+/*
+ * Test HexGridPyramid: the levels, and the restriction and prolongation operators
+ * between them.
+ */
+
+#include "morph/HexGridPyramid.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    HexGridPyramid pyr (0.01f, 3.0f, 4, [](HexGrid& g) { g.setEllipticalBoundary (1.2f, 0.8f); });
+    if (pyr.size() != 4) { rtn = -1; }
+
+    for (unsigned int k = 0; k + 1 < pyr.size(); ++k) {
+        const HexGrid& fine = pyr.grid(k);
+        const HexGrid& coarse = pyr.grid(k+1);
+        if (std::abs (coarse.getd() - 2.0f * fine.getd()) > 1e-6f) { rtn = -1; }
+        cout << "Level " << k << ": " << fine.num() << " hexes; level " << k+1 << ": " << coarse.num() << " hexes\n";
+
+        // Constants are preserved by both operators
+        std::vector<float> fone (fine.num(), 3.0f);
+        std::vector<float> cone;
+        pyr.restrictToCoarse (k, fone, cone);
+        std::vector<float> fone2;
+        pyr.prolongToFine (k, cone, fone2);
+        for (auto c : cone) { if (std::abs (c - 3.0f) > 1e-5f) { cerr << "Restriction of a constant is " << c << endl; rtn = -1; break; } }
+        for (auto f : fone2) { if (std::abs (f - 3.0f) > 1e-5f) { cerr << "Prolongation of a constant is " << f << endl; rtn = -1; break; } }
+
+        // Linear data is interpolated exactly where both coarse partners exist...
+        auto linear = [](float x, float y) { return 2.0f * x - 3.0f * y + 1.0f; };
+        std::vector<float> clin (coarse.num());
+        for (unsigned int i = 0; i < coarse.num(); ++i) { clin[i] = linear (coarse.d_x[i], coarse.d_y[i]); }
+        std::vector<float> flin;
+        pyr.prolongToFine (k, clin, flin);
+        const HexGridPyramid::Transfer& tr = pyr.transfer(k);
+        for (unsigned int i = 0; i < fine.num(); ++i) {
+            bool exact = tr.p_weight[2*i] == 1.0f ? (std::abs (fine.d_x[i] - coarse.d_x[tr.p_src[2*i]]) < 1e-5f
+                                                     && std::abs (fine.d_y[i] - coarse.d_y[tr.p_src[2*i]]) < 1e-5f)
+                                                  : true;
+            if (exact && std::abs (flin[i] - linear (fine.d_x[i], fine.d_y[i])) > 1e-4f) {
+                cerr << "Prolongation of linear data wrong at fine hex " << i << endl;
+                rtn = -1;
+                break;
+            }
+        }
+
+        // ...and restricted exactly where all seven fine hexes exist
+        std::vector<float> flin2 (fine.num());
+        for (unsigned int i = 0; i < fine.num(); ++i) { flin2[i] = linear (fine.d_x[i], fine.d_y[i]); }
+        std::vector<float> clin2;
+        pyr.restrictToCoarse (k, flin2, clin2);
+        unsigned int ninterior = 0;
+        for (unsigned int i = 0; i < coarse.num(); ++i) {
+            if (tr.r_start[i+1] - tr.r_start[i] == 7) {
+                ++ninterior;
+                if (std::abs (clin2[i] - linear (coarse.d_x[i], coarse.d_y[i])) > 1e-4f) {
+                    cerr << "Restriction of linear data wrong at coarse hex " << i << endl;
+                    rtn = -1;
+                    break;
+                }
+            }
+        }
+        if (ninterior == 0) { rtn = -1; }
+    }
+
+    cout << "testhexgridpyramid " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
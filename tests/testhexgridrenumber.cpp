@@ -0,0 +1,102 @@
+/*
+ * Test HexGrid::renumber, which reorders the d_ vectors along a space filling curve,
+ * and the conversions to and from raster order.
+ */
+
+#include "morph/HexGrid.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+using namespace morph;
+using namespace std;
+
+// The mean distance in memory between each hex and its neighbours
+double mean_neighbour_stride (const HexGrid& hg)
+{
+    double sum = 0.0;
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        for (int nb : {hg.d_ne[i], hg.d_nne[i], hg.d_nnw[i], hg.d_nw[i], hg.d_nsw[i], hg.d_nse[i]}) {
+            if (nb > -1) { sum += std::abs (static_cast<int>(i) - nb); ++count; }
+        }
+    }
+    return sum / count;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    HexGrid ref (0.01f, 3.0f, 0.0f);
+    ref.setEllipticalBoundary (1.2f, 0.7f);
+    const double ref_stride = mean_neighbour_stride (ref);
+    std::vector<float> ref_raster_x = ref.toRaster (ref.d_x);
+
+    for (auto order : {HexDomainOrder::Raster, HexDomainOrder::Morton, HexDomainOrder::Hilbert}) {
+        HexGrid hg (0.01f, 3.0f, 0.0f);
+        hg.setEllipticalBoundary (1.2f, 0.7f);
+        hg.renumber (order);
+
+        if (hg.num() != ref.num()) { rtn = -1; }
+
+        // The neighbour relations must be consistent with the axial coordinates
+        for (unsigned int i = 0; i < hg.num(); ++i) {
+            if ((hg.d_ne[i] > -1 && (hg.d_ri[hg.d_ne[i]] != hg.d_ri[i] + 1 || hg.d_gi[hg.d_ne[i]] != hg.d_gi[i]))
+                || (hg.d_nne[i] > -1 && (hg.d_ri[hg.d_nne[i]] != hg.d_ri[i] || hg.d_gi[hg.d_nne[i]] != hg.d_gi[i] + 1))
+                || (hg.d_nnw[i] > -1 && (hg.d_ri[hg.d_nnw[i]] != hg.d_ri[i] - 1 || hg.d_gi[hg.d_nnw[i]] != hg.d_gi[i] + 1))
+                || (hg.d_nw[i] > -1 && (hg.d_ri[hg.d_nw[i]] != hg.d_ri[i] - 1 || hg.d_gi[hg.d_nw[i]] != hg.d_gi[i]))
+                || (hg.d_nsw[i] > -1 && (hg.d_ri[hg.d_nsw[i]] != hg.d_ri[i] || hg.d_gi[hg.d_nsw[i]] != hg.d_gi[i] - 1))
+                || (hg.d_nse[i] > -1 && (hg.d_ri[hg.d_nse[i]] != hg.d_ri[i] + 1 || hg.d_gi[hg.d_nse[i]] != hg.d_gi[i] - 1))) {
+                cerr << "Bad neighbour for hex " << i << endl;
+                rtn = -1;
+                break;
+            }
+        }
+
+        // The Hexes must agree with the d_ vectors
+        for (const auto& h : hg.hexen) {
+            if (h.vi != h.di || hg.vhexen[h.vi] != &h || hg.d_ri[h.vi] != h.ri || hg.d_gi[h.vi] != h.gi
+                || hg.d_flags[h.vi] != h.getFlags()) {
+                cerr << "Hex " << h.outputRG() << " does not match its d_ entry\n";
+                rtn = -1;
+                break;
+            }
+        }
+
+        // The raster ordered data is independent of the ordering
+        std::vector<float> raster_x = hg.toRaster (hg.d_x);
+        if (raster_x != ref_raster_x) { cerr << "toRaster differs\n"; rtn = -1; }
+        if (hg.fromRaster (raster_x) != hg.d_x) { cerr << "fromRaster is not the inverse of toRaster\n"; rtn = -1; }
+        std::vector<unsigned int> r2i = hg.rasterToIndex();
+        std::vector<unsigned int> i2r = hg.indexToRaster();
+        for (unsigned int i = 0; i < hg.num(); ++i) {
+            if (r2i[i2r[i]] != i) { rtn = -1; break; }
+        }
+        if (order == HexDomainOrder::Raster) {
+            for (unsigned int i = 0; i < hg.num(); ++i) {
+                if (r2i[i] != i) { cerr << "Raster renumbering is not in raster order\n"; rtn = -1; break; }
+            }
+        }
+
+        // Position lookup uses the new numbering
+        for (unsigned int i = 0; i < hg.num(); i += 97) {
+            if (hg.findHexIndex (morph::vec<float, 2>{hg.d_x[i], hg.d_y[i]}) != static_cast<int>(i)) {
+                cerr << "findHexIndex wrong after renumber\n";
+                rtn = -1;
+                break;
+            }
+        }
+
+        double stride = mean_neighbour_stride (hg);
+        cout << "Mean neighbour stride: " << stride << " (spiral: " << ref_stride << ")\n";
+        if (order == HexDomainOrder::Hilbert && stride >= ref_stride) {
+            cerr << "Hilbert ordering should bring neighbours closer together in memory\n";
+            rtn = -1;
+        }
+    }
+
+    cout << "testhexgridrenumber " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,147 @@
+/*
+ * Test the adaptive timestep Dormand-Prince integrator RD_Base::adaptive_step.
+ */
+
+#include "morph/RD_Base.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<double>
+{
+public:
+    std::vector<double> A;
+    std::vector<double> B;
+    double D_A = 0.01;
+    double D_B = 0.2;
+    void init()
+    {
+        this->A.resize (this->nhex);
+        this->B.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            this->A[h] = 1.0 + 0.2 * std::sin (7.0 * this->hg->d_x[h]);
+            this->B[h] = 0.9 + 0.1 * std::cos (5.0 * this->hg->d_y[h]);
+        }
+    }
+    void step() {}
+
+    // Schnakenberg system
+    void schnak (const int h, const std::array<const double*, 2>& x, std::array<double, 2>& dxdt)
+    {
+        const double a2b = x[0][h] * x[0][h] * x[1][h];
+        dxdt[0] = 0.1 - x[0][h] + a2b + this->D_A * this->laplace_at (x[0], h);
+        dxdt[1] = 0.9 - a2b + this->D_B * this->laplace_at (x[1], h);
+    }
+
+    //! Step adaptively up to time T
+    void run_adaptive (const double T)
+    {
+        auto rhs = [this](const int h, const std::array<const double*, 2>& x, std::array<double, 2>& dxdt) { this->schnak (h, x, dxdt); };
+        while (this->simTime < T) {
+            this->dt_max = T - this->simTime;
+            this->adaptive_step<2> ({ &this->A, &this->B }, rhs);
+            ++this->stepCount;
+        }
+    }
+
+    //! Step with fixed RK4 steps up to time T
+    void run_fixed (const double T, const unsigned int nsteps)
+    {
+        auto rhs = [this](const int h, const std::array<const double*, 2>& x, std::array<double, 2>& dxdt) { this->schnak (h, x, dxdt); };
+        this->set_dt (T / nsteps);
+        for (unsigned int s = 0; s < nsteps; ++s) { this->fused_step<2> ({ &this->A, &this->B }, rhs); }
+    }
+};
+
+int main()
+{
+    int rtn = 0;
+
+    // Exponential decay with no diffusion, against the exact solution
+    {
+        RD_test rd;
+        rd.svgpath = "";
+        rd.hextohex_d = 0.05f;
+        rd.hexspan = 2.0f;
+        rd.allocate();
+        rd.init();
+        rd.atol = { 1e-10 };
+        rd.rtol = { 1e-7 };
+        rd.set_dt (0.01);
+        std::vector<double> A0 = rd.A;
+        auto decay = [](const int h, const std::array<const double*, 1>& x, std::array<double, 1>& dxdt) { dxdt[0] = -2.0 * x[0][h]; };
+        unsigned int steps = 0;
+        while (rd.simTime < 1.0) {
+            rd.dt_max = 1.0 - rd.simTime;
+            rd.adaptive_step<1> ({ &rd.A }, decay);
+            ++steps;
+        }
+        double maxerr = 0.0;
+        for (unsigned int h = 0; h < rd.nhex; ++h) { maxerr = std::max (maxerr, std::abs (rd.A[h] - A0[h] * std::exp (-2.0))); }
+        if (std::abs (rd.simTime - 1.0) > 1e-12 || maxerr > 1e-7) {
+            cerr << "Decay: simTime " << rd.simTime << ", max error " << maxerr << endl;
+            rtn = -1;
+        }
+        // The last rhs of each step is reused as the first of the next
+        if (rd.rhsCount != 1 + 6 * (steps + rd.rejectCount)) {
+            cerr << "Decay: " << rd.rhsCount << " rhs evaluations for " << steps << " steps\n";
+            rtn = -1;
+        }
+    }
+
+    // Schnakenberg with diffusion, against a fine fixed step RK4 solution
+    {
+        const double T = 0.5;
+        RD_test ad;
+        ad.svgpath = "";
+        ad.hextohex_d = 0.02f;
+        ad.hexspan = 2.0f;
+        ad.allocate();
+        ad.init();
+        ad.atol = { 1e-8, 1e-8 };
+        ad.rtol = { 1e-5, 1e-5 };
+        ad.set_dt (1e-5);
+        ad.run_adaptive (T);
+
+        RD_test ref;
+        ref.svgpath = "";
+        ref.hextohex_d = 0.02f;
+        ref.hexspan = 2.0f;
+        ref.allocate();
+        ref.init();
+        ref.run_fixed (T, 10000);
+
+        double maxerr = 0.0;
+        for (unsigned int h = 0; h < ad.nhex; ++h) {
+            maxerr = std::max (maxerr, std::abs (ad.A[h] - ref.A[h]));
+            maxerr = std::max (maxerr, std::abs (ad.B[h] - ref.B[h]));
+        }
+        cout << "Schnakenberg: " << ad.stepCount << " steps, " << ad.rejectCount << " rejected, "
+             << ad.rhsCount << " rhs evaluations, max error " << maxerr << endl;
+        if (maxerr > 1e-4 || std::abs (ad.simTime - T) > 1e-12) {
+            cerr << "Adaptive Schnakenberg solution is inaccurate\n";
+            rtn = -1;
+        }
+    }
+
+    // Wrongly sized tolerances
+    {
+        RD_test rd;
+        rd.svgpath = "";
+        rd.hextohex_d = 0.1f;
+        rd.hexspan = 2.0f;
+        rd.allocate();
+        rd.init();
+        rd.atol = { 1e-6, 1e-6, 1e-6 };
+        try {
+            rd.run_adaptive (0.1);
+            cerr << "Expected an exception for wrongly sized atol\n";
+            rtn = -1;
+        } catch (const std::runtime_error&) {}
+    }
+
+    cout << "testrdadaptive " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,157 @@
+/*
+ * Test the ensemble mode of RD_Base, in which many parameter sets of one model are
+ * stepped together, against separate runs of each parameter set.
+ */
+
+#include "morph/RD_Base.h"
+#include "morph/HdfData.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<double>
+{
+public:
+    // The state, for one run or for the ensemble
+    std::vector<double> A;
+    std::vector<double> B;
+    // Per member parameters
+    std::vector<double> k1;
+    std::vector<double> D_B;
+    void init() {}
+    void step() {}
+
+    void initial (std::vector<double>& a, std::vector<double>& b, const unsigned int m)
+    {
+        a.resize (this->nhex);
+        b.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            a[h] = 1.0 + 0.2 * std::sin ((5.0 + m) * this->hg->d_x[h]);
+            b[h] = 0.9 + 0.1 * std::cos (5.0 * this->hg->d_y[h]);
+        }
+    }
+
+    // Step one member alone with fused_step
+    void step_single (const unsigned int m)
+    {
+        const double k1m = this->k1[m];
+        const double DBm = this->D_B[m];
+        this->fused_step<2> ({ &this->A, &this->B },
+                             [this, k1m, DBm](const int h, const std::array<const double*, 2>& x, std::array<double, 2>& dxdt)
+                             {
+                                 const double a2b = x[0][h] * x[0][h] * x[1][h];
+                                 dxdt[0] = k1m - x[0][h] + a2b + 0.01 * this->laplace_at (x[0], h);
+                                 dxdt[1] = 0.9 - a2b + DBm * this->laplace_at (x[1], h);
+                             });
+    }
+
+    // Step the whole ensemble of M members
+    template <unsigned int M>
+    void step_ensemble()
+    {
+        this->ensemble_step<2> ({ &this->A, &this->B }, M,
+                                [this](const int h, const std::array<const double*, 2>& x, const std::array<double*, 2>& dxdt)
+                                {
+                                    std::array<double, M> la;
+                                    std::array<double, M> lb;
+                                    this->laplace_at (x[0], h, M, la.data());
+                                    this->laplace_at (x[1], h, M, lb.data());
+                                    const double* a = x[0] + static_cast<size_t>(h) * M;
+                                    const double* b = x[1] + static_cast<size_t>(h) * M;
+                                    for (unsigned int m = 0; m < M; ++m) {
+                                        const double a2b = a[m] * a[m] * b[m];
+                                        dxdt[0][m] = this->k1[m] - a[m] + a2b + 0.01 * la[m];
+                                        dxdt[1][m] = 0.9 - a2b + this->D_B[m] * lb[m];
+                                    }
+                                });
+    }
+};
+
+int main()
+{
+    int rtn = 0;
+    constexpr unsigned int M = 6;
+    const unsigned int nsteps = 40;
+
+    RD_test ens;
+    ens.svgpath = "";
+    ens.hextohex_d = 0.03f;
+    ens.hexspan = 2.0f;
+    ens.allocate();
+    ens.set_dt (0.0005);
+    ens.k1 = { 0.1, 0.05, 0.2, 0.0, 0.15, 0.1 };
+    ens.D_B = { 0.2, 0.1, 0.3, 0.25, 0.05, 0.0 };
+    ens.resize_ensemble_variable (ens.A, M);
+    ens.resize_ensemble_variable (ens.B, M);
+    std::vector<double> a, b;
+    for (unsigned int m = 0; m < M; ++m) {
+        ens.initial (a, b, m);
+        ens.set_ensemble_member (ens.A, M, m, a);
+        ens.set_ensemble_member (ens.B, M, m, b);
+    }
+
+    // The ensemble Laplacian of each member is the Laplacian of that member alone
+    std::vector<double> lapens;
+    ens.compute_laplace_ensemble (ens.A, lapens, M);
+    for (unsigned int m = 0; m < M; ++m) {
+        std::vector<double> am, lapm (ens.nhex), lapem;
+        ens.ensemble_member (ens.A, M, m, am);
+        ens.compute_laplace (am, lapm);
+        ens.ensemble_member (lapens, M, m, lapem);
+        for (unsigned int h = 0; h < ens.nhex; ++h) {
+            if (std::abs (lapm[h] - lapem[h]) > 1e-9 * (1.0 + std::abs (lapm[h]))) {
+                cerr << "Ensemble Laplacian differs for member " << m << " at hex " << h << endl;
+                rtn = -1;
+                break;
+            }
+        }
+    }
+
+    for (unsigned int s = 0; s < nsteps; ++s) { ens.step_ensemble<M>(); }
+
+    for (unsigned int m = 0; m < M; ++m) {
+        RD_test one;
+        one.svgpath = "";
+        one.hextohex_d = 0.03f;
+        one.hexspan = 2.0f;
+        one.allocate();
+        one.set_dt (0.0005);
+        one.k1 = ens.k1;
+        one.D_B = ens.D_B;
+        one.initial (one.A, one.B, m);
+        for (unsigned int s = 0; s < nsteps; ++s) { one.step_single (m); }
+        std::vector<double> am, bm;
+        ens.ensemble_member (ens.A, M, m, am);
+        ens.ensemble_member (ens.B, M, m, bm);
+        double maxdiff = 0.0;
+        for (unsigned int h = 0; h < ens.nhex; ++h) {
+            maxdiff = std::max (maxdiff, std::abs (am[h] - one.A[h]));
+            maxdiff = std::max (maxdiff, std::abs (bm[h] - one.B[h]));
+        }
+        if (maxdiff > 1e-12) {
+            cerr << "Member " << m << " differs from its separate run by " << maxdiff << endl;
+            rtn = -1;
+        }
+    }
+
+    // Per member output
+    {
+        HdfData data ("testrdensemble.h5");
+        ens.saveEnsemble (data, "A", ens.A, M);
+    }
+    {
+        HdfData data ("testrdensemble.h5", true); // true for read data
+        std::vector<double> a3, a3e;
+        data.read_contained_vals ("/member003/A", a3);
+        ens.ensemble_member (ens.A, M, 3, a3e);
+        if (a3 != a3e) {
+            cerr << "Member 3 was not saved correctly\n";
+            rtn = -1;
+        }
+    }
+
+    cout << "testrdensemble " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
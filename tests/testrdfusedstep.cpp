@@ -0,0 +1,148 @@
+/*
+ * Test RD_Base::fused_step against Euler, midpoint and Runge-Kutta steps computed
+ * with compute_laplace and separate stage vectors.
+ */
+
+#include "morph/RD_Base.h"
+#include <iostream>
+#include <cmath>
+#include <set>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<double>
+{
+public:
+    std::vector<double> A;
+    std::vector<double> B;
+    double D_A = 0.1;
+    double D_B = 0.4;
+    void init()
+    {
+        this->A.resize (this->nhex);
+        this->B.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            this->A[h] = 1.0 + 0.5 * std::sin (7.0 * this->hg->d_x[h]);
+            this->B[h] = 0.8 + 0.3 * std::cos (5.0 * this->hg->d_y[h]);
+        }
+    }
+    void step() {}
+
+    // Schnakenberg reaction terms, with diffusion
+    void fused (const RD_Integrator method)
+    {
+        this->fused_step<2> ({ &this->A, &this->B },
+                             [this](const int h, const std::array<const double*, 2>& x, std::array<double, 2>& dxdt)
+                             {
+                                 const double a2b = x[0][h] * x[0][h] * x[1][h];
+                                 dxdt[0] = 0.1 - x[0][h] + a2b + this->D_A * this->laplace_at (x[0], h);
+                                 dxdt[1] = 0.9 - a2b + this->D_B * this->laplace_at (x[1], h);
+                             }, method);
+    }
+
+    // The same system, stepped with whole-vector operations
+    void deriv (const std::vector<double>& a, const std::vector<double>& b,
+                std::vector<double>& dadt, std::vector<double>& dbdt)
+    {
+        std::vector<double> lapa (this->nhex);
+        std::vector<double> lapb (this->nhex);
+        this->compute_laplace (a, lapa);
+        this->compute_laplace (b, lapb);
+        dadt.resize (this->nhex);
+        dbdt.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            const double a2b = a[h] * a[h] * b[h];
+            dadt[h] = 0.1 - a[h] + a2b + this->D_A * lapa[h];
+            dbdt[h] = 0.9 - a2b + this->D_B * lapb[h];
+        }
+    }
+
+    void reference (const RD_Integrator method)
+    {
+        const unsigned int n = this->nhex;
+        const double h = this->dt;
+        std::vector<double> ka1, kb1, ka2, kb2, ka3, kb3, ka4, kb4;
+        std::vector<double> ta (n), tb (n);
+        this->deriv (this->A, this->B, ka1, kb1);
+        if (method == RD_Integrator::Euler) {
+            for (unsigned int i = 0; i < n; ++i) { this->A[i] += h * ka1[i]; this->B[i] += h * kb1[i]; }
+            return;
+        }
+        for (unsigned int i = 0; i < n; ++i) { ta[i] = this->A[i] + h/2 * ka1[i]; tb[i] = this->B[i] + h/2 * kb1[i]; }
+        this->deriv (ta, tb, ka2, kb2);
+        if (method == RD_Integrator::RK2) {
+            for (unsigned int i = 0; i < n; ++i) { this->A[i] += h * ka2[i]; this->B[i] += h * kb2[i]; }
+            return;
+        }
+        for (unsigned int i = 0; i < n; ++i) { ta[i] = this->A[i] + h/2 * ka2[i]; tb[i] = this->B[i] + h/2 * kb2[i]; }
+        this->deriv (ta, tb, ka3, kb3);
+        for (unsigned int i = 0; i < n; ++i) { ta[i] = this->A[i] + h * ka3[i]; tb[i] = this->B[i] + h * kb3[i]; }
+        this->deriv (ta, tb, ka4, kb4);
+        for (unsigned int i = 0; i < n; ++i) {
+            this->A[i] += h/6 * (ka1[i] + 2.0 * (ka2[i] + ka3[i]) + ka4[i]);
+            this->B[i] += h/6 * (kb1[i] + 2.0 * (kb2[i] + kb3[i]) + kb4[i]);
+        }
+    }
+};
+
+int main()
+{
+    int rtn = 0;
+
+    for (auto method : {RD_Integrator::Euler, RD_Integrator::RK2, RD_Integrator::RK4}) {
+        RD_test fu;
+        fu.svgpath = "";
+        fu.hextohex_d = 0.02f;
+        fu.hexspan = 2.0f;
+        fu.allocate();
+        fu.set_dt (0.0002);
+        fu.init();
+        RD_test ref;
+        ref.svgpath = "";
+        ref.hextohex_d = 0.02f;
+        ref.hexspan = 2.0f;
+        ref.allocate();
+        ref.set_dt (0.0002);
+        ref.init();
+
+        // The storage of A alternates between two buffers; no allocation in a step
+        std::set<const double*> buffers;
+        for (unsigned int s = 0; s < 50; ++s) {
+            fu.fused (method);
+            ref.reference (method);
+            if (s > 0) { buffers.insert (fu.A.data()); }
+        }
+        if (buffers.size() != 2) {
+            cerr << "fused_step used " << buffers.size() << " buffers for A\n";
+            rtn = -1;
+        }
+
+        double maxdiff = 0.0;
+        for (unsigned int h = 0; h < fu.nhex; ++h) {
+            maxdiff = std::max (maxdiff, std::abs (fu.A[h] - ref.A[h]));
+            maxdiff = std::max (maxdiff, std::abs (fu.B[h] - ref.B[h]));
+        }
+        if (maxdiff > 1e-12) {
+            cerr << "fused_step differs from the reference by " << maxdiff << endl;
+            rtn = -1;
+        }
+    }
+
+    // State of the wrong size
+    RD_test bad;
+    bad.svgpath = "";
+    bad.hextohex_d = 0.05f;
+    bad.hexspan = 2.0f;
+    bad.allocate();
+    bad.init();
+    bad.B.resize (3);
+    try {
+        bad.fused (RD_Integrator::RK4);
+        cerr << "Expected an exception for a wrongly sized state variable\n";
+        rtn = -1;
+    } catch (const std::runtime_error&) {}
+
+    cout << "testrdfusedstep " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
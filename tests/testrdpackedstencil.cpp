@@ -0,0 +1,112 @@
+/*
+ * Test the packed neighbour table HexGrid::d_nbrs and the RD_Base stencils that use
+ * it, compute_laplace_packed and spacegrad2D_packed, against compute_laplace and
+ * spacegrad2D.
+ */
+
+#include "morph/RD_Base.h"
+#include "morph/Random.h"
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<float>
+{
+public:
+    std::vector<float> a;
+    std::vector<float> lapa;
+    std::array<std::vector<float>, 2> grada;
+    void init() {}
+    void step() {}
+};
+
+int main()
+{
+    int rtn = 0;
+
+    RD_test rd;
+    rd.svgpath = "";
+    rd.ellipse_a = 0.8f;
+    rd.ellipse_b = 0.6f;
+    rd.hextohex_d = 0.01f;
+    rd.hexspan = 2.0f;
+    rd.allocate();
+
+    // The table's rows and their alignment
+    HexGrid& hg = *rd.hg;
+    hg.build_neighbour_table();
+    if (hg.d_nbrs.size() != hg.num()) { rtn = -1; }
+    if (reinterpret_cast<std::uintptr_t>(hg.d_nbrs.data()) % 32 != 0) {
+        cerr << "Neighbour table is not 32 byte aligned\n";
+        rtn = -1;
+    }
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        const std::array<int, 6> d = { hg.d_ne[i], hg.d_nne[i], hg.d_nnw[i], hg.d_nw[i], hg.d_nsw[i], hg.d_nse[i] };
+        for (unsigned int k = 0; k < 6; ++k) {
+            if (hg.d_nbrs[i][k] != (d[k] > -1 ? d[k] : static_cast<int>(i))) { rtn = -1; }
+        }
+    }
+    // Sentinel slot for missing neighbours
+    hg.build_neighbour_table (hg.num());
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        if (hg.d_ne[i] == -1 && hg.d_nbrs[i][0] != static_cast<int>(hg.num())) { rtn = -1; }
+    }
+    // The table is rebuilt with the d_ vectors
+    hg.renumber (HexDomainOrder::Raster);
+    for (unsigned int i = 0; i < hg.num(); ++i) {
+        int ne = hg.d_ne[i] > -1 ? hg.d_ne[i] : static_cast<int>(hg.num());
+        if (hg.d_nbrs[i][0] != ne) { cerr << "Table not rebuilt after renumber\n"; rtn = -1; break; }
+    }
+
+    // The RD stencils need ghost neighbours. They must not overwrite a sentinel table.
+    rd.resize_vector_variable (rd.a);
+    rd.resize_vector_variable (rd.lapa);
+    try {
+        rd.compute_laplace_packed (rd.a, rd.lapa);
+        cerr << "No exception for a sentinel neighbour table\n";
+        rtn = -1;
+    } catch (const std::runtime_error&) {}
+    if (hg.d_nbrs_missing != static_cast<int>(hg.num())) { cerr << "Sentinel table was overwritten\n"; rtn = -1; }
+    hg.build_neighbour_table();
+
+    // Compare the stencils on random data
+    rd.resize_gradient_field (rd.grada);
+    morph::RandUniform<float> rng (0.0f, 1.0f, 11);
+    for (auto& av : rd.a) { av = rng.get(); }
+
+    std::vector<float> lap_ref (rd.nhex);
+    rd.compute_laplace (rd.a, lap_ref);
+    rd.compute_laplace_packed (rd.a, rd.lapa);
+    // The summation order is the same, but the compiler may contract the two loops
+    // differently, so allow for rounding in the sum of the O(1) values
+    const float lapnorm = 2.0f / (3.0f * rd.get_d() * rd.get_d());
+    float maxlapdiff = 0.0f;
+    for (unsigned int i = 0; i < rd.nhex; ++i) {
+        maxlapdiff = std::max (maxlapdiff, std::abs (rd.lapa[i] - lap_ref[i]));
+    }
+    if (maxlapdiff > 1e-5f * lapnorm) {
+        cerr << "compute_laplace_packed differs from compute_laplace by " << maxlapdiff << "\n";
+        rtn = -1;
+    }
+
+    std::array<std::vector<float>, 2> grad_ref;
+    rd.resize_gradient_field (grad_ref);
+    rd.spacegrad2D (rd.a, grad_ref);
+    rd.spacegrad2D_packed (rd.a, rd.grada);
+    float maxdiff = 0.0f;
+    for (unsigned int j = 0; j < 2; ++j) {
+        for (unsigned int i = 0; i < rd.nhex; ++i) {
+            maxdiff = std::max (maxdiff, std::abs (rd.grada[j][i] - grad_ref[j][i]));
+        }
+    }
+    if (maxdiff > 1e-5f / rd.get_d()) {
+        cerr << "spacegrad2D_packed differs from spacegrad2D by " << maxdiff << "\n";
+        rtn = -1;
+    }
+
+    cout << "testrdpackedstencil " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,140 @@
+/*
+ * Test the partitioned mode of RD_Base, in which the hexes are divided into
+ * partitions with halos, against fused_step.
+ */
+
+#include "morph/RD_Base.h"
+#include <iostream>
+#include <set>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<float>
+{
+public:
+    std::vector<float> A;
+    std::vector<float> B;
+    void init()
+    {
+        this->A.resize (this->nhex);
+        this->B.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            this->A[h] = 1.0f + 0.2f * std::sin (7.0f * this->hg->d_x[h]);
+            this->B[h] = 0.9f + 0.1f * std::cos (5.0f * this->hg->d_y[h]);
+        }
+    }
+    void step() {}
+};
+
+static void setup (RD_test& rd)
+{
+    rd.svgpath = "";
+    rd.hextohex_d = 0.03f;
+    rd.hexspan = 2.0f;
+    rd.allocate();
+    rd.hg->renumber (HexDomainOrder::Hilbert);
+    rd.init();
+    rd.set_dt (0.0005f);
+}
+
+// The Schnakenberg reaction
+static void schnakenberg (const std::array<float, 2>& u, std::array<float, 2>& r)
+{
+    const float a2b = u[0] * u[0] * u[1];
+    r[0] = 0.1f - u[0] + a2b;
+    r[1] = 0.9f - a2b;
+}
+
+// Check that the halo of each partition is exactly the set of hexes, owned by other
+// partitions, that neighbour its own hexes, and that the local neighbour table matches
+static bool check_halos (const RD_test& rd)
+{
+    unsigned int next = 0;
+    for (const RD_Partition<float>& pt : rd.partitions) {
+        if (pt.begin != next || pt.end <= pt.begin) { return false; }
+        next = pt.end;
+        std::set<unsigned int> expected;
+        for (unsigned int hi = pt.begin; hi < pt.end; ++hi) {
+            for (int nb : rd.hg->d_nbrs[hi]) {
+                if (nb < static_cast<int>(pt.begin) || nb >= static_cast<int>(pt.end)) { expected.insert (nb); }
+            }
+        }
+        if (std::set<unsigned int> (pt.halo.begin(), pt.halo.end()) != expected || expected.size() != pt.halo.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < pt.halo.size(); ++k) {
+            const RD_Partition<float>& src = rd.partitions[pt.halo_part[k]];
+            if (pt.halo[k] < src.begin || pt.halo[k] >= src.end || pt.halo_src[k] != pt.halo[k] - src.begin) { return false; }
+        }
+        for (unsigned int li = 0; li < pt.num_own(); ++li) {
+            for (unsigned int j = 0; j < 6; ++j) {
+                const int l = pt.nbrs[li][j];
+                const unsigned int g = l < static_cast<int>(pt.num_own()) ? pt.begin + l : pt.halo[l - pt.num_own()];
+                if (static_cast<int>(g) != rd.hg->d_nbrs[pt.begin + li][j]) { return false; }
+            }
+        }
+    }
+    return next == rd.nhex;
+}
+
+int main()
+{
+    int rtn = 0;
+    const unsigned int nsteps = 50;
+
+    for (RD_Integrator m : { RD_Integrator::Euler, RD_Integrator::RK2, RD_Integrator::RK4 }) {
+        RD_test ref;
+        setup (ref);
+        auto rhs = ref.reaction_diffusion<2> (std::array<float, 2>{ 0.01f, 0.2f }, schnakenberg);
+        for (unsigned int s = 0; s < nsteps; ++s) { ref.fused_step<2> ({ &ref.A, &ref.B }, rhs, m); }
+
+        for (unsigned int np : { 1u, 3u, 8u, 0u }) {
+            RD_test rd;
+            setup (rd);
+            rd.partition (np);
+            if (!check_halos (rd)) {
+                cerr << "Wrong halo lists for " << np << " partitions\n";
+                rtn = -1;
+            }
+            rd.scatter_partitions<2> ({ &rd.A, &rd.B });
+            auto prhs = rd.reaction_diffusion<2> (std::array<float, 2>{ 0.01f, 0.2f }, schnakenberg);
+            for (unsigned int s = 0; s < nsteps; ++s) { rd.partitioned_step<2> (prhs, m); }
+            std::vector<float> A;
+            std::vector<float> B;
+            rd.gather_partitions<2> ({ &A, &B });
+            float md = 0.0f;
+            for (unsigned int h = 0; h < rd.nhex; ++h) {
+                md = std::max (md, std::abs (A[h] - ref.A[h]));
+                md = std::max (md, std::abs (B[h] - ref.B[h]));
+            }
+            if (md > 1e-6f) {
+                cerr << "method " << static_cast<int>(m) << ", " << np << " partitions: differs from fused_step by " << md << endl;
+                rtn = -1;
+            }
+            if (rd.partitionReport().find ("not allocated") != std::string::npos) {
+                cerr << "A partition was not allocated\n";
+                rtn = -1;
+            }
+            if (m == RD_Integrator::RK4 && np == 8) { cout << rd.partitionReport(); }
+        }
+    }
+
+    // partitioned_step needs the partitions to hold the state
+    {
+        RD_test rd;
+        setup (rd);
+        rd.partition (2);
+        try {
+            rd.partitioned_step<2> (rd.reaction_diffusion<2> (std::array<float, 2>{ 0.01f, 0.2f }, schnakenberg));
+            cerr << "Expected an exception from partitioned_step before scatter_partitions\n";
+            rtn = -1;
+        } catch (const std::runtime_error&) {
+            // Expected
+        }
+    }
+
+    cout << "testrdpartition " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,128 @@
+/*
+ * Test RD_Base::reaction_diffusion, which builds a fused right hand side from
+ * declared diffusion coefficients and reaction terms.
+ */
+
+#include "morph/RD_Base.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<double>
+{
+public:
+    std::vector<double> A;
+    std::vector<double> B;
+    std::vector<double> C;
+    void init()
+    {
+        this->A.resize (this->nhex);
+        this->B.resize (this->nhex);
+        this->C.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            this->A[h] = 1.0 + 0.2 * std::sin (7.0 * this->hg->d_x[h]);
+            this->B[h] = 0.9 + 0.1 * std::cos (5.0 * this->hg->d_y[h]);
+            this->C[h] = 0.5 + 0.1 * std::sin (3.0 * this->hg->d_x[h] * this->hg->d_y[h]);
+        }
+    }
+    void step() {}
+};
+
+// Compile time diffusion coefficients; C does not diffuse
+struct Dconst
+{
+    constexpr double operator[] (const size_t s) const { return s == 0 ? 0.01 : (s == 1 ? 0.2 : 0.0); }
+};
+
+static void setup (RD_test& rd)
+{
+    rd.svgpath = "";
+    rd.hextohex_d = 0.03f;
+    rd.hexspan = 2.0f;
+    rd.allocate();
+    rd.init();
+    rd.set_dt (0.0005);
+}
+
+static double maxdiff (const RD_test& a, const RD_test& b)
+{
+    double md = 0.0;
+    for (unsigned int h = 0; h < a.nhex; ++h) {
+        md = std::max (md, std::abs (a.A[h] - b.A[h]));
+        md = std::max (md, std::abs (a.B[h] - b.B[h]));
+        md = std::max (md, std::abs (a.C[h] - b.C[h]));
+    }
+    return md;
+}
+
+int main()
+{
+    int rtn = 0;
+    const unsigned int nsteps = 30;
+
+    // Hand written fused right hand side
+    RD_test ref;
+    setup (ref);
+    for (unsigned int s = 0; s < nsteps; ++s) {
+        ref.fused_step<3> ({ &ref.A, &ref.B, &ref.C },
+                           [&ref](const int h, const std::array<const double*, 3>& x, std::array<double, 3>& dxdt)
+                           {
+                               const double a = x[0][h];
+                               const double b = x[1][h];
+                               const double c = x[2][h];
+                               dxdt[0] = (0.1 - a + a * a * b - 0.5 * c) + 0.01 * ref.laplace_at (x[0], h);
+                               dxdt[1] = (0.9 - a * a * b) + 0.2 * ref.laplace_at (x[1], h);
+                               dxdt[2] = (a - c);
+                           });
+    }
+
+    auto reaction = [](const std::array<double, 3>& u, std::array<double, 3>& r)
+    {
+        r[0] = 0.1 - u[0] + u[0] * u[0] * u[1] - 0.5 * u[2];
+        r[1] = 0.9 - u[0] * u[0] * u[1];
+        r[2] = u[0] - u[2];
+    };
+
+    // Runtime coefficients
+    RD_test rt;
+    setup (rt);
+    auto rhs_rt = rt.reaction_diffusion<3> (std::array<double, 3>{ 0.01, 0.2, 0.0 }, reaction);
+    for (unsigned int s = 0; s < nsteps; ++s) { rt.fused_step<3> ({ &rt.A, &rt.B, &rt.C }, rhs_rt); }
+    if (maxdiff (rt, ref) > 1e-13) {
+        cerr << "Runtime coefficients: differs by " << maxdiff (rt, ref) << endl;
+        rtn = -1;
+    }
+
+    // Compile time coefficients
+    RD_test ct;
+    setup (ct);
+    for (unsigned int s = 0; s < nsteps; ++s) {
+        ct.fused_step<3> ({ &ct.A, &ct.B, &ct.C }, ct.reaction_diffusion<3> (Dconst{}, reaction));
+    }
+    if (maxdiff (ct, ref) > 1e-13) {
+        cerr << "Compile time coefficients: differs by " << maxdiff (ct, ref) << endl;
+        rtn = -1;
+    }
+
+    // A reaction that takes the hex index, here with a parameter that varies over the domain
+    RD_test hx;
+    setup (hx);
+    std::vector<double> k (hx.nhex, 0.1);
+    auto rhs_hx = hx.reaction_diffusion<3> (Dconst{},
+                                            [&k](const int hi, const std::array<double, 3>& u, std::array<double, 3>& r)
+                                            {
+                                                r[0] = k[hi] - u[0] + u[0] * u[0] * u[1] - 0.5 * u[2];
+                                                r[1] = 0.9 - u[0] * u[0] * u[1];
+                                                r[2] = u[0] - u[2];
+                                            });
+    for (unsigned int s = 0; s < nsteps; ++s) { hx.fused_step<3> ({ &hx.A, &hx.B, &hx.C }, rhs_hx); }
+    if (maxdiff (hx, ref) > 1e-13) {
+        cerr << "Per hex reaction: differs by " << maxdiff (hx, ref) << endl;
+        rtn = -1;
+    }
+
+    cout << "testrdreaction " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
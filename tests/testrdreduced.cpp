@@ -0,0 +1,128 @@
+/*
+ * Test RD_Base::reduced_step, which stores the state of an RD system as float16 or
+ * bfloat16 and computes in float.
+ */
+
+#include "morph/RD_Base.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+class RD_test : public RD_Base<float>
+{
+public:
+    std::vector<float> A;
+    std::vector<float> B;
+    void init()
+    {
+        this->A.resize (this->nhex);
+        this->B.resize (this->nhex);
+        for (unsigned int h = 0; h < this->nhex; ++h) {
+            this->A[h] = 1.0f + 0.2f * std::sin (7.0f * this->hg->d_x[h]);
+            this->B[h] = 0.9f + 0.1f * std::cos (5.0f * this->hg->d_y[h]);
+        }
+    }
+    void step() {}
+};
+
+static void setup (RD_test& rd)
+{
+    rd.svgpath = "";
+    rd.hextohex_d = 0.03f;
+    rd.hexspan = 2.0f;
+    rd.allocate();
+    rd.init();
+    rd.set_dt (0.0005f);
+}
+
+// The Schnakenberg reaction
+static void schnakenberg (const std::array<float, 2>& u, std::array<float, 2>& r)
+{
+    const float a2b = u[0] * u[0] * u[1];
+    r[0] = 0.1f - u[0] + a2b;
+    r[1] = 0.9f - a2b;
+}
+
+template <typename S>
+static float reduced_error (const RD_Integrator method, const RD_Rounding rounding)
+{
+    const unsigned int nsteps = 200;
+    RD_test ref;
+    setup (ref);
+    auto rhs = ref.reaction_diffusion<2> (std::array<float, 2>{ 0.01f, 0.2f }, schnakenberg);
+    for (unsigned int s = 0; s < nsteps; ++s) { ref.fused_step<2> ({ &ref.A, &ref.B }, rhs, method); }
+
+    RD_test rd;
+    setup (rd);
+    rd.rounding = rounding;
+    std::vector<S> A (rd.nhex);
+    std::vector<S> B (rd.nhex);
+    convert (rd.A.data(), A.data(), rd.nhex);
+    convert (rd.B.data(), B.data(), rd.nhex);
+    auto rhs16 = rd.reaction_diffusion<2> (std::array<float, 2>{ 0.01f, 0.2f }, schnakenberg);
+    for (unsigned int s = 0; s < nsteps; ++s) { rd.reduced_step<2, S> ({ &A, &B }, rhs16, method); }
+
+    float md = 0.0f;
+    for (unsigned int h = 0; h < rd.nhex; ++h) {
+        md = std::max (md, std::abs (static_cast<float>(A[h]) - ref.A[h]));
+        md = std::max (md, std::abs (static_cast<float>(B[h]) - ref.B[h]));
+    }
+    return md;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // The values are about 1, so a float16 holds them to about 5e-4 and a bfloat16 to
+    // about 4e-3. With this small dt, many per-step changes are below half of that
+    // spacing, so rounding to nearest stalls, and its error grows to many times the
+    // spacing. Stochastic rounding does not stall.
+    for (RD_Integrator m : { RD_Integrator::Euler, RD_Integrator::RK2, RD_Integrator::RK4 }) {
+        float e16 = reduced_error<float16> (m, RD_Rounding::Nearest);
+        float eb16 = reduced_error<bfloat16> (m, RD_Rounding::Nearest);
+        float e16s = reduced_error<float16> (m, RD_Rounding::Stochastic);
+        cout << "method " << static_cast<int>(m) << ": float16 error " << e16 << ", bfloat16 error " << eb16
+             << ", float16 with stochastic rounding error " << e16s << endl;
+        if (e16 > 5e-2f || eb16 > 1e-1f || e16s > 1.5e-2f || e16s > e16) {
+            cerr << "Reduced precision state departed too far from the float state\n";
+            rtn = -1;
+        }
+    }
+
+    // A slow decay, du/dt = -0.01 u, in which each step changes u by 1e-5; much less
+    // than half of float16's spacing near 1. Rounding to nearest loses every change,
+    // whereas stochastic rounding follows the decay on average.
+    {
+        RD_test rd;
+        setup (rd);
+        rd.set_dt (0.001f);
+        auto decay = rd.reaction_diffusion<1> (std::array<float, 1>{ 0.0f },
+                                               [](const std::array<float, 1>& u, std::array<float, 1>& r) { r[0] = -0.01f * u[0]; });
+        const unsigned int nsteps = 1000;
+        const float exact = std::exp (-0.01f * 0.001f * nsteps);
+        for (RD_Rounding rounding : { RD_Rounding::Nearest, RD_Rounding::Stochastic }) {
+            rd.rounding = rounding;
+            std::vector<float16> U (rd.nhex, float16 (1.0f));
+            for (unsigned int s = 0; s < nsteps; ++s) { rd.reduced_step<1, float16> ({ &U }, decay, RD_Integrator::Euler); }
+            double mean = 0.0;
+            for (unsigned int h = 0; h < rd.nhex; ++h) { mean += static_cast<float>(U[h]); }
+            mean /= rd.nhex;
+            cout << (rounding == RD_Rounding::Nearest ? "nearest" : "stochastic") << " rounding: mean "
+                 << mean << ", exact " << exact << endl;
+            if (rounding == RD_Rounding::Nearest && mean != 1.0) {
+                cerr << "Expected rounding to nearest to lose the decay\n";
+                rtn = -1;
+            }
+            if (rounding == RD_Rounding::Stochastic && std::abs (mean - exact) > 2e-4) {
+                cerr << "Stochastic rounding did not follow the decay\n";
+                rtn = -1;
+            }
+        }
+    }
+
+    cout << "testrdreduced " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,138 @@
+/*
+ * Test the windowed Gaussian and bilinear image resampling of Grid::resample_image and
+ * HexGrid::resampleImage against a direct sum over every image pixel.
+ */
+
+#include "morph/Grid.h"
+#include "morph/HexGrid.h"
+#include "morph/ImageSampler.h"
+#include "morph/vvec.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+// The Gaussian weighted sum over all of the pixels of an image, at each of the points
+// (x[k], y[k]), renormalised. Pixel (i, j) is at origin + dpp * (i, j).
+static vvec<float> direct_resample (const vvec<float>& img, const unsigned int w, const vec<float, 2>& dpp,
+                                    const vec<float, 2>& origin, const vvec<float>& x, const vvec<float>& y)
+{
+    const vec<float, 2> params = 1.0f / (2.0f * dpp * dpp);
+    vvec<float> out (x.size(), 0.0f);
+    for (size_t k = 0; k < x.size(); ++k) {
+        float expr = 0.0f;
+        for (unsigned int i = 0; i < img.size(); ++i) {
+            const float dx = x[k] - (dpp[0] * (i % w) + origin[0]);
+            const float dy = y[k] - (dpp[1] * (i / w) + origin[1]);
+            expr += std::exp (-(params[0] * dx * dx + params[1] * dy * dy)) * img[i];
+        }
+        out[k] = expr;
+    }
+    out /= out.max();
+    return out;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // A test image with features at a range of scales
+    const unsigned int iw = 60;
+    const unsigned int ih = 45;
+    vvec<float> img (iw * ih);
+    for (unsigned int i = 0; i < img.size(); ++i) {
+        const float u = static_cast<float>(i % iw);
+        const float v = static_cast<float>(i / iw);
+        img[i] = 0.5f + 0.3f * std::sin (0.4f * u) * std::cos (0.25f * v) + ((i % 17) == 0 ? 0.2f : 0.0f);
+    }
+
+    // Grid
+    {
+        Grid<int, float> g (80, 50, { 0.01f, 0.01f }, { 0.0f, 0.0f });
+        const vec<float, 2> scale = { 0.9f, 0.9f };
+        const vec<float, 2> offset = { 0.03f, 0.02f };
+        vvec<float> r = g.resample_image (img, iw, scale, offset);
+        const vec<float, 2> dpp = scale * g.width() / static_cast<float>(iw - 1);
+        vvec<float> x (g.n);
+        vvec<float> y (g.n);
+        for (int i = 0; i < g.n; ++i) { x[i] = g.v_c[i][0]; y[i] = g.v_c[i][1]; }
+        const vvec<float> ref = direct_resample (img, iw, dpp, offset, x, y);
+        const float md = (r - ref).abs().max();
+        cout << "Grid: windowed Gaussian differs from the full sum by " << md << endl;
+        // The Gaussian weight outside the 3 sigma window is 1 - erf(3/sqrt(2))^2, about 0.5%
+        if (md > 1e-2f) { cerr << "Grid::resample_image differs from the full sum\n"; rtn = -1; }
+
+        // The bilinear preview is close to the Gaussian for this smooth-ish image, and
+        // exact for an image which is linear in x and y
+        vvec<float> rb = g.resample_image (img, iw, scale, offset, ResampleMode::Bilinear);
+        if (rb.size() != r.size() || rb.max() != 1.0f) { cerr << "Bad bilinear resampling\n"; rtn = -1; }
+        vvec<float> ramp (iw * ih);
+        for (unsigned int i = 0; i < ramp.size(); ++i) { ramp[i] = 1.0f + 0.5f * (i % iw) + 0.25f * (i / iw); }
+        ImageSampler s;
+        s.w = iw;
+        s.h = ih;
+        s.dist_per_pix = dpp;
+        s.origin = offset;
+        float be = 0.0f;
+        for (int i = 0; i < g.n; ++i) {
+            const vec<float, 2> p = (g.v_c[i] - offset) / dpp;
+            if (p[0] < 0.0f || p[1] < 0.0f || p[0] > iw - 1 || p[1] > ih - 1) {
+                if (s.bilinear (ramp.data(), g.v_c[i][0], g.v_c[i][1]) != 0.0f) { be = 1.0f; }
+                continue;
+            }
+            be = std::max (be, std::abs (s.bilinear (ramp.data(), g.v_c[i][0], g.v_c[i][1]) - (1.0f + 0.5f * p[0] + 0.25f * p[1])));
+        }
+        if (be > 1e-4f) { cerr << "Bilinear interpolation of a ramp is wrong by " << be << endl; rtn = -1; }
+    }
+
+    // HexGrid
+    {
+        HexGrid hg (0.02f, 2.0f, 0.0f);
+        hg.setCircularBoundary (0.6f);
+        const vec<float, 2> scale = { 1.4f, 1.4f };
+        const vec<float, 2> offset = { 0.05f, -0.1f };
+        vvec<float> r = hg.resampleImage (img, iw, scale, offset);
+        const vec<float, 2> dpp = scale / static_cast<float>(iw - 1);
+        const vec<float, 2> centering = dpp * vec<unsigned int, 2>{ iw, ih } * 0.5f;
+        vvec<float> x (hg.d_x.begin(), hg.d_x.end());
+        vvec<float> y (hg.d_y.begin(), hg.d_y.end());
+        const vvec<float> ref = direct_resample (img, iw, dpp, offset - centering, x, y);
+        const float md = (r - ref).abs().max();
+        cout << "HexGrid: windowed Gaussian differs from the full sum by " << md << endl;
+        if (md > 1e-2f) { cerr << "HexGrid::resampleImage differs from the full sum\n"; rtn = -1; }
+        // For a smooth image, the bilinear preview is close to the Gaussian resampling
+        vvec<float> smooth (iw * ih);
+        for (unsigned int i = 0; i < smooth.size(); ++i) { smooth[i] = 1.0f + 0.5f * std::sin (0.1f * (i % iw)) * std::cos (0.07f * (i / iw)); }
+        const vvec<float> rg = hg.resampleImage (smooth, iw, scale, offset);
+        const vvec<float> rb = hg.resampleImage (smooth, iw, scale, offset, ResampleMode::Bilinear);
+        // (away from the edges of the image, where the Gaussian sum tails off)
+        float bd = 0.0f;
+        for (unsigned int i = 0; i < hg.num(); ++i) {
+            const vec<float, 2> p = (vec<float, 2>{ hg.d_x[i], hg.d_y[i] } - offset + centering) / dpp;
+            if (p[0] > 3.0f && p[1] > 3.0f && p[0] < iw - 4.0f && p[1] < ih - 4.0f) { bd = std::max (bd, std::abs (rb[i] - rg[i])); }
+        }
+        cout << "HexGrid: bilinear differs from Gaussian by " << bd << endl;
+        if (bd > 2e-2f) { cerr << "Bilinear preview is far from the Gaussian resampling\n"; rtn = -1; }
+    }
+
+    // The window visits only the pixels within 3 sigma
+    {
+        ImageSampler s;
+        s.w = iw;
+        s.h = ih;
+        s.dist_per_pix = { 0.1f, 0.2f };
+        unsigned int count = 0;
+        s.gaussian_window (2.05f, 3.01f, [&count, &s](const unsigned int i, const float) {
+            const float dx = 2.05f - 0.1f * (i % s.w);
+            const float dy = 3.01f - 0.2f * (i / s.w);
+            if (std::abs (dx) >= 0.3f || std::abs (dy) >= 0.6f) { ++count; }
+            ++count;
+        });
+        // 6 columns (x from 1.8 to 2.3) and 6 rows (y from 2.6 to 3.6)
+        if (count != 36) { cerr << "Unexpected Gaussian window: " << count << endl; rtn = -1; }
+    }
+
+    cout << "testresampleimage " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
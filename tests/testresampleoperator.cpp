@@ -0,0 +1,122 @@
+/*
+ * Test that a ResampleOperator reproduces HexGrid::resampleImage, Grid::resample_image and
+ * CartGrid::resampleToPolar, and that it can be saved and reloaded.
+ */
+
+#include "morph/ResampleOperator.h"
+#include "morph/Grid.h"
+#include "morph/HexGrid.h"
+#include "morph/CartGrid.h"
+#include "morph/vvec.h"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+int main()
+{
+    int rtn = 0;
+
+    const unsigned int iw = 60;
+    const unsigned int ih = 45;
+    vvec<float> img (iw * ih);
+    for (unsigned int i = 0; i < img.size(); ++i) {
+        img[i] = 0.5f + 0.3f * std::sin (0.4f * (i % iw)) * std::cos (0.25f * (i / iw)) + ((i % 17) == 0 ? 0.2f : 0.0f);
+    }
+    // A second frame of the same size
+    vvec<float> img2 (iw * ih);
+    for (unsigned int i = 0; i < img2.size(); ++i) { img2[i] = 1.0f + std::cos (0.1f * (i % iw) + 0.2f * (i / iw)); }
+
+    const std::string cachepath = "./testresampleoperator.bin";
+    std::remove (cachepath.c_str());
+
+    // HexGrid, both modes, for two frames
+    {
+        HexGrid hg (0.02f, 2.0f, 0.0f);
+        hg.setCircularBoundary (0.6f);
+        const vec<float, 2> scale = { 1.4f, 1.4f };
+        const vec<float, 2> offset = { 0.05f, -0.1f };
+        for (auto mode : { ResampleMode::Gaussian, ResampleMode::Bilinear }) {
+            ResampleOperator op;
+            op.build (hg, iw, ih, scale, offset, mode);
+            if (op.rows() != hg.num() || op.cols() != img.size()) { cerr << "Bad operator size\n"; rtn = -1; }
+            for (const vvec<float>* f : { &img, &img2 }) {
+                vvec<float> out;
+                op.apply (*f, out);
+                const float md = (out - hg.resampleImage (*f, iw, scale, offset, mode)).abs().max();
+                if (md > 1e-5f) { cerr << "HexGrid: operator differs from resampleImage by " << md << endl; rtn = -1; }
+            }
+        }
+
+        // Save on the first build, load on the second
+        ResampleOperator op1;
+        if (op1.build (hg, iw, ih, scale, offset, ResampleMode::Gaussian, cachepath) != false) {
+            cerr << "Loaded an operator from a cache that should not exist\n"; rtn = -1;
+        }
+        ResampleOperator op2;
+        if (op2.build (hg, iw, ih, scale, offset, ResampleMode::Gaussian, cachepath) != true) {
+            cerr << "Failed to load the cached operator\n"; rtn = -1;
+        }
+        vvec<float> o1, o2;
+        op1.apply (img, o1);
+        op2.apply (img, o2);
+        if (op2.nnz() != op1.nnz() || o1 != o2) { cerr << "The reloaded operator differs\n"; rtn = -1; }
+        // A different geometry must not be loaded from the cache (it is rebuilt and resaved)
+        ResampleOperator op3;
+        if (op3.build (hg, iw, ih, scale, offset + vec<float, 2>{ 0.01f, 0.0f }, ResampleMode::Gaussian, cachepath) != false) {
+            cerr << "Loaded an operator for a different geometry\n"; rtn = -1;
+        }
+        if (op2.load (cachepath, op1.key()) != false) { cerr << "Loaded an operator with the wrong key\n"; rtn = -1; }
+        std::remove (cachepath.c_str());
+        // The all-same shortcut
+        vvec<float> flat (iw * ih, 0.25f);
+        op1.apply (flat, o1);
+        if (o1.min() != 0.25f || o1.max() != 0.25f) { cerr << "Bad resampling of a uniform image\n"; rtn = -1; }
+        // An image of the wrong size
+        try {
+            op1.apply (vvec<float>(iw * ih - 1, 0.0f), o1);
+            cerr << "No exception for an image of the wrong size\n"; rtn = -1;
+        } catch (const std::runtime_error&) {}
+    }
+
+    // Grid
+    {
+        Grid<int, float> g (80, 50, { 0.01f, 0.01f }, { 0.0f, 0.0f });
+        const vec<float, 2> scale = { 0.9f, 0.9f };
+        const vec<float, 2> offset = { 0.03f, 0.02f };
+        for (auto mode : { ResampleMode::Gaussian, ResampleMode::Bilinear }) {
+            ResampleOperator op;
+            op.build (g, iw, ih, scale, offset, mode);
+            vvec<float> out;
+            op.apply (img, out);
+            const float md = (out - g.resample_image (img, iw, scale, offset, mode)).abs().max();
+            if (md > 1e-5f) { cerr << "Grid: operator differs from resample_image by " << md << endl; rtn = -1; }
+        }
+    }
+
+    // CartGrid polar resampling
+    {
+        CartGrid cg (0.02f, 0.02f, -0.5f, -0.4f, 0.5f, 0.4f);
+        cg.setBoundaryOnOuterEdge();
+        vvec<float> data (cg.num());
+        for (unsigned int i = 0; i < cg.num(); ++i) { data[i] = 1.0f + std::sin (5.0f * cg.d_x[i]) * std::cos (3.0f * cg.d_y[i]); }
+        CartGrid cg_polar (0.05f, 0.02f, -1.0f, 0.0f, 1.0f, 0.6f);
+        cg_polar.setBoundaryOnOuterEdge();
+        const vec<float, 2> view_pos = { 0.1f, -0.05f };
+        for (auto radscale : { ScaleFn::Linear, ScaleFn::Logarithmic }) {
+            vvec<float> ref (cg_polar.num(), 0.0f);
+            cg.resampleToPolar (data, cg_polar, ref, view_pos, 0.3f, radscale);
+            ResampleOperator op;
+            op.build_polar (cg, cg_polar, view_pos, 0.3f, radscale);
+            vvec<float> out;
+            op.apply (data, out);
+            const float md = (out - ref).abs().max();
+            if (md > 1e-5f || ref.max() == 0.0f) { cerr << "CartGrid: operator differs from resampleToPolar by " << md << endl; rtn = -1; }
+        }
+    }
+
+    cout << "testresampleoperator " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
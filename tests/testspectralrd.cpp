@@ -0,0 +1,104 @@
+/*
+ * Test SpectralRD, the pseudo-spectral ETDRK4 reaction diffusion solver for periodic
+ * Grids.
+ */
+
+#include "morph/SpectralRD.h"
+#include "morph/Grid.h"
+#include "morph/vvec.h"
+#include "morph/mathconst.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+static const double twopi = 2.0 * mathconst<double>::pi;
+
+// The Schnakenberg reaction
+static void schnakenberg (const std::array<double, 2>& u, std::array<double, 2>& r)
+{
+    const double a2b = u[0] * u[0] * u[1];
+    r[0] = 0.1 - u[0] + a2b;
+    r[1] = 0.9 - a2b;
+}
+
+// Run a Schnakenberg system to t = 2 with timestep dt
+static std::array<vvec<double>, 2> schnakenberg_run (const Grid<int, double>& g, const double dt)
+{
+    std::array<vvec<double>, 2> u;
+    u[0].resize (g.n);
+    u[1].resize (g.n);
+    const double L = g.width_of_pixels();
+    for (int i = 0; i < g.n; ++i) {
+        u[0][i] = 1.0 + 0.3 * std::cos (twopi * g.v_c[i][0] / L) * std::sin (2.0 * twopi * g.v_c[i][1] / L);
+        u[1][i] = 0.9 + 0.2 * std::sin (twopi * (g.v_c[i][0] + g.v_c[i][1]) / L);
+    }
+    SpectralRD<double, 2> srd (g, { 0.01, 0.2 }, dt);
+    const int nsteps = static_cast<int>(std::round (2.0 / dt));
+    for (int s = 0; s < nsteps; ++s) { srd.step ({ &u[0], &u[1] }, schnakenberg); }
+    return u;
+}
+
+int main()
+{
+    int rtn = 0;
+
+    // The Laplacian of a Fourier mode, on row and column major grids of non power of 2 size
+    for (GridOrder order : { GridOrder::bottomleft_to_topright, GridOrder::topleft_to_bottomright_colmaj }) {
+        Grid<int, double> g (64, 48, { 0.1, 0.05 }, { 0.0, 0.0 }, GridDomainWrap::Both, order);
+        const double Lx = g.width_of_pixels();
+        const double Ly = g.height_of_pixels();
+        const double kx = twopi * 2.0 / Lx;
+        const double ky = twopi * 3.0 / Ly;
+        vvec<double> u (g.n);
+        for (int i = 0; i < g.n; ++i) { u[i] = std::sin (kx * g.v_c[i][0]) * std::cos (ky * g.v_c[i][1]); }
+        SpectralRD<double, 1> srd (g, { 0.05 }, 0.5);
+        vvec<double> lap;
+        srd.laplacian (u, lap);
+        const double err = (lap + u * (kx * kx + ky * ky)).abs().max();
+        if (err > 1e-9) { cerr << "Spectral Laplacian error " << err << endl; rtn = -1; }
+
+        // Pure diffusion is integrated exactly, whatever the timestep
+        vvec<double> v = u;
+        for (int s = 0; s < 10; ++s) { srd.step ({ &v }, [](const std::array<double, 1>&, std::array<double, 1>& r) { r[0] = 0.0; }); }
+        const vvec<double> exact = u * std::exp (-0.05 * (kx * kx + ky * ky) * 5.0);
+        const double derr = (v - exact).abs().max();
+        if (derr > 1e-12) { cerr << "Diffusion error " << derr << endl; rtn = -1; }
+
+        // A linear decay term too, which ETDRK4 integrates to 4th order
+        v = u;
+        for (int s = 0; s < 10; ++s) { srd.step ({ &v }, [](const std::array<double, 1>& x, std::array<double, 1>& r) { r[0] = -0.3 * x[0]; }); }
+        const vvec<double> exact2 = u * std::exp ((-0.05 * (kx * kx + ky * ky) - 0.3) * 5.0);
+        const double lerr = (v - exact2).abs().max();
+        cout << "Laplacian error " << err << ", diffusion error " << derr << ", decay error " << lerr << endl;
+        if (lerr > 1e-4) { cerr << "Diffusion with decay error " << lerr << endl; rtn = -1; }
+    }
+
+    // Fourth order convergence for the nonlinear Schnakenberg system
+    {
+        Grid<int, double> g (32, 32, { 0.05, 0.05 }, { 0.0, 0.0 }, GridDomainWrap::Both);
+        const std::array<vvec<double>, 2> ref = schnakenberg_run (g, 0.0125);
+        double e[2] = { 0.0, 0.0 };
+        const double dts[2] = { 0.2, 0.1 };
+        for (int j = 0; j < 2; ++j) {
+            const std::array<vvec<double>, 2> u = schnakenberg_run (g, dts[j]);
+            e[j] = std::max ((u[0] - ref[0]).abs().max(), (u[1] - ref[1]).abs().max());
+        }
+        cout << "Schnakenberg error at dt = 0.2: " << e[0] << ", at dt = 0.1: " << e[1] << ", ratio " << e[0] / e[1] << endl;
+        if (e[0] / e[1] < 10.0 || e[1] > 1e-5) { cerr << "ETDRK4 is not converging at 4th order\n"; rtn = -1; }
+    }
+
+    // Grids that do not wrap are refused
+    try {
+        Grid<int, double> g (8, 8, { 1.0, 1.0 }, { 0.0, 0.0 }, GridDomainWrap::Horizontal);
+        SpectralRD<double, 1> srd (g, { 1.0 }, 0.1);
+        cerr << "Expected an exception for a Grid that does not wrap in both directions\n";
+        rtn = -1;
+    } catch (const std::runtime_error&) {
+        // Expected
+    }
+
+    cout << "testspectralrd " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}
@@ -0,0 +1,124 @@
+/*
+ * Test SummedAreaTable rectangle sums, means and variances against direct sums, and
+ * its box filter against CartGrid::boxfilter and MathAlgo::boxfilter_2d.
+ */
+
+#include "morph/SummedAreaTable.h"
+#include "morph/Grid.h"
+#include "morph/CartGrid.h"
+#include "morph/MathAlgo.h"
+#include "morph/vvec.h"
+#include <iostream>
+#include <cmath>
+
+using namespace morph;
+using namespace std;
+
+// The sum, count and sum of squares over a rectangle, directly, wrapping in x if wrap_x
+static void direct (const vvec<float>& d, const int w, const int h, const bool wrap_x,
+                    int x0, int y0, int x1, int y1, double& s, double& s2, int& c)
+{
+    s = 0.0; s2 = 0.0; c = 0;
+    for (int y = y0; y <= y1; ++y) {
+        if (y < 0 || y >= h) { continue; }
+        for (int x = x0; x <= x1; ++x) {
+            int xx = x;
+            if (wrap_x) { xx = ((x % w) + w) % w; } else if (x < 0 || x >= w) { continue; }
+            s += d[y * w + xx];
+            s2 += static_cast<double>(d[y * w + xx]) * d[y * w + xx];
+            ++c;
+        }
+    }
+}
+
+int main()
+{
+    int rtn = 0;
+
+    for (auto wrap : { GridDomainWrap::None, GridDomainWrap::Horizontal }) {
+        Grid<int, float> g (37, 23, { 1.0f, 1.0f });
+        vvec<float> data (g.n);
+        data.randomize();
+        data += 10.0f; // An offset, so that the variance is small relative to the mean square
+        Grid<int, float> gw (37, 23, { 1.0f, 1.0f }, { 0.0f, 0.0f }, wrap);
+        SummedAreaTable<float> sat (gw, data, true);
+        const bool wx = wrap == GridDomainWrap::Horizontal;
+        const int rects[][4] = { { 0, 0, 36, 22 }, { 3, 4, 3, 4 }, { -5, -2, 6, 30 }, { 30, 10, 45, 12 }, { -3, 0, 2, 0 }, { 5, 5, 4, 9 } };
+        for (auto r : rects) {
+            double s, s2;
+            int c;
+            direct (data, 37, 23, wx, r[0], r[1], r[2], r[3], s, s2, c);
+            const double m = c > 0 ? s / c : 0.0;
+            const double v = c > 0 ? s2 / c - m * m : 0.0;
+            if (sat.count (r[0], r[1], r[2], r[3]) != c
+                || std::abs (sat.sum (r[0], r[1], r[2], r[3]) - s) > 1e-9 * (1.0 + std::abs (s))
+                || std::abs (sat.mean (r[0], r[1], r[2], r[3]) - m) > 1e-9
+                || std::abs (sat.variance (r[0], r[1], r[2], r[3]) - v) > 1e-6) {
+                cerr << "Wrong statistics for rectangle (" << r[0] << "," << r[1] << ")-(" << r[2] << "," << r[3]
+                     << ")" << (wx ? " wrapped" : "") << endl;
+                rtn = -1;
+            }
+        }
+    }
+
+    // The box filter against CartGrid::boxfilter on a non-square, non-wrapping CartGrid
+    {
+        CartGrid cg (1.0f, 1.0f, 32.0f, 20.0f);
+        vvec<float> data (cg.num());
+        data.randomize();
+        SummedAreaTable<float> sat (cg, data);
+        if (sat.width() != 33 || sat.height() != 21) { cerr << "Wrong CartGrid dimensions\n"; rtn = -1; }
+        for (int boxside : { 1, 4, 7 }) {
+            vvec<float> ref (cg.num(), 0.0f);
+            cg.boxfilter (data, ref, boxside);
+            vvec<float> result;
+            sat.boxfilter (result, boxside);
+            const float md = (result - ref).abs().max();
+            if (md > 1e-5f) { cerr << "boxfilter (" << boxside << ") differs from CartGrid::boxfilter by " << md << endl; rtn = -1; }
+        }
+    }
+
+    // ...and against MathAlgo::boxfilter_2d on horizontally wrapping data
+    {
+        const int w = 40;
+        vvec<float> data (w * 30);
+        data.randomize();
+        vvec<float> ref (data.size(), 0.0f);
+        MathAlgo::boxfilter_2d<float, 9> (data, ref, w);
+        SummedAreaTable<float> sat (data, w, false, true);
+        vvec<float> result;
+        sat.boxfilter (result, 9);
+        const float md = (result - ref).abs().max();
+        if (md > 1e-5f) { cerr << "boxfilter differs from MathAlgo::boxfilter_2d by " << md << endl; rtn = -1; }
+    }
+
+    // Local contrast normalisation
+    {
+        const int w = 20;
+        const int h = 15;
+        vvec<float> data (w * h);
+        data.randomize();
+        SummedAreaTable<float> sat (data, w, true);
+        vvec<float> result;
+        sat.contrast_normalise (result, 5, 1e-6);
+        for (int i : { 0, 47, 161, w * h - 1 }) {
+            const int x = i % w;
+            const int y = i / w;
+            double s, s2;
+            int c;
+            direct (data, w, h, false, x - 2, y - 2, x + 2, y + 2, s, s2, c);
+            const double m = s / c;
+            const double expected = (data[i] - m) / std::sqrt (s2 / c - m * m + 1e-6);
+            if (std::abs (result[i] - expected) > 1e-4) { cerr << "Wrong contrast normalisation at " << i << endl; rtn = -1; }
+        }
+        // Without the table of squares, variance is unavailable
+        SummedAreaTable<float> sat1 (data, w);
+        try {
+            sat1.variance (0, 0, 3, 3);
+            cerr << "No exception for variance without squares\n"; rtn = -1;
+        } catch (const std::runtime_error&) {}
+    }
+
+    cout << "testsummedareatable " << (rtn == 0 ? "passed" : "failed") << endl;
+    return rtn;
+}